@@ -0,0 +1,325 @@
+/*
+
+Implementation of the asynchronous requests declared in async-io.h
+
+*/
+
+#include "async-io.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <errno.h>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace psum {
+
+/* The thread of the fallback and its queue */
+struct IoThread {
+    thread worker;
+    mutex lock;
+    condition_variable wake;        // a request was queued, or the thread is stopping
+    condition_variable finished;    // a request is complete
+    deque<IoRequest*> queue;
+    bool stopping;
+};
+
+/*
+Do a whole request with pread or pwrite
+param       request -- Pointer to the request
+*/
+static void transfer(IoRequest* request) {
+    while(request->done < request->length) {
+        char* buffer = request->buffer + request->done;
+        size_t length = request->length - request->done;
+        off_t offset = (off_t)(request->offset + request->done);
+        ssize_t n = request->write ? pwrite(request->fd, buffer, length, offset) : pread(request->fd, buffer, length, offset);
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n < 0) {
+            request->error = errno;
+            return;
+        }
+        if(n == 0) {
+            if(request->write) { request->error = EIO; } // A read stops at the end of the file
+            return;
+        }
+        request->done += n;
+    }
+}
+
+/*
+Run the requests of the fallback queue until it is closed
+param       io -- Pointer to the queue
+*/
+static void ioLoop(AsyncIo* io) {
+    IoThread* state = io->thread;
+    unique_lock<mutex> guard(state->lock);
+    while(true) {
+        state->wake.wait(guard, [state]() { return state->stopping || !state->queue.empty(); });
+        if(state->queue.empty()) { return; } // Stopping, and every request is done
+        IoRequest* request = state->queue.front();
+        state->queue.pop_front();
+
+        guard.unlock();
+        transfer(request);
+        guard.lock();
+        request->complete = true;
+        io->inFlight--;
+        state->finished.notify_all();
+    }
+}
+
+/*
+Enter the kernel to submit requests and wait for completions, again after a signal
+param       io -- the queue
+            submit -- the number of requests to submit
+            wait -- the number of completions to wait for
+return      the number of requests submitted, or -1 on error
+*/
+static int enterRing(const AsyncIo* io, unsigned submit, unsigned wait) {
+    while(true) {
+        long result = syscall(__NR_io_uring_enter, io->ringFd, submit, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if(result >= 0 || errno != EINTR) { return (int)result; }
+    }
+}
+
+/*
+Unmap the rings and close an io_uring
+param       io -- Pointer to the queue
+*/
+static void releaseRing(AsyncIo* io) {
+    if(io->entriesMap != NULL) { munmap(io->entriesMap, io->entriesLength); }
+    if(io->completionRing != NULL && io->completionRing != io->submissionRing) { munmap(io->completionRing, io->completionLength); }
+    if(io->submissionRing != NULL) { munmap(io->submissionRing, io->submissionLength); }
+    if(io->ringFd >= 0) { close(io->ringFd); }
+    io->ringFd = -1;
+    io->submissionRing = NULL;
+    io->completionRing = NULL;
+    io->entriesMap = NULL;
+}
+
+/*
+Set up an io_uring and map its rings
+param       io -- Pointer to the queue
+            entries -- the number of requests in flight at once
+return      0 if successful, or -1 if the kernel has no io_uring or it cannot be mapped
+*/
+static int openRing(AsyncIo* io, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    io->ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(io->ringFd < 0) { return -1; }
+
+    io->submissionLength = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    io->completionLength = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single) {
+        // Both rings are in one mapping, as long as the longer one
+        if(io->completionLength > io->submissionLength) { io->submissionLength = io->completionLength; }
+        io->completionLength = io->submissionLength;
+    }
+    io->entriesLength = params.sq_entries*sizeof(struct io_uring_sqe);
+
+    void* ring = mmap(NULL, io->submissionLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ringFd, IORING_OFF_SQ_RING);
+    io->submissionRing = (ring == MAP_FAILED) ? NULL : ring;
+    if(io->submissionRing != NULL && !single) {
+        ring = mmap(NULL, io->completionLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ringFd, IORING_OFF_CQ_RING);
+        io->completionRing = (ring == MAP_FAILED) ? NULL : ring;
+    }
+    else { io->completionRing = io->submissionRing; }
+    if(io->completionRing != NULL) {
+        ring = mmap(NULL, io->entriesLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ringFd, IORING_OFF_SQES);
+        io->entriesMap = (ring == MAP_FAILED) ? NULL : ring;
+    }
+    if(io->entriesMap == NULL) {
+        int error = errno;
+        releaseRing(io);
+        errno = error;
+        return -1;
+    }
+
+    char* submission = (char*)io->submissionRing;
+    char* completion = (char*)io->completionRing;
+    io->sqHead = (unsigned*)(submission + params.sq_off.head);
+    io->sqTail = (unsigned*)(submission + params.sq_off.tail);
+    io->sqMask = (unsigned*)(submission + params.sq_off.ring_mask);
+    io->sqArray = (unsigned*)(submission + params.sq_off.array);
+    io->cqHead = (unsigned*)(completion + params.cq_off.head);
+    io->cqTail = (unsigned*)(completion + params.cq_off.tail);
+    io->cqMask = (unsigned*)(completion + params.cq_off.ring_mask);
+    io->cqes = completion + params.cq_off.cqes;
+    io->entries = params.sq_entries;
+    return 0;
+}
+
+int openAsyncIo(AsyncIo* io, unsigned entries, IoMode mode) {
+    io->mode = IO_THREAD; // Until it is open, closing releases nothing
+    io->entries = entries < 1 ? 1 : entries;
+    io->inFlight = 0;
+    io->ringFd = -1;
+    io->submissionRing = NULL;
+    io->completionRing = NULL;
+    io->entriesMap = NULL;
+    io->thread = NULL;
+
+    if(mode != IO_THREAD) {
+        if(openRing(io, io->entries) == 0) {
+            io->mode = IO_URING;
+            return 0;
+        }
+        if(mode == IO_URING) { return -1; }
+    }
+
+    io->mode = IO_THREAD;
+    io->thread = new IoThread();
+    io->thread->stopping = false;
+    try {
+        io->thread->worker = thread(ioLoop, io);
+    }
+    catch(const system_error& e) {
+        delete io->thread;
+        io->thread = NULL;
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Take the next completion of an io_uring, continuing the request if it was short
+param       io -- Pointer to the queue
+return      0 if successful, or -1 if the kernel could not be entered
+*/
+static int reapRing(AsyncIo* io) {
+    unsigned head = *io->cqHead;
+    while(head == __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE)) {
+        if(enterRing(io, 0, 1) < 0) { return -1; }
+    }
+    struct io_uring_cqe* cqe = (struct io_uring_cqe*)io->cqes + (head & *io->cqMask);
+    IoRequest* request = (IoRequest*)(uintptr_t)cqe->user_data;
+    int result = cqe->res;
+    __atomic_store_n(io->cqHead, head + 1, __ATOMIC_RELEASE);
+    io->inFlight--;
+
+    if(result < 0) { request->error = -result; }
+    else if(result == 0) {
+        if(request->write) { request->error = EIO; } // A read stops at the end of the file
+    }
+    else {
+        request->done += result;
+        if(request->done < request->length) {
+            if(submitIo(io, request) == 0) { return 0; }
+            request->error = errno;
+        }
+    }
+    request->complete = true;
+    return 0;
+}
+
+void prepareIo(IoRequest* request, int fd, bool write, void* buffer, size_t length, uint64_t offset) {
+    request->fd = fd;
+    request->write = write;
+    request->buffer = (char*)buffer;
+    request->length = length;
+    request->offset = offset;
+    request->done = 0;
+    request->error = 0;
+    request->complete = false;
+}
+
+int submitIo(AsyncIo* io, IoRequest* request) {
+    request->complete = false;
+    if(io->mode == IO_THREAD) {
+        lock_guard<mutex> guard(io->thread->lock);
+        if(io->inFlight >= io->entries) {
+            errno = EBUSY;
+            return -1;
+        }
+        io->thread->queue.push_back(request);
+        io->inFlight++;
+        io->thread->wake.notify_one();
+        return 0;
+    }
+
+    if(io->inFlight >= io->entries) {
+        errno = EBUSY;
+        return -1;
+    }
+    request->vector.iov_base = request->buffer + request->done;
+    request->vector.iov_len = request->length - request->done;
+
+    // Only this thread writes the tail, the kernel reads it once it is released
+    unsigned tail = *io->sqTail;
+    unsigned index = tail & *io->sqMask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)io->entriesMap + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&request->vector;
+    sqe->len = 1;
+    sqe->off = request->offset + request->done;
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+    io->sqArray[index] = index;
+    __atomic_store_n(io->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    if(enterRing(io, 1, 0) < 0) {
+        // An entry the kernel has not taken is withdrawn, one it has taken completes like any other
+        if(__atomic_load_n(io->sqHead, __ATOMIC_ACQUIRE) == tail) {
+            __atomic_store_n(io->sqTail, tail, __ATOMIC_RELEASE);
+            return -1;
+        }
+    }
+    io->inFlight++;
+    return 0;
+}
+
+int waitIo(AsyncIo* io, IoRequest* request) {
+    if(io->mode == IO_THREAD) {
+        unique_lock<mutex> guard(io->thread->lock);
+        io->thread->finished.wait(guard, [request]() { return request->complete; });
+    }
+    else {
+        while(!request->complete) {
+            if(reapRing(io) < 0) { return -1; }
+        }
+    }
+    if(request->error != 0) {
+        errno = request->error;
+        return -1;
+    }
+    return 0;
+}
+
+void closeAsyncIo(AsyncIo* io) {
+    if(io->mode == IO_THREAD) {
+        if(io->thread == NULL) { return; }
+        {
+            lock_guard<mutex> guard(io->thread->lock);
+            io->thread->stopping = true;
+            io->thread->wake.notify_one();
+        }
+        io->thread->worker.join();
+        delete io->thread;
+        io->thread = NULL;
+        return;
+    }
+
+    // The kernel must be done with the buffers before they are released, so an error only delays the next try
+    while(io->inFlight > 0) {
+        if(reapRing(io) < 0) { usleep(1000); }
+    }
+    releaseRing(io);
+}
+
+const char* asyncIoName(const AsyncIo& io) {
+    return io.mode == IO_URING ? "io_uring" : "thread";
+}
+
+} // namespace psum
@@ -0,0 +1,119 @@
+/*
+
+Asynchronous reads and writes at file offsets, so that a stream can read ahead and write behind while it computes.
+
+Requests go to an io_uring set up with the raw system calls, without liburing. Where the kernel has no io_uring, or it is
+not allowed, a thread of its own does the requests one after the other with pread and pwrite, so the caller still
+overlaps its I/O with its work. Either way a request is submitted, runs while the caller does something else, and is
+waited for by the caller later. A short transfer is continued until the whole request is done or the file ends.
+
+*/
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <sys/uio.h>
+
+namespace psum {
+
+/* How the requests are done */
+enum IoMode { IO_AUTO, IO_URING, IO_THREAD };
+
+/* Default number of chunk buffers of an asynchronous stream */
+const unsigned IO_DEPTH = 4;
+
+/* One read or write, owned by the caller until it is complete */
+struct IoRequest {
+    int fd;
+    bool write;
+    char* buffer;
+    size_t length;          // bytes to transfer
+    uint64_t offset;        // file offset of the first byte
+    size_t done;            // bytes transferred so far, less than length after a read reached the end of the file
+    int error;              // errno of a failed request, or 0
+    bool complete;
+    struct iovec vector;    // the rest of the request, as io_uring reads it
+};
+
+struct IoThread;
+
+/* A queue of requests */
+struct AsyncIo {
+    IoMode mode;            // IO_URING or IO_THREAD once open
+    unsigned entries;       // requests that can be in flight at once
+    unsigned inFlight;
+
+    // io_uring: the rings shared with the kernel
+    int ringFd;
+    void* submissionRing;
+    size_t submissionLength;
+    void* completionRing;   // the same as submissionRing when the kernel maps both at once
+    size_t completionLength;
+    void* entriesMap;       // the submission entries
+    size_t entriesLength;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    void* cqes;
+
+    IoThread* thread;       // thread fallback
+};
+
+/*
+Set up a queue of requests
+param       io -- Pointer to the queue to be initialized
+            entries -- the number of requests that can be in flight at once
+            mode -- IO_URING, IO_THREAD, or IO_AUTO for io_uring where the kernel has it and the thread otherwise
+return      0 if successful, or -1 if io_uring was asked for and cannot be set up, or the thread cannot be started
+*/
+int openAsyncIo(AsyncIo* io, unsigned entries, IoMode mode);
+
+/*
+Wait for the requests in flight and release a queue. It does not return before the kernel is done with every buffer.
+param       io -- Pointer to the queue
+*/
+void closeAsyncIo(AsyncIo* io);
+
+/*
+Fill in a request
+param       request -- Pointer to the request
+            fd -- the file descriptor, of a file that can be read or written at offsets
+            write -- true to write the buffer, false to read into it
+            buffer -- the bytes, which must stay valid until the request is complete
+            length -- the number of bytes
+            offset -- the file offset
+*/
+void prepareIo(IoRequest* request, int fd, bool write, void* buffer, size_t length, uint64_t offset);
+
+/*
+Start a request
+param       io -- Pointer to the queue
+            request -- Pointer to the prepared request
+return      0 if successful, or -1 with errno EBUSY if the queue is full, or the error of io_uring
+*/
+int submitIo(AsyncIo* io, IoRequest* request);
+
+/*
+Wait until a request is complete. Other requests that complete meanwhile are marked as complete.
+param       io -- Pointer to the queue
+            request -- Pointer to a submitted request
+return      0 if successful, or -1 with errno set if the request failed
+*/
+int waitIo(AsyncIo* io, IoRequest* request);
+
+/*
+Get the name of the way a queue does its requests
+param       io -- the queue
+return      "io_uring" or "thread"
+*/
+const char* asyncIoName(const AsyncIo& io);
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,254 @@
+/*
+
+Implementation of the auto-tuning declared in autotune.h
+
+*/
+
+#include "autotune.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "scan-engine.h"
+#include "shared-memory.h"
+
+using namespace std;
+
+namespace psum {
+
+static const int PROFILE_VERSION = 1;
+
+/*
+Get the size of the largest cache of the first CPU
+return      the size in bytes, or 0 if it is not known
+*/
+static size_t lastLevelCache() {
+    for(int level = 4 ; level >= 2 ; level--) {
+        size_t size = cacheSize(level);
+        if(size > 0) { return size; }
+    }
+    return 0;
+}
+
+string defaultProfilePath() {
+    const char* path = getenv("PSUM_PROFILE");
+    if(path != NULL && path[0] != '\0') { return path; }
+    const char* cache = getenv("XDG_CACHE_HOME");
+    if(cache != NULL && cache[0] != '\0') { return string(cache) + "/prefix-sum.profile"; }
+    const char* home = getenv("HOME");
+    if(home != NULL && home[0] != '\0') { return string(home) + "/.cache/prefix-sum.profile"; }
+    return "";
+}
+
+/*
+Time a scan of int64 values
+param       in, out -- the arrays
+            n -- the number of elements
+            policy -- how the scan is executed
+            repeat -- the number of runs
+            time -- Pointer receiving the median time in nanoseconds
+return      0 if successful, or -1 if a scan failed
+*/
+static int timeScan(const int64_t* in, int64_t* out, size_t n, const ExecPolicy& policy, int repeat, double* time) {
+    vector<double> times;
+    for(int r = 0 ; r < repeat ; r++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if(scan(in, out, n, false, (int64_t)0, Plus(), policy) < 0) { return -1; }
+        times.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    *time = times[times.size() / 2];
+    return 0;
+}
+
+int calibrateProfile(TuneProfile* profile) {
+    profile->cores = allowedCpus();
+    profile->l2Bytes = cacheSize(2);
+    profile->cacheBytes = lastLevelCache();
+    size_t l2 = profile->l2Bytes > 0 ? profile->l2Bytes : (1 << 20);
+    size_t cache = profile->cacheBytes > 0 ? profile->cacheBytes : (32 << 20);
+
+    // An array twice the cache is read from memory, within limits on the memory a calibration takes
+    size_t large = 2*cache;
+    if(large < ((size_t)32 << 20)) { large = (size_t)32 << 20; }
+    if(large > ((size_t)128 << 20)) { large = (size_t)128 << 20; }
+    size_t small = l2 / 4;
+    size_t n = large / sizeof(int64_t);
+    size_t smallN = small / sizeof(int64_t) > 1024 ? small / sizeof(int64_t) : 1024;
+
+    int64_t* in = (int64_t*)allocateMemory(false, large);
+    int64_t* out = (int64_t*)allocateShared(large); // Forked workers write it directly
+    if(in == NULL || out == NULL) {
+        int error = errno;
+        releaseMemory(false, in);
+        freeShared(out);
+        errno = error;
+        return -1;
+    }
+    for(size_t k = 0 ; k < n ; k++) { in[k] = (int64_t)(k % 201) - 100; }
+
+    ExecPolicy serial;
+    serial.engine = WORK_EFFICIENT;
+    serial.backend = THREAD_BACKEND;
+    serial.workers = 1;
+    serial.deviceThreshold = 0;
+    int starters = profile->cores > 1 ? profile->cores : 2;
+    ExecPolicy threads = serial;
+    threads.workers = starters;
+    ExecPolicy processes = serial;
+    processes.backend = PROCESS_BACKEND;
+    processes.workers = starters < 4 ? starters : 4;
+
+    double time;
+    int result = 0;
+    if(result == 0 && (result = timeScan(in, out, smallN, serial, 7, &time)) == 0) { profile->serialNs = time / (smallN*sizeof(int64_t)); }
+    if(result == 0 && (result = timeScan(in, out, n, serial, 3, &time)) == 0) { profile->memoryNs = time / large; }
+    profile->parallelNs = profile->memoryNs;
+    if(result == 0 && profile->cores > 1) {
+        ExecPolicy all = threads;
+        all.workers = profile->cores;
+        if((result = timeScan(in, out, n, all, 3, &time)) == 0) { profile->parallelNs = time / large; }
+    }
+
+    // Scans of a few elements per worker are all overhead, the first one also starts the pool
+    size_t tiny = (size_t)starters*64;
+    if(result == 0 && (result = timeScan(in, out, tiny, threads, 21, &time)) == 0) { profile->threadStartNs = time; }
+    if(result == 0 && (result = timeScan(in, out, tiny, processes, 5, &time)) == 0) {
+        profile->processStartNs = time / processes.workers;
+    }
+
+    int error = errno;
+    releaseMemory(false, in);
+    freeShared(out);
+    errno = error;
+    return result;
+}
+
+int loadProfile(string filename, TuneProfile* profile) {
+    FILE* file = fopen(filename.c_str(), "r");
+    if(file == NULL) { return -1; }
+
+    int version = 0;
+    int found = 0;
+    char line[256];
+    while(fgets(line, sizeof(line), file) != NULL) {
+        char key[64];
+        double value;
+        if(line[0] == '#' || sscanf(line, "%63s %lf", key, &value) != 2) { continue; }
+        if(!isfinite(value) || value < 0) { continue; }
+        if(strcmp(key, "version") == 0) { version = (int)value; }
+        else if(strcmp(key, "cores") == 0) { profile->cores = (int)value; found |= 1; }
+        else if(strcmp(key, "l2_bytes") == 0) { profile->l2Bytes = (size_t)value; found |= 2; }
+        else if(strcmp(key, "cache_bytes") == 0) { profile->cacheBytes = (size_t)value; found |= 4; }
+        else if(strcmp(key, "serial_ns_per_byte") == 0) { profile->serialNs = value; found |= 8; }
+        else if(strcmp(key, "memory_ns_per_byte") == 0) { profile->memoryNs = value; found |= 16; }
+        else if(strcmp(key, "parallel_ns_per_byte") == 0) { profile->parallelNs = value; found |= 32; }
+        else if(strcmp(key, "thread_start_ns") == 0) { profile->threadStartNs = value; found |= 64; }
+        else if(strcmp(key, "process_start_ns") == 0) { profile->processStartNs = value; found |= 128; }
+    }
+    fclose(file);
+
+    // A profile of other CPUs or caches does not describe this machine
+    if(version != PROFILE_VERSION || found != 255 || profile->cores != allowedCpus() || profile->l2Bytes != cacheSize(2) ||
+       profile->cacheBytes != lastLevelCache()) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int saveProfile(string filename, const TuneProfile& profile) {
+    size_t slash = filename.rfind('/');
+    if(slash != string::npos && slash > 0) { mkdir(filename.substr(0, slash).c_str(), 0755); } // It may exist already
+
+    // Written beside the profile and renamed over it, so a reader never sees half a file
+    string temporary = filename + ".tmp." + to_string(getpid());
+    FILE* file = fopen(temporary.c_str(), "w");
+    if(file == NULL) { return -1; }
+    fprintf(file, "# Costs of prefix-sum scans on this machine, measured by calibrateProfile in autotune.h\n");
+    fprintf(file, "version %d\n", PROFILE_VERSION);
+    fprintf(file, "cores %d\n", profile.cores);
+    fprintf(file, "l2_bytes %zu\n", profile.l2Bytes);
+    fprintf(file, "cache_bytes %zu\n", profile.cacheBytes);
+    fprintf(file, "serial_ns_per_byte %.6g\n", profile.serialNs);
+    fprintf(file, "memory_ns_per_byte %.6g\n", profile.memoryNs);
+    fprintf(file, "parallel_ns_per_byte %.6g\n", profile.parallelNs);
+    fprintf(file, "thread_start_ns %.6g\n", profile.threadStartNs);
+    fprintf(file, "process_start_ns %.6g\n", profile.processStartNs);
+    if(fclose(file) != 0 || rename(temporary.c_str(), filename.c_str()) < 0) {
+        int error = errno;
+        unlink(temporary.c_str());
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+int tuneProfile(string filename, bool recalibrate, TuneProfile* profile) {
+    if(!filename.empty() && !recalibrate && loadProfile(filename, profile) == 0) { return 0; }
+    if(calibrateProfile(profile) < 0) { return -1; }
+    if(!filename.empty()) { saveProfile(filename, *profile); }
+    return 0;
+}
+
+double predictScan(const TuneProfile& profile, size_t n, size_t elementSize, Backend backend, int workers) {
+    double bytes = (double)n*elementSize;
+    double l2 = profile.l2Bytes > 0 ? (double)profile.l2Bytes : (double)(1 << 20);
+    double cache = profile.cacheBytes > 0 ? (double)profile.cacheBytes : (double)(32 << 20);
+    double rate = bytes <= l2 ? profile.serialNs :
+                  bytes <= cache ? (profile.serialNs + profile.memoryNs) / 2 : profile.memoryNs;
+    if(workers <= 1) { return (backend == PROCESS_BACKEND ? profile.processStartNs : 0) + bytes*rate; } // A fork even for one
+
+    // Split, the work-efficient engine reads and writes every element twice, and all workers share the memory bandwidth
+    double compute = 2*bytes*rate / workers;
+    if(bytes > cache && compute < bytes*profile.parallelNs) { compute = bytes*profile.parallelNs; }
+    double start = (backend == THREAD_BACKEND) ? profile.threadStartNs : profile.processStartNs*workers;
+    return start + compute;
+}
+
+int autoWorkers(const TuneProfile& profile, size_t n, size_t elementSize, Backend backend) {
+    int cores = profile.cores > 0 ? profile.cores : 1;
+    if((size_t)cores > n) { cores = n > 0 ? (int)n : 1; }
+
+    // Powers of two and every core
+    int best = 1;
+    double bestTime = predictScan(profile, n, elementSize, backend, 1);
+    for(int workers = 2 ; workers <= cores ; workers = (workers*2 > cores) ? cores : workers*2) {
+        double time = predictScan(profile, n, elementSize, backend, workers);
+        if(time < bestTime) {
+            best = workers;
+            bestTime = time;
+        }
+        if(workers == cores) { break; }
+    }
+    return best;
+}
+
+void autoPolicy(const TuneProfile& profile, size_t n, size_t elementSize, ExecPolicy* policy) {
+    int threads = autoWorkers(profile, n, elementSize, THREAD_BACKEND);
+    int processes = autoWorkers(profile, n, elementSize, PROCESS_BACKEND);
+    double threadTime = predictScan(profile, n, elementSize, THREAD_BACKEND, threads);
+    double processTime = predictScan(profile, n, elementSize, PROCESS_BACKEND, processes);
+
+    policy->engine = WORK_EFFICIENT;
+    if(processes > 1 && processTime < threadTime) {
+        policy->backend = PROCESS_BACKEND;
+        policy->workers = processes;
+    }
+    else {
+        // One thread worker runs on the calling thread
+        policy->backend = THREAD_BACKEND;
+        policy->workers = threads;
+    }
+}
+
+} // namespace psum
@@ -0,0 +1,105 @@
+/*
+
+Choosing the backend and the number of workers of a scan from its size. Parallel workers only pay back once the array is
+large enough: a scan on the thread pool costs a wake up of every thread and a barrier, and one on forked workers a fork
+per worker, while a single thread scans a small array with the SIMD kernel in less time than that.
+
+The costs of this machine are measured once and kept in a profile file: the time per byte of a scan on one thread with the
+array in cache and out of it, that of every core together on an array out of cache, and the fixed cost of starting the
+thread pool and of forking a worker. A scan of N elements is then predicted for one thread and for each backend at a few
+worker counts, with the work-efficient engine reading and writing the array twice when it is split, and the cheapest
+prediction wins. The profile also holds the CPUs and cache sizes it was measured with, and is measured again when they
+change.
+
+*/
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <cstddef>
+#include <string>
+
+#include "exec-policy.h"
+
+namespace psum {
+
+/* Measured costs of the machine */
+struct TuneProfile {
+    int cores;              // CPUs this process may use
+    size_t l2Bytes;         // cache sizes of the first CPU
+    size_t cacheBytes;      // last level cache
+    double serialNs;        // ns per byte of a scan on one thread, in cache
+    double memoryNs;        // ns per byte of a scan on one thread, out of cache
+    double parallelNs;      // ns per byte of a scan on every core, out of cache
+    double threadStartNs;   // fixed cost of a scan on the thread pool with every core
+    double processStartNs;  // cost of forking one worker
+};
+
+/*
+Get the path of the profile: $PSUM_PROFILE, or prefix-sum.profile in $XDG_CACHE_HOME or ~/.cache
+return      the path, or an empty string if there is no home directory
+*/
+std::string defaultProfilePath();
+
+/*
+Measure the costs of this machine, which takes about a second
+param       profile -- Pointer to the profile to be filled in
+return      0 if successful, or -1 if the memory or the workers for the measurements could not be allocated
+*/
+int calibrateProfile(TuneProfile* profile);
+
+/*
+Read a profile file
+param       filename -- path of the file
+            profile -- Pointer to the profile to be filled in
+return      0 if successful, or -1 if the file cannot be read, with errno EINVAL if it is not valid or was measured on a
+            machine with other CPUs or caches
+*/
+int loadProfile(std::string filename, TuneProfile* profile);
+
+/*
+Write a profile file, replacing it atomically
+param       filename -- path of the file, its directory is created if it is missing
+            profile -- the profile
+return      0 if successful, or -1 if the file cannot be written
+*/
+int saveProfile(std::string filename, const TuneProfile& profile);
+
+/*
+Read the profile, or measure it and write it if there is none or it is out of date
+param       filename -- path of the profile, empty to measure without keeping the result
+            recalibrate -- true to measure again whatever the file holds
+            profile -- Pointer to the profile to be filled in
+return      0 if successful, or -1 if it could not be measured. Failing to write the file is not an error.
+*/
+int tuneProfile(std::string filename, bool recalibrate, TuneProfile* profile);
+
+/*
+Predict the time of a scan
+param       profile -- the measured costs
+            n -- the number of elements
+            elementSize -- the size of an element in bytes
+            backend -- where the workers run
+            workers -- the number of workers, 1 on the thread backend for the block kernel on the calling thread
+return      the predicted time in nanoseconds
+*/
+double predictScan(const TuneProfile& profile, size_t n, size_t elementSize, Backend backend, int workers);
+
+/*
+Choose the number of workers of a scan on one backend
+param       profile, n, elementSize, backend -- as for predictScan
+return      the number of workers with the least predicted time, from 1 to the number of cores
+*/
+int autoWorkers(const TuneProfile& profile, size_t n, size_t elementSize, Backend backend);
+
+/*
+Choose the backend, the number of workers and the engine of a scan. One worker on the thread backend runs the block kernel
+on the calling thread.
+param       profile, n, elementSize -- as for predictScan
+            policy -- Pointer to the policy to be changed
+*/
+void autoPolicy(const TuneProfile& profile, size_t n, size_t elementSize, ExecPolicy* policy);
+
+} // namespace psum
+
+#endif
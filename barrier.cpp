@@ -0,0 +1,172 @@
+/*
+
+Implementation of the barriers declared in barrier.h
+
+*/
+
+#include "barrier.h"
+
+#include <climits>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace psum {
+
+/*
+Pause briefly inside a spin loop. After many spins the processor is given up, so that the processes still make progress when
+there are fewer cores than workers.
+param       spins -- the number of times the caller has spun so far
+*/
+void spinPause(int spins) {
+    if(spins < 1024) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    else {
+        sched_yield();
+    }
+}
+
+/*
+Determine the distance between the dissemination flags of two processes, whole cache lines so that a process spinning on its
+flags does not share a line with the others
+param       rounds -- the number of dissemination rounds
+return      the number of ints
+*/
+static int flagStride(int rounds) {
+    int perLine = (int)(CACHE_LINE / sizeof(int));
+    return (rounds + perLine - 1) / perLine * perLine;
+}
+
+/*
+Determine the size of the barrier state, including the dissemination flags
+param       processes -- the total number of processes
+return      the number of bytes needed
+*/
+size_t barrierSize(int processes) {
+    int rounds = 0;
+    while((1 << rounds) < processes) { rounds++; }
+    return sizeof(Barrier) + sizeof(int)*flagStride(rounds)*processes;
+}
+
+/*
+Initialize the barrier before any worker is started
+param       barrier -- Pointer to the barrier, barrierSize(processes) bytes long
+            type -- the kind of barrier to be used
+            processes -- the total number of processes
+*/
+void initBarrier(Barrier* barrier, BarrierType type, int processes) {
+    barrier->type = type;
+    barrier->processes = processes;
+    barrier->rounds = 0;
+    while((1 << barrier->rounds) < processes) { barrier->rounds++; }
+    barrier->counter = 0;
+    barrier->sense = 0;
+    barrier->generation = 0;
+
+    int* flags = (int*)(barrier + 1);
+    for(int i = 0; i < flagStride(barrier->rounds)*processes; i++) {
+        flags[i] = 0;
+    }
+}
+
+/* 
+Original barrier: processes increment the counter strictly in order
+param       turn -- Pointer to the barrier counter
+            thisProcess -- the number associated with the current process
+            iter -- the number of the current episode
+            processes -- the total number of processes
+*/
+static void counterBarrier(int* turn, int thisProcess, int iter, int processes) {
+    int spins = 0;
+    while(__atomic_load_n(turn, __ATOMIC_ACQUIRE) != ((iter*processes) + thisProcess)) { spinPause(spins++); } // Current process must wait for its turn
+    __atomic_store_n(turn, turn[0] + 1, __ATOMIC_RELEASE); // Increment the barrier since it's our turn
+    spins = 0;
+    while(__atomic_load_n(turn, __ATOMIC_ACQUIRE) < ((iter+1)*processes)) { spinPause(spins++); } // Wait for all processes to have their turn for this iteration
+}
+
+/*
+Centralized sense-reversing barrier: every process increments the arrival count once, in any order, and the last one to
+arrive resets the count and flips the global sense that the others spin on.
+param       barrier -- Pointer to the shared barrier
+            iter -- the number of the current episode, its parity is the local sense
+*/
+static void senseBarrier(Barrier* barrier, int iter) {
+    int localSense = (iter + 1) & 1;
+
+    if(__atomic_add_fetch(&barrier->counter, 1, __ATOMIC_ACQ_REL) == barrier->processes) {
+        __atomic_store_n(&barrier->counter, 0, __ATOMIC_RELAXED); // Reset for the next episode before releasing anyone
+        __atomic_store_n(&barrier->sense, localSense, __ATOMIC_RELEASE);
+        return;
+    }
+
+    int spins = 0;
+    while(__atomic_load_n(&barrier->sense, __ATOMIC_ACQUIRE) != localSense) { spinPause(spins++); }
+}
+
+/*
+Dissemination barrier: in round r every process signals the process 2^r ahead of it and waits for the process 2^r behind
+it, so there are ceil(log2(processes)) rounds and no location is written by more than one process.
+param       barrier -- Pointer to the shared barrier
+            thisProcess -- the number associated with the current process
+            iter -- the number of the current episode
+*/
+static void disseminationBarrier(Barrier* barrier, int thisProcess, int iter) {
+    int* flags = (int*)(barrier + 1);
+    int processes = barrier->processes;
+    int stride = flagStride(barrier->rounds);
+
+    for(int r = 0; r < barrier->rounds; r++) {
+        int partner = (thisProcess + (1 << r)) % processes;
+        __atomic_store_n(&flags[partner*stride + r], iter + 1, __ATOMIC_RELEASE); // Signal the partner
+
+        // Flags only ever grow, so a signal for a later episode also releases this one
+        int spins = 0;
+        while(__atomic_load_n(&flags[thisProcess*stride + r], __ATOMIC_ACQUIRE) < iter + 1) { spinPause(spins++); }
+    }
+}
+
+/*
+Blocking barrier: waiting processes sleep in the kernel on the generation word instead of spinning
+param       barrier -- Pointer to the shared barrier
+*/
+static void futexBarrier(Barrier* barrier) {
+    int generation = __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+
+    if(__atomic_add_fetch(&barrier->counter, 1, __ATOMIC_ACQ_REL) == barrier->processes) {
+        __atomic_store_n(&barrier->counter, 0, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&barrier->generation, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, &barrier->generation, FUTEX_WAKE, INT_MAX, NULL, NULL, 0); // Wake every sleeper
+        return;
+    }
+
+    // Spin for a short while first, the episode often ends before sleeping would pay off
+    for(int spins = 0; spins < 1024; spins++) {
+        if(__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE) != generation) { return; }
+        spinPause(spins);
+    }
+    while(__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE) == generation) {
+        // Returns straight away if the generation already moved on, or on a spurious wake up
+        syscall(SYS_futex, &barrier->generation, FUTEX_WAIT, generation, NULL, NULL, 0);
+    }
+}
+
+/* 
+Synchronize the processes with the barrier
+param       barrier -- Pointer to the shared barrier
+            thisProcess -- the number associated with the current process
+            iter -- the number of the current episode, which must grow by one with every call
+*/
+void synchronize(Barrier* barrier, int thisProcess, int iter) {
+    switch(barrier->type) {
+        case COUNTER_BARRIER: counterBarrier(&barrier->counter, thisProcess, iter, barrier->processes); break;
+        case SENSE_BARRIER: senseBarrier(barrier, iter); break;
+        case DISSEMINATION_BARRIER: disseminationBarrier(barrier, thisProcess, iter); break;
+        case FUTEX_BARRIER: futexBarrier(barrier); break;
+    }
+}
+
+} // namespace psum
@@ -0,0 +1,69 @@
+/*
+
+Barriers shared by the scan workers. The barrier state is plain memory, so it works the same whether it is placed in a
+shared memory segment used by forked processes or on the heap of a process running threads.
+
+The sense-reversing centralized barrier has space complexity of O(1). The original turn-taking counter, a dissemination
+barrier and a futex-backed blocking barrier can be selected instead.
+
+*/
+
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <cstddef>
+
+namespace psum {
+
+/* Size of a cache line. State written by different workers is kept on separate lines, so they do not bounce them. */
+const size_t CACHE_LINE = 64;
+
+/* Barriers selectable by the caller */
+enum BarrierType { COUNTER_BARRIER, SENSE_BARRIER, DISSEMINATION_BARRIER, FUTEX_BARRIER };
+
+/*
+Barrier state shared by all workers, on a cache line of its own. The dissemination flags follow the struct in memory, with
+the flags of each worker on their own line.
+*/
+struct alignas(CACHE_LINE) Barrier {
+    int type;           // BarrierType in use
+    int processes;      // number of workers taking part
+    int rounds;         // dissemination rounds, ceil(log2(processes))
+    int counter;        // turn counter, or arrival count for the sense-reversing and futex barriers
+    int sense;          // global sense of the sense-reversing barrier
+    int generation;     // completed episodes of the futex barrier, also the futex word
+};
+
+/*
+Pause briefly inside a spin loop. After many spins the processor is given up, so that the workers still make progress when
+there are fewer cores than workers.
+param       spins -- the number of times the caller has spun so far
+*/
+void spinPause(int spins);
+
+/*
+Determine the size of the barrier state, including the dissemination flags
+param       processes -- the total number of workers
+return      the number of bytes needed, a whole number of cache lines
+*/
+size_t barrierSize(int processes);
+
+/*
+Initialize the barrier before any worker is started
+param       barrier -- Pointer to the barrier, barrierSize(processes) bytes long and aligned to CACHE_LINE
+            type -- the kind of barrier to be used
+            processes -- the total number of workers
+*/
+void initBarrier(Barrier* barrier, BarrierType type, int processes);
+
+/* 
+Synchronize the workers with the barrier
+param       barrier -- Pointer to the shared barrier
+            thisProcess -- the number associated with the current worker
+            iter -- the number of the current episode, which must grow by one with every call
+*/
+void synchronize(Barrier* barrier, int thisProcess, int iter);
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,49 @@
+/*
+
+Implementation of the batch planning declared in batch-scan.h
+
+*/
+
+#include "batch-scan.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+using namespace std;
+
+namespace psum {
+
+void planBatch(const size_t* costs, size_t count, int workers, size_t minSplit, BatchPlan* plan) {
+    if(workers < 1) { workers = 1; }
+    plan->packed.clear();
+    plan->split.clear();
+
+    double total = 0;
+    for(size_t i = 0 ; i < count ; i++) { total += (double)costs[i]; }
+
+    // A job larger than a worker's share would keep its worker busy after the others are done
+    vector<size_t> order;
+    for(size_t i = 0 ; i < count ; i++) {
+        if(workers > 1 && costs[i] >= minSplit && (double)costs[i]*workers > total) { plan->split.push_back(i); }
+        else { order.push_back(i); }
+    }
+    if(order.empty()) { return; }
+
+    // Largest first onto the least loaded worker, ties go to the lower worker
+    stable_sort(order.begin(), order.end(), [costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+    size_t used = order.size() < (size_t)workers ? order.size() : (size_t)workers;
+    plan->packed.resize(used);
+    priority_queue<pair<double, size_t>, vector<pair<double, size_t> >, greater<pair<double, size_t> > > loads;
+    for(size_t j = 0 ; j < used ; j++) { loads.push(make_pair(0.0, j)); }
+    for(size_t k = 0 ; k < order.size() ; k++) {
+        pair<double, size_t> least = loads.top();
+        loads.pop();
+        plan->packed[least.second].push_back(order[k]);
+        least.first += (double)costs[order[k]] + 1; // Every job costs something, even an empty one
+        loads.push(least);
+    }
+}
+
+} // namespace psum
@@ -0,0 +1,97 @@
+/*
+
+Batches of independent scans on one pool of workers. Thousands of small arrays cost a start of the workers each when every
+one is scanned on its own, and the workers of a small scan mostly wait at the barrier. Here the batch is planned once:
+
+    small arrays are packed onto the workers whole, the largest first onto the least loaded worker, and every worker scans
+    its arrays one after the other alone, with the block kernel and no barrier
+    large arrays, of at least BATCH_SPLIT elements and more than a worker's share of the batch, are split across all the
+    workers one after the other, as they would be on their own
+
+so scans per second grow with the workers instead of being held up by their start. The workers are always threads.
+
+*/
+
+#ifndef BATCH_SCAN_H
+#define BATCH_SCAN_H
+
+#include <cstddef>
+#include <vector>
+
+#include "exec-policy.h"
+#include "scan-engine.h"
+
+namespace psum {
+
+/* Arrays of at least this many elements may be split across the workers */
+const size_t BATCH_SPLIT = 1 << 16;
+
+/* Which worker runs which job of a batch */
+struct BatchPlan {
+    std::vector<std::vector<size_t> > packed;   // jobs every worker runs alone, largest first, one list per worker
+    std::vector<size_t> split;                  // jobs run by all the workers together, in the order of the batch
+};
+
+/* One array of a batch */
+template<class T>
+struct BatchArray {
+    const T* in;
+    T* out;        // may be the same as in
+    size_t n;
+};
+
+/*
+Plan a batch of jobs
+param       costs -- the cost of every job, such as its elements or bytes
+            count -- the number of jobs
+            workers -- the number of workers
+            minSplit -- the least cost of a job that is split across the workers
+            plan -- Pointer to the plan to be filled in, with a list for each worker that has packed jobs
+*/
+void planBatch(const size_t* costs, size_t count, int workers, size_t minSplit, BatchPlan* plan);
+
+/*
+Inclusive scans of a batch of arrays
+param       arrays -- the arrays
+            count -- the number of arrays
+            op -- the associative operator
+            policy -- the workers, they always run as threads. The engine and the affinity apply to the split arrays.
+return      0 if successful, or -1 if a scan failed
+*/
+template<class T, class Op>
+int batchScan(const BatchArray<T>* arrays, size_t count, Op op, const ExecPolicy& policy) {
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    std::vector<size_t> costs(count);
+    for(size_t i = 0 ; i < count ; i++) { costs[i] = arrays[i].n; }
+    BatchPlan plan;
+    planBatch(costs.data(), count, workers, BATCH_SPLIT, &plan);
+
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    ExecPolicy alone = threads; // scan runs one work-efficient worker on the calling thread
+    alone.workers = 1;
+    alone.engine = WORK_EFFICIENT;
+    alone.affinity = AFFINITY_NONE;
+    alone.trace = NULL;
+
+    std::vector<char> failed(plan.packed.size(), 0);
+    if(!plan.packed.empty() && runWorkers(threads, (int)plan.packed.size(), [&](int j) {
+        for(size_t k = 0 ; k < plan.packed[j].size() ; k++) {
+            const BatchArray<T>& array = arrays[plan.packed[j][k]];
+            if(scan(array.in, array.out, array.n, false, T(), op, alone) < 0) { failed[j] = 1; }
+        }
+    }) < 0) { return -1; }
+    for(size_t j = 0 ; j < failed.size() ; j++) {
+        if(failed[j]) { return -1; }
+    }
+
+    for(size_t k = 0 ; k < plan.split.size() ; k++) {
+        const BatchArray<T>& array = arrays[plan.split[k]];
+        if(scan(array.in, array.out, array.n, false, T(), op, threads) < 0) { return -1; }
+    }
+    return 0;
+}
+
+} // namespace psum
+
+#endif
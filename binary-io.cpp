@@ -0,0 +1,258 @@
+/*
+
+Implementation of the binary array files declared in binary-io.h
+
+*/
+
+#include "binary-io.h"
+#include "shared-memory.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <cstring>
+
+using namespace std;
+
+namespace psum {
+
+// The elements are stored as they are in memory, which is only the file's byte order on little-endian hosts
+static const bool NATIVE_LITTLE_ENDIAN = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+
+void initBinaryHeader(BinaryHeader* header, BinaryType type, size_t elementSize, size_t count) {
+    memset(header, 0, sizeof(BinaryHeader));
+    memcpy(header->magic, "PSUM", 4);
+    header->version = 1;
+    header->type = type;
+    header->elementSize = (uint32_t)elementSize;
+    header->count = count;
+}
+
+int checkBinaryHeader(const BinaryHeader* header, BinaryType type, size_t elementSize) {
+    if(memcmp(header->magic, "PSUM", 4) != 0 || header->version != 1 || header->type != (uint32_t)type || header->elementSize != elementSize) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Read or write a whole buffer, continuing after short transfers
+param       fd -- the file descriptor
+            buffer -- Pointer to the bytes
+            size -- the number of bytes
+            offset -- position in the file, or -1 for the current position of a file that cannot seek, like a pipe
+            writing -- true to write, false to read
+return      the number of bytes transferred, less than size only at the end of the file, or -1 on error
+*/
+static long long transferAll(int fd, char* buffer, size_t size, off_t offset, bool writing) {
+    size_t done = 0;
+    while(done < size) {
+        ssize_t n;
+        if(offset < 0) { n = writing ? write(fd, buffer + done, size - done) : read(fd, buffer + done, size - done); }
+        else { n = writing ? pwrite(fd, buffer + done, size - done, offset + done) : pread(fd, buffer + done, size - done, offset + done); }
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n < 0) { return -1; }
+        if(n == 0) { break; } // End of the file
+        done += n;
+    }
+    return (long long)done;
+}
+
+long long readBinaryArray(string filename, BinaryType type, size_t elementSize, void* array, size_t N) {
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) { return -1; }
+
+    BinaryHeader header;
+    if(transferAll(fd, (char*)&header, sizeof(header), 0, false) != (long long)sizeof(header) || checkBinaryHeader(&header, type, elementSize) < 0) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t count = header.count < N ? header.count : N; // Do not go out of range
+    long long bytes = transferAll(fd, (char*)array, count*elementSize, BINARY_HEADER_SIZE, false);
+    close(fd);
+    if(bytes < 0) { return -1; }
+    return bytes / (long long)elementSize;
+}
+
+int writeBinaryArray(string filename, BinaryType type, size_t elementSize, const void* array, size_t N) {
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) { return -1; }
+
+    BinaryHeader header;
+    initBinaryHeader(&header, type, elementSize, N);
+    if(transferAll(fd, (char*)&header, sizeof(header), 0, true) != (long long)sizeof(header) ||
+       transferAll(fd, (char*)array, N*elementSize, BINARY_HEADER_SIZE, true) != (long long)(N*elementSize)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return close(fd);
+}
+
+long long readBinaryRange(string filename, BinaryType type, size_t elementSize, void* array, size_t first, size_t N) {
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) { return -1; }
+
+    BinaryHeader header;
+    if(transferAll(fd, (char*)&header, sizeof(header), 0, false) != (long long)sizeof(header) || checkBinaryHeader(&header, type, elementSize) < 0) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Only the part of the range the file holds
+    size_t count = 0;
+    if(first < header.count) { count = header.count - first < N ? header.count - first : N; }
+    long long bytes = transferAll(fd, (char*)array, count*elementSize, BINARY_HEADER_SIZE + first*elementSize, false);
+    close(fd);
+    if(bytes < 0) { return -1; }
+    return bytes / (long long)elementSize;
+}
+
+int writeBinaryRange(string filename, BinaryType type, size_t elementSize, const void* array, size_t first, size_t N,
+                     size_t total) {
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    // Every writer sets the same size and header, so none of them truncates another one's range
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if(fd < 0) { return -1; }
+
+    BinaryHeader header;
+    initBinaryHeader(&header, type, elementSize, total);
+    if(ftruncate(fd, BINARY_HEADER_SIZE + total*elementSize) < 0 ||
+       transferAll(fd, (char*)&header, sizeof(header), 0, true) != (long long)sizeof(header) ||
+       transferAll(fd, (char*)array, N*elementSize, BINARY_HEADER_SIZE + first*elementSize, true) != (long long)(N*elementSize)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return close(fd);
+}
+
+int openBinaryStream(string filename, BinaryType type, size_t elementSize, size_t* count) {
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) { return -1; }
+
+    BinaryHeader header;
+    if(transferAll(fd, (char*)&header, sizeof(header), -1, false) != (long long)sizeof(header) || checkBinaryHeader(&header, type, elementSize) < 0) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    *count = header.count;
+    return fd;
+}
+
+int createBinaryStream(string filename, BinaryType type, size_t elementSize, size_t count) {
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) { return -1; }
+
+    BinaryHeader header;
+    initBinaryHeader(&header, type, elementSize, count);
+    if(transferAll(fd, (char*)&header, sizeof(header), -1, true) != (long long)sizeof(header)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+long long readElements(int fd, size_t elementSize, void* array, size_t N) {
+    long long bytes = transferAll(fd, (char*)array, N*elementSize, -1, false);
+    if(bytes < 0) { return -1; }
+    return bytes / (long long)elementSize;
+}
+
+int writeElements(int fd, size_t elementSize, const void* array, size_t N) {
+    if(transferAll(fd, (char*)array, N*elementSize, -1, true) != (long long)(N*elementSize)) { return -1; }
+    return 0;
+}
+
+int mapInputArray(string filename, BinaryType type, size_t elementSize, MappedArray* map) {
+    map->base = NULL;
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) { return -1; }
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || (size_t)info.st_size < BINARY_HEADER_SIZE) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void* base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if(base == MAP_FAILED) { return -1; }
+
+    // The file must hold as many elements as its header claims
+    const BinaryHeader* header = (const BinaryHeader*)base;
+    if(checkBinaryHeader(header, type, elementSize) < 0 || header->count > (info.st_size - BINARY_HEADER_SIZE) / elementSize) {
+        munmap(base, info.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    madvise(base, info.st_size, MADV_SEQUENTIAL);
+    map->base = base;
+    map->length = info.st_size;
+    map->data = (char*)base + BINARY_HEADER_SIZE;
+    map->count = header->count;
+    return 0;
+}
+
+int mapOutputArray(string filename, BinaryType type, size_t elementSize, size_t count, MappedArray* map) {
+    map->base = NULL;
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) { return -1; }
+
+    size_t length = BINARY_HEADER_SIZE + count*elementSize;
+    if(ftruncate(fd, length) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    void* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) { return -1; }
+
+    initBinaryHeader((BinaryHeader*)base, type, elementSize, count);
+    map->base = base;
+    map->length = length;
+    map->data = (char*)base + BINARY_HEADER_SIZE;
+    map->count = count;
+    registerShared(map->data, count*elementSize);
+    return 0;
+}
+
+void unmapArray(MappedArray* map) {
+    if(map->base == NULL) { return; }
+    unregisterShared(map->data); // Only registered for output files
+    munmap(map->base, map->length);
+    map->base = NULL;
+}
+
+} // namespace psum
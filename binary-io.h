@@ -0,0 +1,197 @@
+/*
+
+Raw binary array files. A file is a 64-byte header followed by the elements in little-endian order:
+
+    offset  0   char[4]     magic "PSUM"
+            4   uint32      format version, 1
+            8   uint32      element type (BinaryType)
+           12   uint32      element size in bytes
+           16   uint64      number of elements
+           24   reserved, zero up to offset 64
+
+The header size keeps the elements aligned, so a file can be memory-mapped and used directly as a scan buffer: the input
+without parsing or copying, and the output written by the workers straight into the page cache.
+
+*/
+
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace psum {
+
+/* Element types of a binary file */
+enum BinaryType { BINARY_INT32 = 1, BINARY_INT64 = 2, BINARY_UINT64 = 3, BINARY_FLOAT = 4, BINARY_DOUBLE = 5, BINARY_UINT32 = 6 };
+
+/* Size of the header before the first element */
+const size_t BINARY_HEADER_SIZE = 64;
+
+/* Header at the start of a binary file */
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t type;
+    uint32_t elementSize;
+    uint64_t count;
+    uint8_t reserved[BINARY_HEADER_SIZE - 24];
+};
+
+/* Element type code of each supported element type */
+template<class T> struct BinaryTypeOf;
+template<> struct BinaryTypeOf<int32_t> { static const BinaryType value = BINARY_INT32; };
+template<> struct BinaryTypeOf<int64_t> { static const BinaryType value = BINARY_INT64; };
+template<> struct BinaryTypeOf<uint32_t> { static const BinaryType value = BINARY_UINT32; };
+template<> struct BinaryTypeOf<uint64_t> { static const BinaryType value = BINARY_UINT64; };
+template<> struct BinaryTypeOf<float> { static const BinaryType value = BINARY_FLOAT; };
+template<> struct BinaryTypeOf<double> { static const BinaryType value = BINARY_DOUBLE; };
+
+/* A memory-mapped binary file */
+struct MappedArray {
+    void* base;         // start of the mapping, NULL when nothing is mapped
+    size_t length;      // length of the mapping
+    void* data;         // first element
+    size_t count;       // number of elements in the file
+};
+
+/*
+Fill in a header
+param       header -- Pointer to the header
+            type -- the element type
+            elementSize -- the size of an element in bytes
+            count -- the number of elements
+*/
+void initBinaryHeader(BinaryHeader* header, BinaryType type, size_t elementSize, size_t count);
+
+/*
+Check the header of a binary file
+param       header -- Pointer to the header read from the file
+            type -- the expected element type
+            elementSize -- the expected element size
+return      0 if valid, or -1 if the file is not a binary array of this type
+*/
+int checkBinaryHeader(const BinaryHeader* header, BinaryType type, size_t elementSize);
+
+/*
+Read the elements of a binary file into an array
+param       filename -- path of the file to be read
+            type -- the expected element type
+            elementSize -- the size of an element in bytes
+            array -- Pointer to the first element of the array
+            N -- the number of values to be read
+return      the number of values read, or -1 if the file cannot be read or has the wrong type
+*/
+long long readBinaryArray(std::string filename, BinaryType type, size_t elementSize, void* array, size_t N);
+
+/*
+Write an array as a binary file
+param       filename -- path of the file to be written to
+            type -- the element type
+            elementSize -- the size of an element in bytes
+            array -- Pointer to the first element of the array
+            N -- the number of elements
+return      0 if successful, or -1 if the file cannot be written
+*/
+int writeBinaryArray(std::string filename, BinaryType type, size_t elementSize, const void* array, size_t N);
+
+/*
+Read a range of the elements of a binary file, for a process that handles one slice of the array
+param       filename -- path of the file to be read
+            type -- the expected element type
+            elementSize -- the size of an element in bytes
+            array -- Pointer to the first element of the array
+            first -- the index of the first element of the range
+            N -- the number of values to be read
+return      the number of values read, less than N if the file ends before the range, or -1 if the file cannot be read or
+            has the wrong type
+*/
+long long readBinaryRange(std::string filename, BinaryType type, size_t elementSize, void* array, size_t first, size_t N);
+
+/*
+Write a range of the elements of a binary file. The file is created with the given total if it does not exist, so processes
+writing their slices may do so in any order and at the same time.
+param       filename -- path of the file to be written to
+            type -- the element type
+            elementSize -- the size of an element in bytes
+            array -- Pointer to the first element of the range
+            first -- the index of the first element of the range
+            N -- the number of elements of the range
+            total -- the number of elements of the whole file
+return      0 if successful, or -1 if the file cannot be written
+*/
+int writeBinaryRange(std::string filename, BinaryType type, size_t elementSize, const void* array, size_t first, size_t N,
+                     size_t total);
+
+/*
+Open a binary file to be read in order, which works for pipes as well
+param       filename -- path of the file to be read
+            type -- the expected element type
+            elementSize -- the size of an element in bytes
+            count -- Pointer receiving the number of elements given by the header
+return      the file descriptor positioned at the first element, or -1 if the file cannot be read or has the wrong type
+*/
+int openBinaryStream(std::string filename, BinaryType type, size_t elementSize, size_t* count);
+
+/*
+Create a binary file to be written in order, which works for pipes as well
+param       filename -- path of the file to be written to
+            type -- the element type
+            elementSize -- the size of an element in bytes
+            count -- the number of elements that will be written
+return      the file descriptor positioned at the first element, or -1 if the file cannot be written
+*/
+int createBinaryStream(std::string filename, BinaryType type, size_t elementSize, size_t count);
+
+/*
+Read the next elements of a stream from openBinaryStream
+param       fd -- the file descriptor
+            elementSize -- the size of an element in bytes
+            array -- Pointer to the first element of the array
+            N -- the number of elements to be read
+return      the number of elements read, less than N only at the end of the file, or -1 on error
+*/
+long long readElements(int fd, size_t elementSize, void* array, size_t N);
+
+/*
+Write the next elements of a stream from createBinaryStream
+param       fd -- the file descriptor
+            elementSize -- the size of an element in bytes
+            array -- Pointer to the first element of the array
+            N -- the number of elements
+return      0 if successful, or -1 on error
+*/
+int writeElements(int fd, size_t elementSize, const void* array, size_t N);
+
+/*
+Map a binary file for reading. The mapping is private and read-only, forked workers share its pages.
+param       filename -- path of the file to be mapped
+            type -- the expected element type
+            elementSize -- the size of an element in bytes
+            map -- Pointer to the mapping to be filled in
+return      0 if successful, or -1 if the file cannot be mapped or has the wrong type
+*/
+int mapInputArray(std::string filename, BinaryType type, size_t elementSize, MappedArray* map);
+
+/*
+Create a binary file of the given size and map it for writing. The mapping is shared, so writes by forked workers go to the
+file, and it is registered with registerShared for the process backend.
+param       filename -- path of the file to be created
+            type -- the element type
+            elementSize -- the size of an element in bytes
+            count -- the number of elements
+            map -- Pointer to the mapping to be filled in
+return      0 if successful, or -1 if the file cannot be created or mapped
+*/
+int mapOutputArray(std::string filename, BinaryType type, size_t elementSize, size_t count, MappedArray* map);
+
+/*
+Unmap a file from mapInputArray or mapOutputArray
+param       map -- Pointer to the mapping, nothing happens if it is not mapped
+*/
+void unmapArray(MappedArray* map);
+
+} // namespace psum
+
+#endif
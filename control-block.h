@@ -0,0 +1,121 @@
+/*
+
+The control block shared by the workers of one scan: the barrier on cache lines of its own, followed by one cache-line slot
+per worker or chunk for everything a worker publishes to the others, and one cache-line counter per pass for the workers to
+claim chunks from. Packing per-worker values next to each other would put several workers' writes on one line, and every
+write would pull the line away from the workers spinning on or writing next to it.
+
+    barrier, dissemination flags        barrierSize(workers), whole lines
+    slot 0                              one or more lines
+    slot 1
+    ...
+    counter 0                           one line
+    counter 1
+    ...
+
+The block lives in memory from allocateMemory, shared when the workers are forked processes.
+
+*/
+
+#ifndef CONTROL_BLOCK_H
+#define CONTROL_BLOCK_H
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "barrier.h"
+#include "shared-memory.h"
+
+namespace psum {
+
+/* State of a worker in its slot */
+enum WorkerStatus { WORKER_STARTED = 0, WORKER_FINISHED = 1 };
+
+/* What a worker publishes, padded to whole cache lines */
+template<class T>
+struct alignas(CACHE_LINE) WorkerSlot {
+    T total;            // total of the chunk with the slot's number, for the work-efficient engine
+    int status;         // WorkerStatus, set to WORKER_FINISHED by the worker with the slot's number when it is done
+};
+
+/* Next chunk to be claimed in one pass of a scan, padded to a cache line */
+struct alignas(CACHE_LINE) ClaimCounter {
+    size_t next;
+};
+
+/* A control block and its memory */
+template<class T>
+struct ControlBlock {
+    Barrier* barrier;
+    WorkerSlot<T>* slots;   // one per worker or chunk, whichever are more
+    ClaimCounter* counters; // one per pass, starting at 0
+    int workers;
+    void* memory;           // the allocation, which the block is aligned inside
+    bool shared;
+};
+
+/*
+Allocate and initialize a control block
+param       control -- Pointer to the block to be filled in
+            type -- the barrier to be used
+            workers -- the number of workers
+            chunks -- the number of chunks
+            passes -- the number of counters
+            shared -- true if the workers are forked processes
+return      0 if successful, or -1 if the memory could not be allocated
+*/
+template<class T>
+int createControlBlock(ControlBlock<T>* control, BarrierType type, int workers, int chunks, int passes, bool shared) {
+    size_t barrierBytes = (barrierSize(workers) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    int slots = chunks > workers ? chunks : workers;
+    size_t size = barrierBytes + sizeof(WorkerSlot<T>)*slots + sizeof(ClaimCounter)*passes;
+
+    // Segments are page aligned, heap memory is aligned here
+    control->memory = allocateMemory(shared, size + CACHE_LINE);
+    control->barrier = NULL;
+    control->slots = NULL;
+    control->counters = NULL;
+    control->shared = shared;
+    control->workers = workers;
+    if(control->memory == NULL) { return -1; }
+
+    uintptr_t start = ((uintptr_t)control->memory + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    control->barrier = (Barrier*)start;
+    control->slots = (WorkerSlot<T>*)(start + barrierBytes);
+    control->counters = (ClaimCounter*)(control->slots + slots);
+    initBarrier(control->barrier, type, workers);
+    for(int j = 0 ; j < slots ; j++) {
+        control->slots[j].status = WORKER_STARTED;
+    }
+    for(int p = 0 ; p < passes ; p++) {
+        control->counters[p].next = 0;
+    }
+    return 0;
+}
+
+/*
+Determine if every worker reached the end of its task, which a forked worker that died on the way does not
+param       control -- Pointer to the block
+return      true if all slots are WORKER_FINISHED
+*/
+template<class T>
+bool allFinished(const ControlBlock<T>* control) {
+    for(int j = 0 ; j < control->workers ; j++) {
+        if(__atomic_load_n(&control->slots[j].status, __ATOMIC_ACQUIRE) != WORKER_FINISHED) { return false; }
+    }
+    return true;
+}
+
+/*
+Release a block from createControlBlock
+param       control -- Pointer to the block, nothing happens if it was never allocated
+*/
+template<class T>
+void releaseControlBlock(ControlBlock<T>* control) {
+    releaseMemory(control->shared, control->memory);
+    control->memory = NULL;
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,32 @@
+/*
+
+Stand-in for the device backend when the library is built without one, see device-scan.h. No device is ever available, and
+scan falls back to the CPU engines.
+
+*/
+
+#include "device-scan.h"
+
+#include <errno.h>
+
+namespace psum {
+
+bool deviceAvailable() {
+    return false;
+}
+
+/*
+Fail every device scan
+return      -1 with errno ENOSYS
+*/
+static int noDevice() {
+    errno = ENOSYS;
+    return -1;
+}
+
+int deviceScan(const int32_t*, int32_t*, size_t, bool, int32_t) { return noDevice(); }
+int deviceScan(const int64_t*, int64_t*, size_t, bool, int64_t) { return noDevice(); }
+int deviceScan(const float*, float*, size_t, bool, float) { return noDevice(); }
+int deviceScan(const double*, double*, size_t, bool, double) { return noDevice(); }
+
+} // namespace psum
@@ -0,0 +1,296 @@
+/*
+
+Device backend declared in device-scan.h, for CUDA (nvcc) or HIP (hipcc -x hip).
+
+The scan is a single pass with decoupled look-back. Each thread block takes the next tile from a counter, so tiles start in
+order, scans it in shared memory and publishes its total in a status word. Finding the total of everything before it means
+walking back over the tiles before it: a tile that published its inclusive prefix ends the walk, a tile that only published
+its own total is added and the walk goes on. Every element is read and written once.
+
+Host memory is paged, so the input is copied to the device in parts through two pinned buffers: while one part is
+transferred the next one is copied into the other buffer. The result comes back the same way.
+
+*/
+
+#include "device-scan.h"
+
+#include <cstring>
+#include <errno.h>
+#include <mutex>
+
+#if defined(__HIPCC__)
+#include <hip/hip_runtime.h>
+#define cudaError_t hipError_t
+#define cudaSuccess hipSuccess
+#define cudaStream_t hipStream_t
+#define cudaMalloc hipMalloc
+#define cudaFree hipFree
+#define cudaHostAlloc hipHostMalloc
+#define cudaHostAllocDefault hipHostMallocDefault
+#define cudaFreeHost hipHostFree
+#define cudaMemcpyAsync hipMemcpyAsync
+#define cudaMemsetAsync hipMemsetAsync
+#define cudaMemcpyHostToDevice hipMemcpyHostToDevice
+#define cudaMemcpyDeviceToHost hipMemcpyDeviceToHost
+#define cudaStreamCreate hipStreamCreate
+#define cudaStreamDestroy hipStreamDestroy
+#define cudaStreamSynchronize hipStreamSynchronize
+#define cudaGetDeviceCount hipGetDeviceCount
+#define cudaGetLastError hipGetLastError
+#else
+#include <cuda_runtime.h>
+#endif
+
+namespace psum {
+
+/* Threads of a block and elements each thread scans, a tile is their product */
+const int BLOCK_THREADS = 256;
+const int THREAD_ITEMS = 8;
+const int TILE_ITEMS = BLOCK_THREADS*THREAD_ITEMS;
+
+/* Elements of a pinned staging buffer */
+const size_t STAGE_ITEMS = (size_t)1 << 22;
+
+/* What a tile has published */
+enum TileStatus { TILE_EMPTY = 0, TILE_AGGREGATE = 1, TILE_PREFIX = 2 };
+
+/* Status of every tile, in device memory */
+template<class T>
+struct TileState {
+    int* status;            // TileStatus of each tile
+    T* aggregates;          // total of each tile
+    T* inclusives;          // total of each tile and everything before it
+    unsigned int* counter;  // next tile to be taken
+};
+
+/*
+Scan the tiles of an array in place, one tile per block
+param       data -- the array in device memory
+            n -- the number of elements
+            exclusive -- true for an exclusive scan
+            init -- the first value of an exclusive scan
+            state -- the tile status, all TILE_EMPTY and the counter 0
+*/
+template<class T>
+__global__ void singlePassScan(T* data, size_t n, bool exclusive, T init, TileState<T> state) {
+    __shared__ T items[TILE_ITEMS];
+    __shared__ T sums[BLOCK_THREADS];
+    __shared__ T tilePrefix;
+    __shared__ unsigned int tileShared;
+    int t = threadIdx.x;
+
+    // Tiles are taken in order, so every tile a block waits for has started
+    if(t == 0) { tileShared = atomicAdd(state.counter, 1u); }
+    __syncthreads();
+    unsigned int tile = tileShared;
+    size_t tileStart = (size_t)tile*TILE_ITEMS;
+
+    /* Load the tile coalesced, then scan each thread's consecutive items */
+    for(int i = 0 ; i < THREAD_ITEMS ; i++) {
+        size_t k = tileStart + i*BLOCK_THREADS + t;
+        items[i*BLOCK_THREADS + t] = (k < n) ? data[k] : T();
+    }
+    __syncthreads();
+
+    T values[THREAD_ITEMS];
+    T sum = T();
+    for(int i = 0 ; i < THREAD_ITEMS ; i++) {
+        sum = sum + items[t*THREAD_ITEMS + i];
+        values[i] = sum;
+    }
+    sums[t] = sum;
+    __syncthreads();
+
+    // Hillis and Steele over the thread totals, reading every value before any thread writes
+    for(int offset = 1 ; offset < BLOCK_THREADS ; offset <<= 1) {
+        T add = (t >= offset) ? sums[t - offset] : T();
+        __syncthreads();
+        sums[t] = sums[t] + add;
+        __syncthreads();
+    }
+
+    /* Publish the tile and look back for the total before it */
+    if(t == 0) {
+        T aggregate = sums[BLOCK_THREADS - 1];
+        volatile int* status = state.status;
+        T prefix = T();
+        if(tile == 0) {
+            state.inclusives[0] = aggregate;
+            __threadfence();
+            status[0] = TILE_PREFIX;
+        }
+        else {
+            state.aggregates[tile] = aggregate;
+            __threadfence();
+            status[tile] = TILE_AGGREGATE;
+
+            bool first = true;
+            for(long p = (long)tile - 1 ; p >= 0 ; p--) {
+                int s;
+                do { s = status[p]; } while(s == TILE_EMPTY);
+                __threadfence(); // The value was written before the status
+                T value = (s == TILE_PREFIX) ? ((volatile T*)state.inclusives)[p] : ((volatile T*)state.aggregates)[p];
+                prefix = first ? value : value + prefix;
+                first = false;
+                if(s == TILE_PREFIX) { break; }
+            }
+            state.inclusives[tile] = prefix + aggregate;
+            __threadfence();
+            status[tile] = TILE_PREFIX;
+        }
+        tilePrefix = prefix;
+    }
+    __syncthreads();
+
+    /* Write the results through shared memory, coalesced */
+    T before = tilePrefix + ((t > 0) ? sums[t - 1] : T());
+    for(int i = 0 ; i < THREAD_ITEMS ; i++) {
+        if(exclusive) { items[t*THREAD_ITEMS + i] = init + (before + (i > 0 ? values[i - 1] : T())); }
+        else { items[t*THREAD_ITEMS + i] = before + values[i]; }
+    }
+    __syncthreads();
+    for(int i = 0 ; i < THREAD_ITEMS ; i++) {
+        size_t k = tileStart + i*BLOCK_THREADS + t;
+        if(k < n) { data[k] = items[i*BLOCK_THREADS + t]; }
+    }
+}
+
+/* Device and pinned memory of one scan */
+template<class T>
+struct DeviceBuffers {
+    T* data;
+    TileState<T> state;
+    T* stage[2];
+    cudaStream_t streams[2];
+    int streamCount;
+};
+
+/*
+Release the buffers of a scan, entries that were never allocated are NULL
+param       buffers -- Pointer to the buffers
+*/
+template<class T>
+static void releaseBuffers(DeviceBuffers<T>* buffers) {
+    cudaFree(buffers->data);
+    cudaFree(buffers->state.status);
+    cudaFree(buffers->state.aggregates);
+    cudaFree(buffers->state.inclusives);
+    cudaFree(buffers->state.counter);
+    for(int b = 0 ; b < 2 ; b++) {
+        if(buffers->stage[b] != NULL) { cudaFreeHost(buffers->stage[b]); }
+    }
+    for(int s = 0 ; s < buffers->streamCount ; s++) { cudaStreamDestroy(buffers->streams[s]); }
+}
+
+/*
+Copy host memory to the device through the staging buffers, copying each part into a buffer while the part before is sent
+param       buffers -- Pointer to the buffers
+            in -- the host array
+            n -- the number of elements
+return      true if successful
+*/
+template<class T>
+static bool upload(DeviceBuffers<T>* buffers, const T* in, size_t n) {
+    for(size_t start = 0, part = 0 ; start < n ; start += STAGE_ITEMS, part++) {
+        int b = part % 2;
+        size_t count = n - start < STAGE_ITEMS ? n - start : STAGE_ITEMS;
+        if(cudaStreamSynchronize(buffers->streams[b]) != cudaSuccess) { return false; } // The buffer is sent
+        memcpy(buffers->stage[b], in + start, sizeof(T)*count);
+        if(cudaMemcpyAsync(buffers->data + start, buffers->stage[b], sizeof(T)*count, cudaMemcpyHostToDevice,
+                           buffers->streams[b]) != cudaSuccess) { return false; }
+    }
+    return cudaStreamSynchronize(buffers->streams[0]) == cudaSuccess && cudaStreamSynchronize(buffers->streams[1]) == cudaSuccess;
+}
+
+/*
+Copy the device array back to host memory, receiving each part while the part before is copied out of its buffer
+param       buffers -- Pointer to the buffers
+            out -- the host array
+            n -- the number of elements
+return      true if successful
+*/
+template<class T>
+static bool download(DeviceBuffers<T>* buffers, T* out, size_t n) {
+    size_t parts = (n + STAGE_ITEMS - 1) / STAGE_ITEMS;
+    for(size_t part = 0 ; part <= parts ; part++) {
+        if(part < parts) {
+            size_t start = part*STAGE_ITEMS;
+            size_t count = n - start < STAGE_ITEMS ? n - start : STAGE_ITEMS;
+            if(cudaMemcpyAsync(buffers->stage[part % 2], buffers->data + start, sizeof(T)*count, cudaMemcpyDeviceToHost,
+                               buffers->streams[part % 2]) != cudaSuccess) { return false; }
+        }
+        if(part > 0) {
+            size_t start = (part - 1)*STAGE_ITEMS;
+            size_t count = n - start < STAGE_ITEMS ? n - start : STAGE_ITEMS;
+            int b = (part - 1) % 2;
+            if(cudaStreamSynchronize(buffers->streams[b]) != cudaSuccess) { return false; }
+            memcpy(out + start, buffers->stage[b], sizeof(T)*count);
+        }
+    }
+    return true;
+}
+
+/*
+Prefix sum of a host array on the device
+param       in, out, n, exclusive, init -- as for deviceScan
+return      0 if successful, or -1 with errno ENOMEM or EIO
+*/
+template<class T>
+static int runDeviceScan(const T* in, T* out, size_t n, bool exclusive, T init) {
+    if(n == 0) { return 0; }
+    size_t tiles = (n + TILE_ITEMS - 1) / TILE_ITEMS;
+
+    DeviceBuffers<T> buffers;
+    memset(&buffers, 0, sizeof(buffers));
+    bool allocated = cudaMalloc((void**)&buffers.data, sizeof(T)*n) == cudaSuccess &&
+                     cudaMalloc((void**)&buffers.state.status, sizeof(int)*tiles) == cudaSuccess &&
+                     cudaMalloc((void**)&buffers.state.aggregates, sizeof(T)*tiles) == cudaSuccess &&
+                     cudaMalloc((void**)&buffers.state.inclusives, sizeof(T)*tiles) == cudaSuccess &&
+                     cudaMalloc((void**)&buffers.state.counter, sizeof(unsigned int)) == cudaSuccess;
+    for(int b = 0 ; b < 2 && allocated ; b++) {
+        allocated = cudaHostAlloc((void**)&buffers.stage[b], sizeof(T)*STAGE_ITEMS, cudaHostAllocDefault) == cudaSuccess;
+    }
+    for(int s = 0 ; s < 2 && allocated ; s++) {
+        allocated = cudaStreamCreate(&buffers.streams[s]) == cudaSuccess;
+        if(allocated) { buffers.streamCount++; }
+    }
+    if(!allocated) {
+        releaseBuffers(&buffers);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    bool done = upload(&buffers, in, n) &&
+                cudaMemsetAsync(buffers.state.status, 0, sizeof(int)*tiles, buffers.streams[0]) == cudaSuccess &&
+                cudaMemsetAsync(buffers.state.counter, 0, sizeof(unsigned int), buffers.streams[0]) == cudaSuccess;
+    if(done) {
+        singlePassScan<T><<<(unsigned int)tiles, BLOCK_THREADS, 0, buffers.streams[0]>>>(buffers.data, n, exclusive, init, buffers.state);
+        done = cudaGetLastError() == cudaSuccess && cudaStreamSynchronize(buffers.streams[0]) == cudaSuccess;
+    }
+    done = done && download(&buffers, out, n);
+
+    releaseBuffers(&buffers);
+    if(!done) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static std::once_flag deviceOnce;
+static bool devicePresent = false;
+
+bool deviceAvailable() {
+    std::call_once(deviceOnce, []() {
+        int count = 0;
+        devicePresent = (cudaGetDeviceCount(&count) == cudaSuccess && count > 0);
+    });
+    return devicePresent;
+}
+
+int deviceScan(const int32_t* in, int32_t* out, size_t n, bool exclusive, int32_t init) { return runDeviceScan(in, out, n, exclusive, init); }
+int deviceScan(const int64_t* in, int64_t* out, size_t n, bool exclusive, int64_t init) { return runDeviceScan(in, out, n, exclusive, init); }
+int deviceScan(const float* in, float* out, size_t n, bool exclusive, float init) { return runDeviceScan(in, out, n, exclusive, init); }
+int deviceScan(const double* in, double* out, size_t n, bool exclusive, double init) { return runDeviceScan(in, out, n, exclusive, init); }
+
+} // namespace psum
@@ -0,0 +1,45 @@
+/*
+
+GPU offload of large prefix sums. A device scan copies the input to the GPU through pinned host buffers, overlapping the copy
+of one part with the transfer of the next, scans it in a single pass with decoupled look-back, and copies the result back
+the same way.
+
+The device code is in device-scan.cu and is only built with "make DEVICE=cuda" or "make DEVICE=hip". Otherwise
+device-scan.cpp is linked instead, no device is available, and scan always runs on the CPU.
+
+*/
+
+#ifndef DEVICE_SCAN_H
+#define DEVICE_SCAN_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace psum {
+
+/* Arrays of at least this many elements are scanned on a device when the policy does not say otherwise */
+const size_t DEFAULT_DEVICE_THRESHOLD = (size_t)1 << 26;
+
+/*
+Determine if a device can run scans, checked once
+return      true if the library was built with a device backend and a device is present
+*/
+bool deviceAvailable();
+
+/*
+Prefix sum on the device. in and out are host memory and may be the same array.
+param       in -- the input elements
+            out -- the output elements
+            n -- the number of elements
+            exclusive -- true for an exclusive scan
+            init -- the first value of an exclusive scan
+return      0 if successful, or -1 if there is no device or device memory or a transfer failed
+*/
+int deviceScan(const int32_t* in, int32_t* out, size_t n, bool exclusive, int32_t init);
+int deviceScan(const int64_t* in, int64_t* out, size_t n, bool exclusive, int64_t init);
+int deviceScan(const float* in, float* out, size_t n, bool exclusive, float init);
+int deviceScan(const double* in, double* out, size_t n, bool exclusive, double init);
+
+} // namespace psum
+
+#endif
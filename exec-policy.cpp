@@ -0,0 +1,184 @@
+/*
+
+Implementation of the worker backends declared in exec-policy.h
+
+*/
+
+#include "exec-policy.h"
+
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace psum {
+
+static mutex sharedPoolLock; // Held while a scan runs on the shared pool
+static ThreadPool* sharedPool = NULL;
+
+/*
+Run the workers on a thread pool
+param       pool -- the pool to use, NULL for the shared pool
+            workers -- the number of workers
+            task -- the task of each worker
+return      0 if successful, or -1 with errno EINVAL if the pool has fewer threads than workers
+*/
+static int runThreads(ThreadPool* pool, int workers, const function<void(int)>& task) {
+    // Extra pool threads have nothing to do for this scan
+    function<void(int)> some = [&task, workers](int j) { if(j < workers) { task(j); } };
+    if(pool != NULL) {
+        // Its workers would wait at the barrier for threads it does not have
+        if(pool->size() < workers) {
+            errno = EINVAL;
+            return -1;
+        }
+        pool->run(some);
+        return 0;
+    }
+
+    // The shared pool is kept between scans and only grows, so callers alternating worker counts do not recreate it
+    lock_guard<mutex> guard(sharedPoolLock);
+    if(sharedPool == NULL || sharedPool->size() < workers) {
+        delete sharedPool;
+        sharedPool = new ThreadPool(workers);
+    }
+    sharedPool->run(some);
+    return 0;
+}
+
+/*
+Open a descriptor that becomes readable when a child exits
+param       pid -- the process ID of the child
+return      the descriptor, or -1 if the kernel has no pidfd_open
+*/
+static int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+Wait for forked workers. Once one of them dies or exits with an error the others are killed, since they would wait for it
+at the barrier forever. The exits are waited for with pidfds where the kernel has them, and polled for otherwise.
+param       children -- the process IDs of the workers
+return      0 if every worker exited normally, or -1 with errno ECHILD if one did not
+*/
+static int waitChildren(const vector<pid_t>& children) {
+    vector<int> pidfds(children.size(), -1);
+    bool polling = true;
+    for(size_t i = 0 ; i < children.size() && polling ; i++) {
+        pidfds[i] = openPidfd(children[i]);
+        polling = (pidfds[i] >= 0);
+    }
+
+    vector<char> done(children.size(), 0);
+    size_t remaining = children.size();
+    bool failed = false;
+    vector<struct pollfd> waiting;
+    while(remaining > 0) {
+        for(size_t i = 0 ; i < children.size() ; i++) {
+            if(done[i]) { continue; }
+            int status = 0;
+            pid_t result;
+            while((result = waitpid(children[i], &status, WNOHANG)) < 0 && errno == EINTR);
+            if(result == 0) { continue; }
+
+            // A child reaped elsewhere, as when SIGCHLD is ignored, has no status to check
+            done[i] = 1;
+            remaining--;
+            if(result > 0 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0) && !failed) {
+                failed = true;
+                for(size_t k = 0 ; k < children.size() ; k++) {
+                    if(!done[k]) { kill(children[k], SIGKILL); }
+                }
+            }
+        }
+        if(remaining == 0) { break; }
+
+        if(polling) {
+            waiting.clear();
+            for(size_t i = 0 ; i < children.size() ; i++) {
+                if(!done[i]) { waiting.push_back({ pidfds[i], POLLIN, 0 }); }
+            }
+            poll(waiting.data(), waiting.size(), -1); // Interrupted by a signal, it is simply checked again
+        }
+        else { usleep(100); }
+    }
+
+    for(size_t i = 0 ; i < pidfds.size() ; i++) {
+        if(pidfds[i] >= 0) { close(pidfds[i]); }
+    }
+    if(failed) {
+        errno = ECHILD;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Run the workers as forked child processes
+param       workers -- the number of workers
+            task -- the task of each worker
+return      0 if successful, or -1 if a child could not be created, or with errno ECHILD if one died or failed
+*/
+static int runProcesses(int workers, const function<void(int)>& task) {
+    vector<pid_t> children;
+
+    /* Create the processes */
+    for(int j = 0 ; j < workers ; j++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            // Child process begins here
+            // j is the process number
+            task(j);
+            // Child process ends, without running the parent's exit handlers
+            _exit(0);
+        }
+        if(pid < 0) {
+            // The children already started would wait at the barrier forever
+            int error = errno;
+            for(size_t i = 0 ; i < children.size() ; i++) { kill(children[i], SIGKILL); }
+            for(size_t i = 0 ; i < children.size() ; i++) { waitpid(children[i], NULL, 0); }
+            errno = error;
+            return -1;
+        }
+        children.push_back(pid);
+    }
+
+    // Wait for our own children only, the caller may have others
+    return waitChildren(children);
+}
+
+int runWorkers(const ExecPolicy& policy, int workers, const function<void(int)>& task) {
+    // Pool threads and the calling thread get their CPUs back afterwards
+    Affinity affinity = policy.affinity;
+    function<void(int)> pinned = [&task, affinity](int j) {
+        cpu_set_t previous;
+        bool moved = (pinThread(workerCpu(affinity, j), &previous) == 0);
+        task(j);
+        if(moved) { unpinThread(&previous); }
+    };
+    const function<void(int)>& run = (affinity == AFFINITY_NONE) ? task : pinned;
+    if(affinity != AFFINITY_NONE) { numaNodes(); } // Read the topology once here rather than in every child
+
+    if(policy.backend == PROCESS_BACKEND) {
+        return runProcesses(workers, run);
+    }
+    if(workers == 1) {
+        // Worker 0 is the calling thread anyway. This also lets a task of a pool thread run one-worker scans of its own.
+        run(0);
+        return 0;
+    }
+    return runThreads(policy.pool, workers, run);
+}
+
+} // namespace psum
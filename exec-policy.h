@@ -0,0 +1,67 @@
+/*
+
+How a scan is executed: which engine computes it, where its workers run and how they synchronize.
+
+*/
+
+#ifndef EXEC_POLICY_H
+#define EXEC_POLICY_H
+
+#include <functional>
+#include <thread>
+
+#include "barrier.h"
+#include "device-scan.h"
+#include "thread-pool.h"
+#include "topology.h"
+
+namespace psum {
+
+struct Trace;
+
+/* Scan engines */
+enum Engine { HILLIS_STEELE, WORK_EFFICIENT, TILED_HILLIS_STEELE };
+
+/* Where the workers run: forked processes or threads of this process */
+enum Backend { PROCESS_BACKEND, THREAD_BACKEND };
+
+/* How the array is split between the workers: one equal chunk each, or smaller chunks claimed as the workers finish them */
+enum Partition { STATIC_PARTITION, DYNAMIC_PARTITION };
+
+/* Settings of a scan. The defaults suit embedding: the work-efficient engine on a thread pool using every core. */
+struct ExecPolicy {
+    Engine engine;
+    Backend backend;
+    BarrierType barrier;
+    int workers;        // number of workers, capped at the number of elements
+    ThreadPool* pool;   // pool for the thread backend, or NULL to use a pool shared by all callers
+    Affinity affinity;  // CPU of each worker, pinned workers keep their blocks in local memory
+    size_t tileSize;    // elements per tile of the tiled engine, a power of two, or 0 to fit a tile in a 256 KiB cache
+    Partition partition;
+    size_t deviceThreshold; // arrays of at least this many elements are scanned on a device if there is one, 0 never
+    Trace* trace;       // spans of the scan are recorded here, or NULL to run without instrumentation (trace.h)
+
+    ExecPolicy() : engine(WORK_EFFICIENT), backend(THREAD_BACKEND), barrier(SENSE_BARRIER),
+        workers((int)std::thread::hardware_concurrency()), pool(NULL), affinity(AFFINITY_NONE), tileSize(0),
+        partition(STATIC_PARTITION), deviceThreshold(DEFAULT_DEVICE_THRESHOLD), trace(NULL) {
+        if(workers < 1) { workers = 1; }
+    }
+};
+
+/*
+Run a task once on each worker of the policy's backend and wait for all of them to finish. With the process backend the
+workers are forked children, so everything the task writes must be in memory from allocateShared. With an affinity, worker
+j is pinned to workerCpu(affinity, j) while it runs the task. One worker of the thread backend is the calling thread, so
+a task may itself run scans with one worker.
+param       policy -- the backend and thread pool to use
+            workers -- the number of workers
+            task -- called once with each worker number, 0 to workers-1
+return      0 if successful, or -1 if the workers could not be started, with errno EINVAL if the policy's pool has fewer
+            threads than workers, or with errno ECHILD if a forked worker died or exited with an error, after the others
+            were killed
+*/
+int runWorkers(const ExecPolicy& policy, int workers, const std::function<void(int)>& task);
+
+} // namespace psum
+
+#endif
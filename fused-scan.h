@@ -0,0 +1,106 @@
+/*
+
+Fused scans: several inclusive scans of the same input, each with its own operator, in one pass over memory. Scanning the
+input once per operator reads it from memory once per operator; here the input is read in tiles small enough to stay in
+cache, and every operator scans a tile before the next tile is read.
+
+The scan is a reduce-then-scan over one chunk per worker. The first pass reduces every chunk with every operator, the
+chunk totals are scanned, and the second pass scans every chunk again starting from its offsets and writes the outputs.
+The input is read twice in all, and each output written once, whatever the number of operators.
+
+*/
+
+#ifndef FUSED_SCAN_H
+#define FUSED_SCAN_H
+
+#include <cstddef>
+#include <errno.h>
+#include <vector>
+
+#include "exec-policy.h"
+#include "scan-engine.h"
+#include "scan-ops.h"
+
+namespace psum {
+
+/* Elements of a tile, which every operator scans while it is in cache */
+const size_t FUSED_TILE = 4096;
+
+/*
+Inclusive scans of one array with several operators: outs[i][k] = in[0] ops[i] in[1] ops[i] ... ops[i] in[k]
+param       in -- the input array
+            outs -- count output arrays of n elements, which must not overlap in
+            ops -- count associative operators. BuiltinOp mixes the built-in operators.
+            count -- the number of operators
+            n -- the number of elements
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if count is not positive or the workers could not be started
+*/
+template<class T, class Op>
+int fusedScan(const T* in, T* const* outs, const Op* ops, int count, size_t n, const ExecPolicy& policy = ExecPolicy()) {
+    if(count < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    if(n == 0) { return 0; }
+
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+
+    /* Reduce every chunk but the last with every operator */
+    std::vector<T> totals((size_t)workers*count); // operator i of chunk j at j*count + i
+    int result = runWorkers(threads, workers, [&](int j) {
+        if(j == workers - 1) { return; } // Nothing follows the last chunk
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        T* sums = &totals[(size_t)j*count];
+        for(int i = 0 ; i < count ; i++) { sums[i] = in[chunkStart]; }
+
+        for(size_t tileStart = chunkStart + 1 ; tileStart < chunkEnd ; tileStart += FUSED_TILE) {
+            size_t tileEnd = tileStart + FUSED_TILE < chunkEnd ? tileStart + FUSED_TILE : chunkEnd;
+            for(int i = 0 ; i < count ; i++) {
+                T sum = sums[i];
+                for(size_t k = tileStart ; k < tileEnd ; k++) { sum = ops[i](sum, in[k]); }
+                sums[i] = sum;
+            }
+        }
+    });
+    if(result < 0) { return -1; }
+
+    // Scan the chunk totals, totals of chunk j become the offsets of chunk j + 1
+    for(int j = 1 ; j < workers - 1 ; j++) {
+        for(int i = 0 ; i < count ; i++) {
+            totals[(size_t)j*count + i] = ops[i](totals[(size_t)(j - 1)*count + i], totals[(size_t)j*count + i]);
+        }
+    }
+
+    /* Scan every chunk from its offsets */
+    return runWorkers(threads, workers, [&](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        std::vector<T> sums(count);
+        for(int i = 0 ; i < count ; i++) {
+            sums[i] = (j == 0) ? in[chunkStart] : ops[i](totals[(size_t)(j - 1)*count + i], in[chunkStart]);
+            outs[i][chunkStart] = sums[i];
+        }
+
+        for(size_t tileStart = chunkStart + 1 ; tileStart < chunkEnd ; tileStart += FUSED_TILE) {
+            size_t tileEnd = tileStart + FUSED_TILE < chunkEnd ? tileStart + FUSED_TILE : chunkEnd;
+            for(int i = 0 ; i < count ; i++) {
+                T sum = sums[i];
+                T* out = outs[i];
+                for(size_t k = tileStart ; k < tileEnd ; k++) {
+                    sum = ops[i](sum, in[k]);
+                    out[k] = sum;
+                }
+                sums[i] = sum;
+            }
+        }
+    });
+}
+
+} // namespace psum
+
+#endif
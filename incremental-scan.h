@@ -0,0 +1,215 @@
+/*
+
+Incremental prefix sums, for inputs that change a little at a time instead of being scanned again from scratch.
+
+An input that grows by appending only needs the new values scanned: appendScan scans them on top of the total carried over
+from the scan of what came before, so the result continues the earlier output.
+
+An input whose elements change in place is kept in a Fenwick tree (a binary indexed tree). Node i holds the sum of the
+elements (i - lowbit(i), i], so changing one element updates log N nodes and the sum of any prefix adds up log N nodes,
+instead of the O(N) of a new scan. The tree is built from the values or from their prefix sums in parallel, and written
+back out as prefix sums in one pass. It needs an operator with an inverse, so it holds sums only.
+
+*/
+
+#ifndef INCREMENTAL_SCAN_H
+#define INCREMENTAL_SCAN_H
+
+#include <cstddef>
+#include <errno.h>
+
+#include "exec-policy.h"
+#include "scan-engine.h"
+#include "shared-memory.h"
+
+namespace psum {
+
+/*
+Inclusive scan of values appended to an input that was scanned before: out[i] = carry op in[0] op ... op in[i]
+param       in -- the appended values
+            out -- the output array, may be the same as in
+            n -- the number of appended values
+            carry -- the last value of the earlier scan, its running total
+            op -- the associative operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 on failure
+*/
+template<class T, class Op>
+int appendScan(const T* in, T* out, size_t n, T carry, Op op, const ExecPolicy& policy) {
+    if(scan(in, out, n, false, T(), op, policy) < 0) { return -1; }
+    if(n == 0) { return 0; }
+
+    /* Fold the carried total into the scan on threads */
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    return runWorkers(threads, workers, [=](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        for(size_t k = chunkStart ; k < chunkEnd ; k++) { out[k] = op(carry, out[k]); }
+    });
+}
+
+/* A Fenwick tree of sums over n elements. Nodes are numbered from 1, node 0 is unused. */
+template<class T>
+struct FenwickTree {
+    T* nodes;
+    size_t n;
+};
+
+/*
+Get the lowest set bit of a node number, the number of elements the node sums
+param       i -- the node number, greater than 0
+return      the lowest set bit of i
+*/
+inline size_t lowBit(size_t i) {
+    return i & (~i + 1);
+}
+
+/*
+Build a Fenwick tree from the prefix sums of its elements, each node is the difference of two sums
+param       tree -- Pointer to the tree to be initialized
+            sums -- the inclusive prefix sums of the n elements
+            n -- the number of elements
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if the nodes cannot be allocated or the workers could not be started
+*/
+template<class T>
+int buildFenwickFromSums(FenwickTree<T>* tree, const T* sums, size_t n, const ExecPolicy& policy) {
+    tree->n = n;
+    tree->nodes = (T*)allocateMemory(false, sizeof(T)*(n + 1));
+    if(tree->nodes == NULL) { return -1; }
+    tree->nodes[0] = T();
+    if(n == 0) { return 0; }
+
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    T* nodes = tree->nodes;
+    int result = runWorkers(threads, workers, [=](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        for(size_t i = chunkStart + 1 ; i <= chunkEnd ; i++) {
+            size_t below = i - lowBit(i); // Node i sums the elements after this prefix
+            nodes[i] = below > 0 ? sums[i - 1] - sums[below - 1] : sums[i - 1];
+        }
+    });
+    if(result < 0) {
+        releaseMemory(false, tree->nodes);
+        tree->nodes = NULL;
+    }
+    return result;
+}
+
+/*
+Build a Fenwick tree from its elements, through a scan of them
+param       tree -- Pointer to the tree to be initialized
+            values -- the n elements
+            n -- the number of elements
+            policy -- how the scan is executed, the tree is built on threads
+return      0 if successful, or -1 on failure
+*/
+template<class T>
+int buildFenwick(FenwickTree<T>* tree, const T* values, size_t n, const ExecPolicy& policy) {
+    bool shared = (policy.backend == PROCESS_BACKEND);
+    T* sums = (T*)allocateMemory(shared, sizeof(T)*(n > 0 ? n : 1));
+    if(sums == NULL) { return -1; }
+    int result = scan(values, sums, n, false, T(), Plus(), policy);
+    if(result == 0) { result = buildFenwickFromSums(tree, sums, n, policy); }
+    int error = errno;
+    releaseMemory(shared, sums);
+    errno = error;
+    return result;
+}
+
+/*
+Release the nodes of a tree
+param       tree -- Pointer to the tree
+*/
+template<class T>
+void releaseFenwick(FenwickTree<T>* tree) {
+    releaseMemory(false, tree->nodes);
+    tree->nodes = NULL;
+    tree->n = 0;
+}
+
+/*
+Sum a prefix of the elements, O(log N)
+param       tree -- the tree
+            count -- the number of elements summed, from the first, at most n
+return      the sum of elements 0 to count-1
+*/
+template<class T>
+T fenwickPrefix(const FenwickTree<T>& tree, size_t count) {
+    T sum = T();
+    for(size_t i = count ; i > 0 ; i -= lowBit(i)) { sum = sum + tree.nodes[i]; }
+    return sum;
+}
+
+/*
+Get one element, O(log N)
+param       tree -- the tree
+            index -- the index of the element
+return      the element
+*/
+template<class T>
+T fenwickValue(const FenwickTree<T>& tree, size_t index) {
+    return fenwickPrefix(tree, index + 1) - fenwickPrefix(tree, index);
+}
+
+/*
+Add to one element, O(log N)
+param       tree -- Pointer to the tree
+            index -- the index of the element
+            delta -- the amount added
+*/
+template<class T>
+void fenwickAdd(FenwickTree<T>* tree, size_t index, T delta) {
+    for(size_t i = index + 1 ; i <= tree->n ; i += lowBit(i)) { tree->nodes[i] = tree->nodes[i] + delta; }
+}
+
+/*
+Set one element, O(log N)
+param       tree -- Pointer to the tree
+            index -- the index of the element
+            value -- the new value
+*/
+template<class T>
+void fenwickSet(FenwickTree<T>* tree, size_t index, T value) {
+    fenwickAdd(tree, index, value - fenwickValue(*tree, index));
+}
+
+/*
+Write the inclusive prefix sums of the elements. Within a chunk, the sum up to node i is the sum up to i - lowbit(i) plus
+node i, so each worker only adds up whole prefixes for the few nodes whose range starts before its chunk.
+param       tree -- the tree
+            sums -- Pointer to the n sums to be written
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if the workers could not be started
+*/
+template<class T>
+int fenwickSums(const FenwickTree<T>& tree, T* sums, const ExecPolicy& policy) {
+    size_t n = tree.n;
+    if(n == 0) { return 0; }
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    const T* nodes = tree.nodes;
+    return runWorkers(threads, workers, [=, &tree](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        for(size_t i = chunkStart + 1 ; i <= chunkEnd ; i++) {
+            size_t below = i - lowBit(i);
+            if(below == 0) { sums[i - 1] = nodes[i]; }
+            else if(below > chunkStart) { sums[i - 1] = sums[below - 1] + nodes[i]; }
+            else { sums[i - 1] = fenwickPrefix(tree, i); }
+        }
+    });
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,186 @@
+/*
+
+Distributed version of my-count: the prefix sum of a binary array file across the ranks of an MPI job.
+
+    mpirun -n <ranks> ./mpi-count N M A B [options]
+
+Each rank reads its slice of A, scans it with M workers of its own, and writes its slice of B once the totals of the slices
+before it are added in (mpi-scan.h). A and B are binary array files (binary-io.h) on a file system every rank can reach.
+
+*/
+
+#include <stdio.h>
+#include <cstdlib>
+#include <climits>
+#include <limits>
+#include <stdint.h>
+#include <string>
+#include <errno.h>
+
+#include "prefix-sum.h"
+#include "mpi-scan.h"
+
+using namespace std;
+using namespace psum;
+
+/* Element types selectable from the command line */
+enum ElementType { INT32_TYPE, INT64_TYPE, UINT64_TYPE, FLOAT_TYPE, DOUBLE_TYPE };
+
+/* Optional settings given after the required arguments */
+struct Options {
+    ExecPolicy policy;
+    ElementType type;
+    OpKind op;
+};
+
+/*
+Handle errors and bad input, stopping every rank
+param      String to be printed to user
+*/
+void errmsg(string msg) {
+    perror(msg.c_str());
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    exit(1);
+}
+
+/*
+Determines if input values for N and M are valid, and if enough arguments were provided.
+param       argCount -- number of total arguments from main
+            args -- arguments array from main
+return      -1 if invalid, 0 if valid
+*/
+int verifyArgs(int argCount, char* args[]) {
+    if(argCount < 5) { return -1; }
+
+    string N = args[1];
+    string M = args[2];
+    if(N.empty() || M.empty() || N.find_first_not_of("0123456789") != string::npos ||
+       M.find_first_not_of("0123456789") != string::npos) {
+        return -1;
+    }
+
+    errno = 0;
+    unsigned long long valN = strtoull(args[1], NULL, 10);
+    unsigned long long valM = strtoull(args[2], NULL, 10);
+    if(errno != 0 || valN == 0 || valM == 0 || valM > INT_MAX) { return -1; }
+    return 0;
+}
+
+/*
+Parse the optional arguments that follow N, M and the two file paths.
+param       argCount -- number of total arguments from main
+            args -- arguments array from main
+            opts -- Pointer to the options to be filled in
+return      -1 if an option is not recognized, 0 if valid
+*/
+int parseOptions(int argCount, char* args[], Options* opts) {
+    // The library defaults, forking inside a rank is unsafe with some MPI transports
+    opts->type = INT32_TYPE;
+    opts->op = SUM_OP;
+
+    for(int i = 5; i < argCount; i++) {
+        string arg = args[i];
+        if(arg == "--engine=hillis-steele") { opts->policy.engine = HILLIS_STEELE; }
+        else if(arg == "--engine=work-efficient") { opts->policy.engine = WORK_EFFICIENT; }
+        else if(arg == "--engine=tiled-hillis-steele") { opts->policy.engine = TILED_HILLIS_STEELE; }
+        else if(arg == "--backend=process") { opts->policy.backend = PROCESS_BACKEND; }
+        else if(arg == "--backend=thread") { opts->policy.backend = THREAD_BACKEND; }
+        else if(arg == "--partition=static") { opts->policy.partition = STATIC_PARTITION; }
+        else if(arg == "--partition=dynamic") { opts->policy.partition = DYNAMIC_PARTITION; }
+        else if(arg == "--type=int32") { opts->type = INT32_TYPE; }
+        else if(arg == "--type=int64") { opts->type = INT64_TYPE; }
+        else if(arg == "--type=uint64") { opts->type = UINT64_TYPE; }
+        else if(arg == "--type=float") { opts->type = FLOAT_TYPE; }
+        else if(arg == "--type=double") { opts->type = DOUBLE_TYPE; }
+        else if(arg == "--op=sum") { opts->op = SUM_OP; }
+        else if(arg == "--op=max") { opts->op = MAX_OP; }
+        else if(arg == "--op=min") { opts->op = MIN_OP; }
+        else if(arg == "--op=xor") { opts->op = XOR_OP; }
+        else if(arg == "--op=product") { opts->op = PRODUCT_OP; }
+        else { return -1; }
+    }
+
+    // Xor is for integers
+    if(opts->op == XOR_OP && (opts->type == FLOAT_TYPE || opts->type == DOUBLE_TYPE)) { return -1; }
+    return 0;
+}
+
+/*
+Read this rank's slice, scan it across the ranks and write it
+param       arrSize -- the number of elements of the whole array
+            infileName -- path of the input file
+            outfileName -- path of the output file
+            opts -- the options
+            op -- the operator
+*/
+template<class T, class Op>
+void runSlice(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op) {
+    BinaryType type = BinaryTypeOf<T>::value;
+    size_t first, count;
+    getSlice(MPI_COMM_WORLD, arrSize, &first, &count);
+
+    // The scan runs in place, the output is staged for forked workers by the engine
+    T* slice = (T*)allocateMemory(false, sizeof(T)*(count > 0 ? count : 1));
+    if(slice == NULL) {
+        errmsg("Error creating shared memory segment.");
+    }
+    if(readBinaryRange(infileName, type, sizeof(T), slice, first, count) != (long long)count) {
+        errmsg("Invalid input file.");
+    }
+
+    if(distributedScan((const T*)slice, slice, count, op, opts.policy, MPI_COMM_WORLD) < 0) {
+        errmsg("Unable to run the scan.");
+    }
+
+    if(writeBinaryRange(outfileName, type, sizeof(T), slice, first, count, arrSize) < 0) {
+        errmsg("Unable to open the output file.");
+    }
+    releaseMemory(false, slice);
+}
+
+/*
+Select the operator, each combination is compiled separately
+param       arrSize, infileName, outfileName, opts -- as for runSlice
+*/
+template<class T>
+void runType(size_t arrSize, string infileName, string outfileName, const Options& opts) {
+    switch(opts.op) {
+        case MAX_OP: runSlice<T>(arrSize, infileName, outfileName, opts, Max()); break;
+        case MIN_OP: runSlice<T>(arrSize, infileName, outfileName, opts, Min()); break;
+        case PRODUCT_OP: runSlice<T>(arrSize, infileName, outfileName, opts, Multiplies()); break;
+        case XOR_OP:
+            // Rejected for floating point types by parseOptions
+            if constexpr(std::numeric_limits<T>::is_integer) { runSlice<T>(arrSize, infileName, outfileName, opts, BitXor()); }
+            break;
+        default: runSlice<T>(arrSize, infileName, outfileName, opts, Plus()); break;
+    }
+}
+
+/* Start of main */
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+
+    if(verifyArgs(argc, argv) < 0) {
+        errmsg("Invalid arguments provided.");
+    }
+    size_t arrSize = strtoull(argv[1], NULL, 10);
+    string infileName = argv[3];
+    string outfileName = argv[4];
+
+    Options opts;
+    if(parseOptions(argc, argv, &opts) < 0) {
+        errmsg("Invalid option provided.");
+    }
+    opts.policy.workers = atoi(argv[2]);
+
+    switch(opts.type) {
+        case INT32_TYPE: runType<int32_t>(arrSize, infileName, outfileName, opts); break;
+        case INT64_TYPE: runType<int64_t>(arrSize, infileName, outfileName, opts); break;
+        case UINT64_TYPE: runType<uint64_t>(arrSize, infileName, outfileName, opts); break;
+        case FLOAT_TYPE: runType<float>(arrSize, infileName, outfileName, opts); break;
+        case DOUBLE_TYPE: runType<double>(arrSize, infileName, outfileName, opts); break;
+    }
+
+    MPI_Finalize();
+    return 0;
+}
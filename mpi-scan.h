@@ -0,0 +1,130 @@
+/*
+
+Distributed scan over MPI. The array is split into one slice per rank like the shared-memory engines split it into one
+block per worker: each rank scans its slice locally with the shared-memory engine, the slice totals are combined with an
+exclusive-scan collective, and each rank folds the total of the slices before it into its own.
+
+This header needs mpi.h and is not included by prefix-sum.h. Build with mpicxx and link with libprefixsum.a and -pthread.
+
+*/
+
+#ifndef MPI_SCAN_H
+#define MPI_SCAN_H
+
+#include <cstddef>
+#include <errno.h>
+#include <mpi.h>
+
+#include "exec-policy.h"
+#include "scan-engine.h"
+
+namespace psum {
+
+/* Total of a slice, none for an empty slice */
+template<class T>
+struct SliceTotal {
+    T total;
+    int present;
+};
+
+/*
+Combine slice totals for MPI_Exscan. The operator is not an argument of the callback, so it is set for each collective.
+Lower ranks come first in invec.
+*/
+template<class T, class Op>
+struct SliceCombine {
+    static const Op* op;
+
+    static void combine(void* invec, void* inoutvec, int* len, MPI_Datatype*) {
+        SliceTotal<T>* lower = (SliceTotal<T>*)invec;
+        SliceTotal<T>* upper = (SliceTotal<T>*)inoutvec;
+        for(int i = 0 ; i < *len ; i++) {
+            if(!lower[i].present) { continue; }
+            if(upper[i].present) { upper[i].total = (*op)(lower[i].total, upper[i].total); }
+            else { upper[i] = lower[i]; }
+        }
+    }
+};
+
+template<class T, class Op>
+const Op* SliceCombine<T, Op>::op = NULL;
+
+/*
+Determine the slice of a rank, split like the chunks of a static partition
+param       comm -- the communicator
+            n -- the number of elements of the whole array
+            first -- Pointer receiving the index of the first element of the slice
+            count -- Pointer receiving the number of elements of the slice
+*/
+inline void getSlice(MPI_Comm comm, size_t n, size_t* first, size_t* count) {
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+    size_t end;
+    getChunkRange(rank, ranks, n, first, &end);
+    *count = end - *first;
+}
+
+/*
+Inclusive scan of an array split into a slice per rank, called by every rank of the communicator with its own slice
+param       in -- the slice of the input array
+            out -- the slice of the output array, may be the same as in
+            n -- the number of elements of the slice, may be 0
+            op -- the associative operator
+            policy -- how the local scan is executed on this rank
+            comm -- the communicator, ranks in array order
+return      0 if successful, or -1 if the local scan or the collective failed. Every rank takes part in the collective, so
+            a failed local scan does not leave the others waiting.
+*/
+template<class T, class Op>
+int distributedScan(const T* in, T* out, size_t n, Op op, const ExecPolicy& policy, MPI_Comm comm) {
+    int result = scan(in, out, n, false, T(), op, policy);
+    int error = errno;
+
+    /* Total of everything before this slice */
+    SliceTotal<T> local;
+    local.total = n > 0 ? out[n - 1] : T();
+    local.present = (result == 0 && n > 0);
+
+    // One total is one element of the collective, the callback gets whole totals
+    MPI_Datatype totalType;
+    MPI_Type_contiguous((int)sizeof(local), MPI_BYTE, &totalType);
+    MPI_Type_commit(&totalType);
+    MPI_Op combine;
+    MPI_Op_create(&SliceCombine<T, Op>::combine, 0, &combine); // Not commutative, ranks keep array order
+    SliceCombine<T, Op>::op = &op;
+    SliceTotal<T> before;
+    before.present = 0;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int status = MPI_Exscan(&local, &before, 1, totalType, combine, comm);
+    MPI_Op_free(&combine);
+    MPI_Type_free(&totalType);
+    SliceCombine<T, Op>::op = NULL;
+
+    // Failures of any rank make every rank fail
+    int failed = (result < 0 || status != MPI_SUCCESS);
+    int anyFailed = failed;
+    MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_LOR, comm);
+    if(anyFailed) {
+        errno = result < 0 ? error : EIO;
+        return -1;
+    }
+    if(rank == 0 || !before.present || n == 0) { return 0; } // The first rank gets no result from MPI_Exscan
+
+    /* Fold the offset into the slice on threads */
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    T offset = before.total;
+    return runWorkers(threads, workers, [=](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        for(size_t k = chunkStart ; k < chunkEnd ; k++) { out[k] = op(offset, out[k]); }
+    });
+}
+
+} // namespace psum
+
+#endif
@@ -3,27 +3,94 @@
 Authors: Meghan Grayson and Vaishnavi Karaguppi
 Date: February 11, 2024
 
-This program computes a prefix sum with Hillis and Steele's parallel algorithm.
-The specified number of processes are created by the parent process. Each process performs the algorithm on a subset of the
-input array's elements. Two arrays of size N are used for all intermediate prefix sum array. A barrier is implemented with a
-simple counter, so the barrier is implemented with space complexity of O(1).
+This program computes a prefix sum of the integers in a file and writes the result to another file. The scan itself is done
+by the prefix-sum library (prefix-sum.h), this program only handles the arguments and the text files.
+
+By default the scan uses Hillis and Steele's parallel algorithm. The specified number of processes are created by the parent
+process, and each process performs the algorithm on a subset of the input array's elements. The work-efficient engine, the
+thread backend and the other barriers can be selected with the options.
 
 */
 
-#include <sys/wait.h>
 #include <stdio.h>
-#include <unistd.h>
 #include <iostream>
 #include <fstream>
-#include <sys/ipc.h>
-#include <sys/shm.h>
 #include <cstdlib>
 #include <cstdio>
-#include <cmath>
-#include <sys/stat.h>
+#include <climits>
+#include <limits>
+#include <stdint.h>
 #include <errno.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+#include <memory>
+
+#include "prefix-sum.h"
 
 using namespace std;
+using namespace psum;
+
+/* Element types selectable from the command line */
+enum ElementType { INT32_TYPE, INT64_TYPE, UINT64_TYPE, FLOAT_TYPE, DOUBLE_TYPE };
+
+/* What happens when a sum does not fit the element type */
+enum OverflowMode { WRAP_OVERFLOW, CHECKED_OVERFLOW, SATURATE_OVERFLOW };
+
+/* File formats of A and B */
+enum FileFormat { TEXT_FORMAT, BINARY_FORMAT, INDEX_FORMAT, PACKED_INDEX_FORMAT, COMPRESSED_INDEX_FORMAT };
+
+/* Many arrays in one run: none, pairs of files listed in A, or binary arrays one after another in A */
+enum BatchMode { NO_BATCH, MANIFEST_BATCH, ARRAYS_BATCH };
+
+/* Optional settings given after the required arguments */
+struct Options {
+    ExecPolicy policy;
+    ElementType type;
+    OverflowMode overflow;
+    FileFormat inFormat;
+    FileFormat outFormat;
+    size_t indexBlock;  // values per block of a packed index
+    bool mapFiles;      // map binary files instead of reading and writing them
+    size_t streamChunk; // elements per chunk of a streaming scan, 0 to hold the whole input in memory
+    bool asyncIo;       // stream binary files with asynchronous reads and writes where they allow it
+    IoMode ioMode;      // how the asynchronous reads and writes are done
+    unsigned ioDepth;   // chunk buffers of an asynchronous stream
+    bool pipeline;      // parse, scan and format text in one pass instead of through whole arrays
+    BatchMode batch;    // scan many arrays on one pool of workers
+    bool inPlace;       // read the input into the output array and scan it there
+    string segmentFile; // head flags or segment offsets of a segmented scan, empty for one scan of the whole input
+    bool segmentOffsets; // segmentFile holds the first index of each segment instead of one flag per element
+    vector<OpKind> ops; // operators of the scan, several are fused into one pass with an output file each
+    string server;      // socket of a scan server that runs the scan, empty to run it here
+    bool stats;         // print a summary of the trace of the run to stderr
+    string traceFile;   // Chrome trace of the run, empty for none
+    bool counters;      // add hardware counters to the trace
+    string carry;       // running total the scan continues from, empty for none
+    string appendFile;  // previous output, whose input A extends, empty to scan all of A
+    string updateFile;  // element changes applied to a previous output given as the input file, empty for none
+    bool engineSet;     // the engine and backend were given, auto-tuning keeps them
+    bool backendSet;
+    string profile;     // calibration profile of auto-tuning
+    bool calibrate;     // measure the profile again
+};
+
+/* Names of the operators on the command line, in the order of OpKind */
+const char* const OP_NAMES[] = { "sum", "max", "min", "xor", "product" };
+
+/* The arrays of a run and where they came from, so that every exit path releases them the same way */
+template<class T>
+struct Arrays {
+    T* inArray;         // the same as outArray for an in-place scan
+    T* outArray;
+    bool sharedOut;     // outArray is shared memory
+    MappedArray inMap;  // mapped input file, inArray points into it
+    MappedArray outMap; // mapped output file, outArray points into it
+    int* overflow;      // overflow flag of a checked scan, shared like the output
+    unsigned char* heads; // head flags of a segmented scan
+};
 
 /* 
 Handle errors and bad input
@@ -34,6 +101,25 @@ void errmsg(string msg) {
     exit(1);
 }
 
+/*
+Mark the start of a phase of the run, if it is traced
+param       opts -- the options, holding the trace
+            mark -- Pointer to the mark to be filled in
+*/
+void startPhase(const Options& opts, TraceMark* mark) {
+    if(opts.policy.trace != NULL) { traceMark(opts.policy.trace, TRACE_CALLER, mark); }
+}
+
+/*
+Record a phase of the run that started at a mark, if it is traced
+param       opts -- the options, holding the trace
+            name -- string literal naming the phase
+            mark -- the mark from startPhase
+*/
+void endPhase(const Options& opts, const char* name, const TraceMark* mark) {
+    if(opts.policy.trace != NULL) { traceSpan(opts.policy.trace, TRACE_CALLER, name, -1, mark); }
+}
+
 /* 
 Determines if input values for N and M are valid, and if enough arguments were provided.
 param       argCount -- number of total arguments from main
@@ -58,22 +144,244 @@ int verifyArgs(int argCount, char* args[]) {
             return -1;
         }
     }
-    for(int i = 0; i < (int)M.length(); i++) {
+    for(int i = 0; i < (int)M.length() && M != "auto"; i++) {
         if(!isdigit(M[i])) {
             return -1;
         }
     }
 
-    // Verify values of N and M are greater than 0
-    int valN = atoi(args[1]);
-    int valM = atoi(args[2]);
-    if(valN <= 0 || valM <=0) {
+    // Verify values of N and M are greater than 0 and in range. N may exceed 2^31. M may be auto.
+    errno = 0;
+    unsigned long long valN = strtoull(args[1], NULL, 10);
+    unsigned long long valM = (M == "auto") ? 1 : strtoull(args[2], NULL, 10);
+    if(errno != 0 || valN == 0 || valM == 0 || valM > INT_MAX) {
         return -1;
     }
 
     return 0; // Validated the arguments
 }
 
+/* 
+Parse the optional arguments that follow N, M and the two file paths.
+param       argCount -- number of total arguments from main
+            args -- arguments array from main
+            opts -- Pointer to the options to be filled in
+return      -1 if an option is not recognized, 0 if valid
+*/
+int parseOptions(int argCount, char* args[], Options* opts) {
+    // Defaults of this program, which differ from the library defaults
+    opts->policy.engine = HILLIS_STEELE;
+    opts->policy.barrier = SENSE_BARRIER;
+    opts->policy.backend = PROCESS_BACKEND;
+    opts->type = INT32_TYPE;
+    opts->overflow = WRAP_OVERFLOW;
+    opts->inFormat = TEXT_FORMAT;
+    opts->outFormat = TEXT_FORMAT;
+    opts->indexBlock = INDEX_BLOCK;
+    opts->mapFiles = false;
+    opts->streamChunk = 0;
+    opts->asyncIo = true;
+    opts->ioMode = IO_AUTO;
+    opts->ioDepth = IO_DEPTH;
+    opts->pipeline = false;
+    opts->batch = NO_BATCH;
+    opts->inPlace = false;
+    opts->segmentOffsets = false;
+    opts->ops.assign(1, SUM_OP);
+    opts->stats = false;
+    opts->counters = false;
+    opts->engineSet = false;
+    opts->backendSet = false;
+    opts->profile = defaultProfilePath();
+    opts->calibrate = false;
+
+    for(int i = 5; i < argCount; i++) {
+        string arg = args[i];
+        if(arg == "--engine=hillis-steele") { opts->policy.engine = HILLIS_STEELE; opts->engineSet = true; }
+        else if(arg == "--engine=work-efficient") { opts->policy.engine = WORK_EFFICIENT; opts->engineSet = true; }
+        else if(arg == "--engine=tiled-hillis-steele") { opts->policy.engine = TILED_HILLIS_STEELE; opts->engineSet = true; }
+        else if(arg.compare(0, 12, "--tile-size=") == 0) {
+            string size = arg.substr(12);
+            if(size.empty() || size.find_first_not_of("0123456789") != string::npos) { return -1; }
+            opts->policy.tileSize = strtoull(size.c_str(), NULL, 10);
+            if(opts->policy.tileSize < 2 || (opts->policy.tileSize & (opts->policy.tileSize - 1)) != 0) { return -1; } // A power of two
+        }
+        else if(arg == "--partition=static") { opts->policy.partition = STATIC_PARTITION; }
+        else if(arg == "--partition=dynamic") { opts->policy.partition = DYNAMIC_PARTITION; }
+        else if(arg == "--barrier=counter") { opts->policy.barrier = COUNTER_BARRIER; }
+        else if(arg == "--barrier=sense") { opts->policy.barrier = SENSE_BARRIER; }
+        else if(arg == "--barrier=dissemination") { opts->policy.barrier = DISSEMINATION_BARRIER; }
+        else if(arg == "--barrier=futex") { opts->policy.barrier = FUTEX_BARRIER; }
+        else if(arg == "--backend=process") { opts->policy.backend = PROCESS_BACKEND; opts->backendSet = true; }
+        else if(arg == "--backend=thread") { opts->policy.backend = THREAD_BACKEND; opts->backendSet = true; }
+        else if(arg.compare(0, 10, "--profile=") == 0) {
+            opts->profile = arg.substr(10);
+            if(opts->profile.empty()) { return -1; }
+        }
+        else if(arg == "--calibrate") { opts->calibrate = true; }
+        else if(arg == "--type=int32") { opts->type = INT32_TYPE; }
+        else if(arg == "--type=int64") { opts->type = INT64_TYPE; }
+        else if(arg == "--type=uint64") { opts->type = UINT64_TYPE; }
+        else if(arg == "--type=float") { opts->type = FLOAT_TYPE; }
+        else if(arg == "--type=double") { opts->type = DOUBLE_TYPE; }
+        else if(arg == "--overflow=wrap") { opts->overflow = WRAP_OVERFLOW; }
+        else if(arg == "--overflow=checked") { opts->overflow = CHECKED_OVERFLOW; }
+        else if(arg == "--overflow=saturate") { opts->overflow = SATURATE_OVERFLOW; }
+        else if(arg == "--in-format=text") { opts->inFormat = TEXT_FORMAT; }
+        else if(arg == "--in-format=binary") { opts->inFormat = BINARY_FORMAT; }
+        else if(arg == "--out-format=text") { opts->outFormat = TEXT_FORMAT; }
+        else if(arg == "--out-format=binary") { opts->outFormat = BINARY_FORMAT; }
+        else if(arg == "--out-format=index") { opts->outFormat = INDEX_FORMAT; }
+        else if(arg == "--out-format=packed-index") { opts->outFormat = PACKED_INDEX_FORMAT; }
+        else if(arg == "--out-format=compressed-index") { opts->outFormat = COMPRESSED_INDEX_FORMAT; }
+        else if(arg.compare(0, 14, "--index-block=") == 0) {
+            string size = arg.substr(14);
+            if(size.empty() || size.find_first_not_of("0123456789") != string::npos) { return -1; }
+            opts->indexBlock = strtoull(size.c_str(), NULL, 10);
+            if(opts->indexBlock == 0 || opts->indexBlock > UINT32_MAX) { return -1; }
+        }
+        else if(arg == "--mmap") { opts->mapFiles = true; }
+        else if(arg == "--in-place") { opts->inPlace = true; }
+        else if(arg.compare(0, 11, "--segments=") == 0) {
+            opts->segmentFile = arg.substr(11);
+            opts->segmentOffsets = false;
+            if(opts->segmentFile.empty()) { return -1; }
+        }
+        else if(arg.compare(0, 18, "--segment-offsets=") == 0) {
+            opts->segmentFile = arg.substr(18);
+            opts->segmentOffsets = true;
+            if(opts->segmentFile.empty()) { return -1; }
+        }
+        else if(arg.compare(0, 5, "--op=") == 0) {
+            // A comma-separated list of operator names
+            opts->ops.clear();
+            string list = arg.substr(5) + ",";
+            size_t start = 0;
+            for(size_t comma = list.find(',') ; comma != string::npos ; start = comma + 1, comma = list.find(',', start)) {
+                string name = list.substr(start, comma - start);
+                int kind = 0;
+                while(kind <= PRODUCT_OP && name != OP_NAMES[kind]) { kind++; }
+                if(kind > PRODUCT_OP) { return -1; }
+                opts->ops.push_back((OpKind)kind);
+            }
+        }
+        else if(arg.compare(0, 19, "--device-threshold=") == 0) {
+            string size = arg.substr(19);
+            if(size.empty() || size.find_first_not_of("0123456789") != string::npos) { return -1; }
+            opts->policy.deviceThreshold = strtoull(size.c_str(), NULL, 10);
+        }
+        else if(arg.compare(0, 9, "--server=") == 0) {
+            opts->server = arg.substr(9);
+            if(opts->server.empty()) { return -1; }
+        }
+        else if(arg == "--stats") { opts->stats = true; }
+        else if(arg.compare(0, 8, "--trace=") == 0) {
+            opts->traceFile = arg.substr(8);
+            if(opts->traceFile.empty()) { return -1; }
+        }
+        else if(arg == "--counters") { opts->counters = true; }
+        else if(arg.compare(0, 8, "--carry=") == 0) {
+            opts->carry = arg.substr(8);
+            if(opts->carry.empty()) { return -1; }
+        }
+        else if(arg.compare(0, 9, "--append=") == 0) {
+            opts->appendFile = arg.substr(9);
+            if(opts->appendFile.empty()) { return -1; }
+        }
+        else if(arg.compare(0, 9, "--update=") == 0) {
+            opts->updateFile = arg.substr(9);
+            if(opts->updateFile.empty()) { return -1; }
+        }
+        else if(arg == "--huge-pages") { setPageSize(HUGE_PAGES); } // Global like the kernel selection
+        else if(arg == "--affinity=none") { opts->policy.affinity = AFFINITY_NONE; }
+        else if(arg == "--affinity=compact") { opts->policy.affinity = AFFINITY_COMPACT; }
+        else if(arg == "--affinity=scatter") { opts->policy.affinity = AFFINITY_SCATTER; }
+        else if(arg == "--stream") { opts->streamChunk = 1 << 20; }
+        else if(arg.compare(0, 9, "--stream=") == 0) {
+            string size = arg.substr(9);
+            if(size.empty() || size.find_first_not_of("0123456789") != string::npos) { return -1; }
+            opts->streamChunk = strtoull(size.c_str(), NULL, 10);
+            if(opts->streamChunk == 0) { return -1; }
+        }
+        else if(arg == "--io=sync") { opts->asyncIo = false; }
+        else if(arg == "--io=auto") { opts->asyncIo = true; opts->ioMode = IO_AUTO; }
+        else if(arg == "--io=uring") { opts->asyncIo = true; opts->ioMode = IO_URING; }
+        else if(arg == "--io=thread") { opts->asyncIo = true; opts->ioMode = IO_THREAD; }
+        else if(arg.compare(0, 11, "--io-depth=") == 0) {
+            string depth = arg.substr(11);
+            if(depth.empty() || depth.size() > 4 || depth.find_first_not_of("0123456789") != string::npos) { return -1; }
+            opts->ioDepth = atoi(depth.c_str());
+            if(opts->ioDepth < 2) { return -1; }
+        }
+        else if(arg == "--pipeline") { opts->pipeline = true; }
+        else if(arg == "--batch=manifest") { opts->batch = MANIFEST_BATCH; }
+        else if(arg == "--batch=arrays") { opts->batch = ARRAYS_BATCH; }
+        else if(arg.compare(0, 14, "--shared-pool=") == 0) {
+            // The pool is global, it is not part of the policy
+            if(parseSharedPool(arg.c_str() + 14) < 0) { return -1; }
+        }
+        else if(arg.compare(0, 7, "--simd=") == 0) {
+            // Kernel selection is global, it is not part of the policy
+            string name = arg.substr(7);
+            SimdLevel level;
+            if(name == "auto") { level = SIMD_AUTO; }
+            else if(name == "scalar") { level = SIMD_SCALAR; }
+            else if(name == "avx2") { level = SIMD_AVX2; }
+            else if(name == "avx512") { level = SIMD_AVX512; }
+            else if(name == "neon") { level = SIMD_NEON; }
+            else { return -1; }
+            if(setSimdLevel(level) < 0) { return -1; }
+        }
+        else { return -1; }
+    }
+
+    // A segmented scan holds its flags for the whole input, which streaming does not
+    if(!opts->segmentFile.empty() && opts->streamChunk > 0) { return -1; }
+
+    // Overflow modes are for sums, xor is for integers, and fused scans read the whole input and write a file per operator
+    bool floating = (opts->type == FLOAT_TYPE || opts->type == DOUBLE_TYPE);
+    for(size_t i = 0 ; i < opts->ops.size() ; i++) {
+        if(opts->ops[i] == XOR_OP && floating) { return -1; }
+    }
+    if(opts->overflow != WRAP_OVERFLOW && (opts->ops.size() > 1 || opts->ops[0] != SUM_OP)) { return -1; }
+    if(opts->ops.size() > 1 && (opts->streamChunk > 0 || !opts->segmentFile.empty() || opts->inPlace)) { return -1; }
+
+    // A server runs one plain scan of a whole array
+    if(!opts->server.empty() && (opts->ops.size() > 1 || opts->overflow != WRAP_OVERFLOW || opts->streamChunk > 0 ||
+                                 !opts->segmentFile.empty())) { return -1; }
+
+    // A pipeline writes a single scan of text as it goes
+    if(opts->pipeline && (opts->inFormat != TEXT_FORMAT || opts->outFormat != TEXT_FORMAT || opts->ops.size() > 1 ||
+                          opts->streamChunk > 0 || !opts->segmentFile.empty() || opts->inPlace || !opts->server.empty())) {
+        return -1;
+    }
+
+    // A batch runs plain scans of whole arrays, read and written as text or binary files
+    if(opts->batch != NO_BATCH && (opts->ops.size() > 1 || opts->streamChunk > 0 || !opts->segmentFile.empty() || opts->inPlace ||
+                                   !opts->server.empty() || opts->pipeline || opts->mapFiles || opts->stats ||
+                                   !opts->traceFile.empty() || opts->inFormat > BINARY_FORMAT || opts->outFormat > BINARY_FORMAT ||
+                                   (opts->backendSet && opts->policy.backend == PROCESS_BACKEND))) {
+        return -1;
+    }
+
+    // Incremental runs continue or change one plain array scan. Updates need sums that can be taken apart again exactly.
+    int incremental = !opts->carry.empty() + !opts->appendFile.empty() + !opts->updateFile.empty();
+    if(incremental > 1) { return -1; }
+    if(incremental == 1 && (opts->ops.size() > 1 || opts->streamChunk > 0 || !opts->segmentFile.empty() || opts->inPlace ||
+                            !opts->server.empty() || opts->pipeline || opts->batch != NO_BATCH)) { return -1; }
+    if(!opts->updateFile.empty() && (opts->ops[0] != SUM_OP || opts->overflow != WRAP_OVERFLOW || floating)) { return -1; }
+
+    // Saturation is not associative, so saturating sums are taken left to right on one worker, never regrouped around a carry
+    if(opts->overflow == SATURATE_OVERFLOW && (incremental > 0 || opts->pipeline || opts->batch != NO_BATCH)) { return -1; }
+
+    // An index is written whole, from the full output, and only packs integers
+    bool blocks = (opts->outFormat == PACKED_INDEX_FORMAT || opts->outFormat == COMPRESSED_INDEX_FORMAT);
+    if((opts->outFormat == INDEX_FORMAT || blocks) && (opts->streamChunk > 0 || !opts->appendFile.empty())) { return -1; }
+    if(blocks && floating) { return -1; }
+
+    return 0;
+}
+
 /* 
 Create the input array from the given input file
 param       filename -- path of the file to be read
@@ -81,7 +389,8 @@ param       filename -- path of the file to be read
             N -- the number of values to be read
 return      the number of values written, or -1 if unable to open the file
 */
-int makeInputArray(string filename, int* array, int N) {
+template<class T>
+long long makeInputArray(string filename, T* array, size_t N) {
     ifstream in;
     in.open(filename.c_str());
 
@@ -91,8 +400,8 @@ int makeInputArray(string filename, int* array, int N) {
     }
 
     // Create the array
-    int count = 0;
-    int currentValue;
+    size_t count = 0;
+    T currentValue;
     while(in >> currentValue) {
         if(count >= N) { break; } // Do not go out of range
         array[count] = currentValue;
@@ -100,190 +409,1220 @@ int makeInputArray(string filename, int* array, int N) {
     }
 
     in.close(); // Close the input file
-    return count;
+    return (long long)count;
 }
 
-/* 
-Create the output file from the given array
-param       filename -- path of the file to be written to
-            array -- Pointer to the first element of the output array to be read
-            N -- the size of the array
-return      0 if successful, or -1 if unable to open the file
+/*
+Read the segments of a segmented scan as head flags
+param       filename -- path of the text file, one flag per element (nonzero starts a segment) or one start index per
+                        segment in ascending order
+            offsets -- true if the file holds start indices
+            heads -- Pointer to the N flags to be filled in
+            N -- the number of elements
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if the file cannot be mapped or is not valid
 */
-int writeOutputArray(string filename, int* array, int N) {
-    ofstream out;
-    out.open(filename.c_str());
+int readSegmentHeads(string filename, bool offsets, unsigned char* heads, size_t N, const ExecPolicy& policy) {
+    if(!offsets) {
+        // A missing last flag counts as zero, like a missing last value
+        long long count = parseTextArray(filename, heads, N, policy);
+        if(count < 0 || count < (long long)N - 1) { return -1; }
+        if(count < (long long)N) { heads[N - 1] = 0; }
+        return 0;
+    }
 
-    /* Clean exit if unable to open the file */
-    if(!out.is_open()) {
+    TextFile file;
+    if(mapTextFile(filename, &file) < 0) { return -1; }
+    if(file.base == NULL) {
+        memset(heads, 0, N); // No offsets, the whole input is one segment
+        return 0;
+    }
+    size_t segments = countValues((const char*)file.base, file.length);
+    vector<size_t> starts(segments);
+    size_t used;
+    size_t count = parseTextBuffer((const char*)file.base, file.length, starts.data(), segments, policy, &used);
+    unmapTextFile(&file);
+    if(count < segments) {
+        errno = EINVAL;
         return -1;
     }
+    return headsFromOffsets(starts.data(), segments, N, heads);
+}
 
-    // Write the array to the output file
-    for(int i = 0 ; i < N ; i++) {
-        out << array[i] << '\n';
+/*
+Read the number of values of a previous output and its last value, the running total a scan appended to it continues from
+param       filename -- path of the previous output
+            format -- the format of the file
+            count -- Pointer receiving the number of values
+            last -- Pointer receiving the last value, unchanged if there are none
+return      0 if successful, or -1 if the file cannot be read or is not valid
+*/
+template<class T>
+int readPrevious(string filename, FileFormat format, size_t* count, T* last) {
+    if(format == BINARY_FORMAT) {
+        BinaryType type = BinaryTypeOf<T>::value;
+        int fd = openBinaryStream(filename, type, sizeof(T), count);
+        if(fd < 0) { return -1; }
+        close(fd);
+        if(*count > 0 && readBinaryRange(filename, type, sizeof(T), last, *count - 1, 1) != 1) { return -1; }
+        return 0;
     }
-    out.close();
 
+    TextFile file;
+    if(mapTextFile(filename, &file) < 0) { return -1; }
+    *count = 0;
+    if(file.base == NULL) { return 0; } // An empty file
+    const char* text = (const char*)file.base;
+    *count = countValues(text, file.length);
+
+    // The last value is the last word of the file
+    size_t end = file.length;
+    while(end > 0 && isSpace(text[end - 1])) { end--; }
+    size_t start = end;
+    while(start > 0 && !isSpace(text[start - 1])) { start--; }
+    bool valid = (*count == 0 || decodeValue(text + start, text + end, last) == text + end);
+    unmapTextFile(&file);
+    if(!valid) {
+        errno = EINVAL;
+        return -1;
+    }
     return 0;
 }
 
-/* 
-Perform the Hillis and Steele algorithm, executed by child processes
-param       thisArray -- Array for the current iteration
-            nextArray -- array for the next iteration
-            thisProcess -- the number associated with the current process
-            processes -- the total number of processes
-            iter -- the number of the current iteration
-            blockSize -- the number of elements to be handled by the current process
-            arraySize -- the size of the arrays
+/*
+Copy a file
+param       source -- path of the file to be copied
+            target -- path of the copy, replaced if it exists
+return      0 if successful, or -1 if either file cannot be opened or the copy failed
 */
-void parallelScan(int* thisArray, int* nextArray, int thisProcess, int processes, int iter, int blockSize, int arraySize) {
-    // Determine the range for the current process
-    int blockStart = thisProcess * blockSize;
-    int blockEnd = blockStart + blockSize;
+int copyFile(string source, string target) {
+    int in = open(source.c_str(), O_RDONLY);
+    if(in < 0) { return -1; }
+    int out = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out < 0) {
+        int error = errno;
+        close(in);
+        errno = error;
+        return -1;
+    }
 
-    // If current process is the last one, blockEnd should be the last element
-    if(thisProcess == (processes -1)) { blockEnd = arraySize; }
+    // The kernel copies the pages when it can, a plain read and write loop does it otherwise
+    int result = 0;
+    bool kernelCopy = true;
+    vector<char> buffer;
+    for(;;) {
+        ssize_t n;
+        if(kernelCopy) {
+            n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0);
+            if(n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                kernelCopy = false;
+                buffer.resize(1 << 20);
+                continue;
+            }
+        }
+        else {
+            n = read(in, buffer.data(), buffer.size());
+            for(ssize_t done = 0 ; n > 0 && done < n ; ) {
+                ssize_t written = write(out, buffer.data() + done, n - done);
+                if(written < 0 && errno == EINTR) { continue; }
+                if(written < 0) {
+                    n = -1;
+                    break;
+                }
+                done += written;
+            }
+        }
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n <= 0) {
+            result = (n < 0) ? -1 : 0;
+            break;
+        }
+    }
+    int error = errno;
+    close(in);
+    if(close(out) < 0 && result == 0) {
+        result = -1;
+        error = errno;
+    }
+    errno = error;
+    return result;
+}
 
-    int temp = (int)pow(2, iter); // value to be used in the algorithm
+/*
+Write an output array to a file in the output format
+param       filename -- path of the file to be written
+            array -- the output array
+            N -- the number of elements
+            opts -- the options
+return      0 if successful, or -1 if the file cannot be written
+*/
+template<class T>
+int writeOutput(string filename, const T* array, size_t N, const Options& opts) {
+    switch(opts.outFormat) {
+        case TEXT_FORMAT: return formatTextArray(filename, array, N, opts.policy);
+        case BINARY_FORMAT: return writeBinaryArray(filename, BinaryTypeOf<T>::value, sizeof(T), array, N);
+        case INDEX_FORMAT: return writePrefixIndex(filename, array, N, INDEX_PLAIN, opts.indexBlock, opts.policy);
+        case PACKED_INDEX_FORMAT: return writePrefixIndex(filename, array, N, INDEX_PACKED, opts.indexBlock, opts.policy);
+        default: return writePrefixIndex(filename, array, N, INDEX_COMPRESSED, opts.indexBlock, opts.policy);
+    }
+}
+
+/*
+Release the arrays of a run
+param       arrays -- Pointer to the arrays, entries that were never created are NULL
+*/
+template<class T>
+void releaseArrays(Arrays<T>* arrays) {
+    if(arrays->inMap.base != NULL) { unmapArray(&arrays->inMap); }
+    else if(arrays->inArray != arrays->outArray) { releaseMemory(false, arrays->inArray); }
+    if(arrays->outMap.base != NULL) { unmapArray(&arrays->outMap); }
+    else { releaseMemory(arrays->sharedOut, arrays->outArray); } // Remove the shared memory
+    releaseMemory(arrays->sharedOut, arrays->overflow);
+    releaseMemory(false, arrays->heads);
+    arrays->inArray = NULL;
+    arrays->outArray = NULL;
+    arrays->overflow = NULL;
+    arrays->heads = NULL;
+}
+
+/*
+Release the arrays of a run and exit with an error message
+param       arrays -- Pointer to the arrays
+            msg -- String to be printed to user
+*/
+template<class T>
+void fail(Arrays<T>* arrays, string msg) {
+    int error = errno; // Releasing must not change the reported error
+    releaseArrays(arrays);
+    errno = error;
+    errmsg(msg);
+}
 
-    // Perform algorithm
-    for(int k = blockStart ; k < blockEnd ; k++) {
-        if(k >= arraySize) { break; } // Out of range, don't calculate
-        if(k < temp) {
-            nextArray[k] = thisArray[k]; // Same value copied for next iteration
+/*
+Create the input array from the input file: the mapped file, the output array of an in-place scan, or memory of its own
+param       arrSize, infileName, opts -- as for runScan
+            arrays -- Pointer to the arrays of the run, exits through fail on errors
+*/
+template<class T>
+void readInput(size_t arrSize, string infileName, const Options& opts, Arrays<T>* arrays) {
+    BinaryType type = BinaryTypeOf<T>::value;
+
+    /* Create the input array from the given input file */
+    // count = the number of values read from the input file, or -1 if file was not able to open
+    long long count;
+    if(opts.mapFiles && opts.inFormat == BINARY_FORMAT && !opts.inPlace) {
+        // The scan reads the mapped file directly
+        count = mapInputArray(infileName, type, sizeof(T), &arrays->inMap);
+        if(count == 0) {
+            arrays->inArray = (T*)arrays->inMap.data;
+            count = (long long)arrays->inMap.count;
         }
+    }
+    else {
+        // An in-place scan reads the input into the output array and needs no second array
+        if(opts.inPlace) { arrays->inArray = arrays->outArray; }
+        else { arrays->inArray = (T*)allocateMemory(false, sizeof(T)*arrSize); }
+        if(arrays->inArray == NULL) {
+            fail(arrays, "Error creating shared memory segment.");
+        }
+        if(opts.policy.affinity != AFFINITY_NONE && !opts.inPlace && touchBlocks(arrays->inArray, arrSize, opts.policy) < 0) {
+            fail(arrays, "Unable to run the scan.");
+        }
+        if(opts.inFormat == BINARY_FORMAT) { count = readBinaryArray(infileName, type, sizeof(T), arrays->inArray, arrSize); }
         else {
-            nextArray[k] = thisArray[k] + thisArray[k - temp];
+            // Files that cannot be mapped, like pipes, are read as a stream
+            count = parseTextArray(infileName, arrays->inArray, arrSize, opts.policy);
+            if(count < 0) { count = makeInputArray(infileName, arrays->inArray, arrSize); }
         }
     }
+
+    /* Clean exit if unable to open the input file or not enough input values */
+    if(count < 0 || count < (long long)arrSize - 1) {
+        fail(arrays, "Invalid input file.");
+    }
+    if(count < (long long)arrSize) {
+        // A missing last value counts as zero
+        if(arrays->inMap.base != NULL) { fail(arrays, "Invalid input file."); } // It cannot be filled in a read-only mapping
+        arrays->inArray[arrSize - 1] = T();
+    }
 }
 
-/* 
-Synchronize the processes with the barrier
-param       turn -- Pointer to the barrier counter
-            thisProcess -- the number associated with the current process
-            iter -- the number of the current iteration
-            processes -- the total number of processes
+/*
+Stream a binary file into another with streamScanFiles, reading chunks ahead and writing them behind the scan
+param       arrSize, opts, op, overflow -- as for runScan
+            inFd, inOffset -- the input file and the offset of its first element, closed here
+            inAvailable -- the number of elements the input holds
+            outFd, outOffset -- the output file and the offset of its first element, closed here
 */
-void synchronize(int* turn, int thisProcess, int iter, int processes) {
-    while(turn[0] != ((iter*processes) + thisProcess)); // Current process must wait for its turn
-    turn[0]++; // Increment the barrier since it's our turn
-    while(turn[0] < ((iter+1)*processes)); // Wait for all processes to have their turn for this iteration
+template<class T, class Op>
+void runAsyncStream(size_t arrSize, int inFd, off_t inOffset, size_t inAvailable, int outFd, off_t outOffset,
+                    const Options& opts, Op op, int* overflow) {
+    bool shared = (opts.policy.backend == PROCESS_BACKEND);
+    IoConfig config;
+    config.chunk = opts.streamChunk;
+    config.depth = opts.ioDepth;
+    config.mode = opts.ioMode;
+
+    // A missing last value counts as zero
+    long long total = -1;
+    int error = EINVAL;
+    bool shortInput = (inAvailable + 1 < arrSize);
+    if(!shortInput) {
+        TraceMark mark;
+        startPhase(opts, &mark);
+        total = streamScanFiles<T>(inFd, inOffset, inAvailable, outFd, outOffset, arrSize, config, op, overflow, opts.policy);
+        endPhase(opts, "stream", &mark);
+        error = errno;
+    }
+    close(inFd);
+    if(close(outFd) < 0 && total >= 0) {
+        total = -1;
+        error = errno;
+    }
+    releaseMemory(shared, overflow);
+    errno = error;
+
+    if(shortInput) { errmsg("Invalid input file."); }
+    if(total < 0 && error == ECANCELED) {
+        errno = ERANGE;
+        errmsg("The prefix sum overflows the element type.");
+    }
+    if(total < 0) { errmsg("Unable to run the scan."); }
 }
 
 /*
-Swap the array pointers.
-param       arrayOne -- a pointer to the first element of the first array
-            arrayTwo -- a pointer to the first element of the second arrray
+Compute the prefix sum chunk by chunk, reading the input and writing the output as a stream, so that neither has to fit
+in memory. Failures found after the output was started leave it incomplete.
+param       arrSize, infileName, outfileName, opts, op, overflow -- as for runScan
 */
-void swapArrays(int** arrayOne, int** arrayTwo) {
-    int* temp = *arrayOne;
-    *arrayOne = *arrayTwo;
-    *arrayTwo = temp;
+template<class T, class Op>
+void runStream(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    BinaryType type = BinaryTypeOf<T>::value;
+    bool shared = (opts.policy.backend == PROCESS_BACKEND);
+    TextStream text;
+    int inFd = -1;
+    size_t inAvailable = 0; // elements a binary input holds
+
+    /* Open the input */
+    if(opts.inFormat == TEXT_FORMAT) {
+        size_t capacity = sizeof(T)*opts.streamChunk < 4096 ? 4096 : sizeof(T)*opts.streamChunk;
+        if(openTextStream(infileName, capacity, &text) < 0) {
+            releaseMemory(shared, overflow);
+            errmsg("Invalid input file.");
+        }
+    }
+    else {
+        inFd = openBinaryStream(infileName, type, sizeof(T), &inAvailable);
+        if(inFd < 0) {
+            releaseMemory(shared, overflow);
+            errmsg("Invalid input file.");
+        }
+    }
+
+    /* Open the output */
+    int outFd;
+    if(opts.outFormat == TEXT_FORMAT) { outFd = openTextOutput(outfileName); }
+    else { outFd = createBinaryStream(outfileName, type, sizeof(T), arrSize); }
+    if(outFd < 0) {
+        int error = errno;
+        if(opts.inFormat == TEXT_FORMAT) { closeTextStream(&text); }
+        else { close(inFd); }
+        releaseMemory(shared, overflow);
+        errno = error;
+        errmsg("Unable to open the output file.");
+    }
+
+    // Binary files that can be read and written at offsets are streamed with asynchronous I/O
+    off_t inOffset = (opts.asyncIo && opts.inFormat == BINARY_FORMAT) ? lseek(inFd, 0, SEEK_CUR) : -1;
+    off_t outOffset = (opts.asyncIo && opts.outFormat == BINARY_FORMAT) ? lseek(outFd, 0, SEEK_CUR) : -1;
+    if(inOffset >= 0 && outOffset >= 0) {
+        runAsyncStream<T>(arrSize, inFd, inOffset, inAvailable, outFd, outOffset, opts, op, overflow);
+        return;
+    }
+
+    // Read at most arrSize values, a missing last value counts as zero
+    size_t readCount = 0;
+    bool shortInput = false;
+    ChunkReader<T> reader = [&](T* chunk, size_t capacity) -> long long {
+        size_t wanted = arrSize - readCount < capacity ? arrSize - readCount : capacity;
+        if(wanted == 0) { return 0; }
+        long long n;
+        if(opts.inFormat == TEXT_FORMAT) { n = readTextChunk(&text, chunk, wanted, opts.policy); }
+        else {
+            size_t left = inAvailable - readCount;
+            n = readElements(inFd, sizeof(T), chunk, wanted < left ? wanted : left);
+        }
+        if(n < 0) { return -1; }
+        if(n == 0) {
+            if(arrSize - readCount > 1) {
+                shortInput = true;
+                errno = EINVAL;
+                return -1;
+            }
+            chunk[0] = T();
+            n = 1;
+        }
+        readCount += n;
+        return n;
+    };
+
+    // Text is formatted on a pool of its own, on the shared pool the reading and scanning of the next chunk would wait for it
+    ExecPolicy formatPolicy = opts.policy;
+    unique_ptr<ThreadPool> formatPool;
+    if(opts.outFormat == TEXT_FORMAT && formatPolicy.workers > 1) {
+        formatPool.reset(new ThreadPool(formatPolicy.workers));
+        formatPolicy.pool = formatPool.get();
+    }
+
+    // A checked scan that overflowed is not written any further
+    bool writeFailed = false;
+    ChunkWriter<T> writer = [&](const T* chunk, size_t n) -> int {
+        if(overflow != NULL && __atomic_load_n(overflow, __ATOMIC_RELAXED)) {
+            errno = ERANGE;
+            return -1;
+        }
+        int written;
+        if(opts.outFormat == TEXT_FORMAT) { written = writeTextArray(outFd, chunk, n, formatPolicy); }
+        else { written = writeElements(outFd, sizeof(T), chunk, n); }
+        if(written < 0) { writeFailed = true; }
+        return written;
+    };
+
+    TraceMark mark;
+    startPhase(opts, &mark);
+    long long total = streamScan(reader, writer, opts.streamChunk, op, opts.policy);
+    endPhase(opts, "stream", &mark);
+    int error = errno;
+    if(opts.inFormat == TEXT_FORMAT) { closeTextStream(&text); }
+    else { close(inFd); }
+    if(close(outFd) < 0 && total >= 0) {
+        total = -1;
+        writeFailed = true;
+        error = errno;
+    }
+    releaseMemory(shared, overflow);
+    errno = error;
+
+    if(total < 0 && shortInput) { errmsg("Invalid input file."); }
+    if(total < 0 && error == ERANGE) { errmsg("The prefix sum overflows the element type."); }
+    if(total < 0 && writeFailed) { errmsg("Unable to write the output file."); }
+    if(total < 0) { errmsg("Unable to run the scan."); }
 }
 
 /*
-Remove the shared memory segments associated with the given memory IDs
-param       memOne, memTwo, memThree -- Memory IDs of the shared memory segments
-            ptrOne, ptrTwo, ptrThree -- Pointers attached to the shared memory segments
+Parse, scan and format text in one pass with pipelineScan, without arrays of the whole input or output. Failures found
+after the output was started leave it incomplete.
+param       arrSize, infileName, outfileName, opts, op, overflow -- as for runScan
 */
-void removeMemory(int memOne, int memTwo, int memThree, int* ptrOne, int* ptrTwo, int* ptrThree) {
-    // Detach from shared memory
-    shmdt((void*) ptrOne);
-    shmdt((void*) ptrTwo);
-    shmdt((void*) ptrThree);
-    // Remove the shared memory segment
-    shmctl(memOne, IPC_RMID, NULL);
-    shmctl(memTwo, IPC_RMID, NULL);
-    shmctl(memThree, IPC_RMID, NULL);
+template<class T, class Op>
+void runPipeline(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    bool shared = (opts.policy.backend == PROCESS_BACKEND);
+    TextFile file;
+    if(mapTextFile(infileName, &file) < 0) {
+        releaseMemory(shared, overflow);
+        errmsg("Invalid input file.");
+    }
+    int outFd = openTextOutput(outfileName);
+    if(outFd < 0) {
+        int error = errno;
+        unmapTextFile(&file);
+        releaseMemory(shared, overflow);
+        errno = error;
+        errmsg("Unable to open the output file.");
+    }
+
+    TraceMark mark;
+    startPhase(opts, &mark);
+    T total = T();
+    long long count = 0;
+    if(file.base != NULL) { count = pipelineScan((const char*)file.base, file.length, outFd, arrSize, op, opts.policy, &total); }
+    if(count >= 0 && (size_t)count + 1 == arrSize) {
+        // A missing last value counts as zero
+        T last = (count > 0) ? op(total, T()) : T();
+        count = (writeTextArray(outFd, &last, 1, opts.policy) < 0) ? -1 : count + 1;
+    }
+    endPhase(opts, "pipeline", &mark);
+    int error = errno;
+    unmapTextFile(&file);
+    if(close(outFd) < 0 && count >= 0) {
+        count = -1;
+        error = errno;
+    }
+    bool overflowed = (overflow != NULL && *overflow);
+    releaseMemory(shared, overflow);
+    errno = error;
+
+    if(count < 0) { errmsg("Unable to write the output file."); }
+    if(overflowed) {
+        errno = ERANGE;
+        errmsg("The prefix sum overflows the element type.");
+    }
+    if((size_t)count < arrSize) {
+        errno = EINVAL;
+        errmsg("Invalid input file.");
+    }
 }
 
+/* One pair of files of a batch */
+struct BatchJob {
+    string input;
+    string output;
+    size_t capacity;    // elements the input can hold, at most N
+};
 
-/* Start of main */
-int main(int argc, char* argv[]) {
-    // Check the number of arguments and values for N and M are valid
-    if(verifyArgs(argc, argv) < 0) {
-        errmsg("Invalid arguments provided."); // clean exit
+/*
+Read the pairs of files of a batch
+param       filename -- path of the manifest, one pair "<input> <output>" per line. Blank lines and lines starting with #
+            are skipped.
+            directory -- the directory of outputs given by relative paths
+            jobs -- Pointer to the pairs to be filled in
+return      0 if successful, or -1 if the manifest cannot be read or a line is not a pair
+*/
+int readManifest(string filename, string directory, vector<BatchJob>* jobs) {
+    ifstream in(filename.c_str());
+    if(!in.is_open()) { return -1; }
+
+    string line;
+    while(getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if(start == string::npos || line[start] == '#') { continue; }
+        char input[PATH_MAX], output[PATH_MAX], rest[2];
+        if(line.size() >= PATH_MAX || sscanf(line.c_str(), "%s %s %1s", input, output, rest) != 2) {
+            errno = EINVAL;
+            return -1;
+        }
+        BatchJob job;
+        job.input = input;
+        job.output = (output[0] == '/' || directory.empty()) ? string(output) : directory + "/" + output;
+        job.capacity = 0;
+        jobs->push_back(job);
     }
+    return 0;
+}
 
-    /* Assign the input args */
-    int arrSize = atoi(argv[1]);
-    int numProcesses = atoi(argv[2]);
-    string infileName = argv[3];
-    string outfileName = argv[4];
+/*
+Get the operator of one job of a batch, a checked sum gets an overflow flag of its own
+param       op -- the operator of the run
+            overflow -- the flag of the job
+return      the operator of the job
+*/
+template<class Op>
+Op jobOperator(Op op, int* overflow) {
+    return op;
+}
+
+CheckedPlus jobOperator(CheckedPlus op, int* overflow) {
+    return CheckedPlus(overflow);
+}
 
-    /* If there are more cores than N, no need to make additional processes */
-    if(numProcesses > arrSize) { numProcesses = arrSize; }
+/*
+Scan one pair of files of a batch. The input holds up to capacity values, fewer than N are not an error.
+param       job -- the files
+            opts -- the options, for the file formats
+            op -- the operator
+            overflow -- the flag of a checked op, or NULL
+            policy -- the workers of the scan, one for a job packed with others
+return      NULL if successful, or the message of the error with errno set
+*/
+template<class T, class Op>
+const char* runBatchJob(const BatchJob& job, const Options& opts, Op op, int* overflow, const ExecPolicy& policy) {
+    // The scan is in place, the input is read into the output array
+    T* array = (T*)allocateMemory(false, sizeof(T)*job.capacity);
+    if(array == NULL) { return "Error creating shared memory segment."; }
 
-    /* Create the shared memory segments */
-    size_t memSize1 = sizeof(int)*arrSize;
-    size_t memSize2 = sizeof(int)*arrSize;
-    size_t memSize3 = sizeof(int);
-    int memID1 = shmget(IPC_PRIVATE, memSize1, S_IRUSR | S_IWUSR );
-    int memID2 = shmget(IPC_PRIVATE, memSize2, S_IRUSR | S_IWUSR );
-    int memID3 = shmget(IPC_PRIVATE, memSize3, S_IRUSR | S_IWUSR );
+    long long count;
+    if(opts.inFormat == BINARY_FORMAT) { count = readBinaryArray(job.input, BinaryTypeOf<T>::value, sizeof(T), array, job.capacity); }
+    else {
+        count = parseTextArray(job.input, array, job.capacity, policy);
+        if(count < 0) { count = makeInputArray(job.input, array, job.capacity); }
+    }
+    const char* error = NULL;
+    if(count < 0) { error = "Invalid input file."; }
+    else if(inclusive_scan_inplace(array, (size_t)count, op, policy) < 0) { error = "Unable to run the scan."; }
+    else if(overflow != NULL && *overflow) {
+        errno = ERANGE;
+        error = "The prefix sum overflows the element type.";
+    }
+    else {
+        int written = (opts.outFormat == BINARY_FORMAT) ?
+                      writeBinaryArray(job.output, BinaryTypeOf<T>::value, sizeof(T), array, (size_t)count) :
+                      formatTextArray(job.output, array, (size_t)count, policy);
+        if(written < 0) { error = "Unable to open the output file."; }
+    }
 
-    // Clean exit if unable to create the shared memory
-    if(memID1 < 0 || memID2 < 0 || memID3 < 0) {
-        errmsg("Error creating shared memory segment.");
+    int code = errno;
+    releaseMemory(false, array);
+    errno = code;
+    return error;
+}
+
+/*
+Scan the pairs of files listed in A. Inputs of at most N values are packed onto the workers and scanned by one worker each,
+larger ones are read, scanned and written by all the workers. Every pair is scanned even if others fail.
+param       arrSize -- the largest number of values of an input
+            infileName -- path of the manifest
+            outfileName -- the directory of outputs given by relative paths
+            opts, op, overflow -- as for runScan
+*/
+template<class T, class Op>
+void runManifest(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    vector<BatchJob> jobs;
+    if(readManifest(infileName, outfileName, &jobs) < 0) {
+        releaseMemory(false, overflow);
+        errmsg("Invalid input file.");
     }
 
-    /* Init arrays and barrier and attach to shared memory*/
-    int *inArray = (int*)shmat(memID1, NULL, 0); // shmat returns a pointer to the shared memory segment
-    int *outArray = (int*)shmat(memID2, NULL, 0);
-    int *barrier = (int*)shmat(memID3, NULL, 0);
-    
-    /* Init the barrier */
-    *barrier = 0;
+    // The size of a file bounds its values: text has a separator after every value but the last. Pipes may hold N.
+    vector<size_t> costs(jobs.size());
+    for(size_t i = 0 ; i < jobs.size() ; i++) {
+        struct stat info;
+        size_t capacity = arrSize;
+        if(stat(jobs[i].input.c_str(), &info) < 0) { capacity = 0; } // Reading it fails with the error
+        else if(S_ISREG(info.st_mode)) {
+            size_t bytes = (size_t)info.st_size;
+            size_t values = (opts.inFormat == BINARY_FORMAT) ? (bytes > BINARY_HEADER_SIZE ? (bytes - BINARY_HEADER_SIZE) / sizeof(T) : 0) :
+                                                               bytes / 2 + 1;
+            if(values < capacity) { capacity = values; }
+        }
+        jobs[i].capacity = capacity;
+        costs[i] = capacity;
+    }
+    BatchPlan plan;
+    planBatch(costs.data(), costs.size(), opts.policy.workers, BATCH_SPLIT, &plan);
 
-    /* Create the input array from the given input file */
-    // count = the number of values read from the input file, or -1 if file was not able to open
-    int count = makeInputArray(infileName, inArray, arrSize);
+    ExecPolicy alone = opts.policy; // Every worker runs its jobs alone, on its own thread
+    alone.workers = 1;
+    alone.engine = WORK_EFFICIENT;
+    alone.affinity = AFFINITY_NONE;
+    vector<const char*> errors(jobs.size(), (const char*)NULL);
+    vector<int> codes(jobs.size(), 0);
+    auto runJob = [&](size_t i, const ExecPolicy& policy) {
+        int flag = 0;
+        errors[i] = runBatchJob<T>(jobs[i], opts, jobOperator(op, &flag), overflow != NULL ? &flag : NULL, policy);
+        codes[i] = errno;
+    };
+    if(!plan.packed.empty() && runWorkers(opts.policy, (int)plan.packed.size(), [&](int j) {
+        for(size_t k = 0 ; k < plan.packed[j].size() ; k++) { runJob(plan.packed[j][k], alone); }
+    }) < 0) {
+        releaseMemory(false, overflow);
+        errmsg("Unable to run the scan.");
+    }
+    for(size_t k = 0 ; k < plan.split.size() ; k++) { runJob(plan.split[k], opts.policy); }
+    releaseMemory(false, overflow);
 
-    /* Clean exit if unable to open the input file or not enough input values */
-    if(count < 0 || count < (arrSize-1)) {
-        removeMemory(memID1, memID2, memID3, inArray, outArray, barrier); // Remove the shared memory
+    // Report every pair that failed, like errmsg does
+    bool failed = false;
+    for(size_t i = 0 ; i < jobs.size() ; i++) {
+        if(errors[i] == NULL) { continue; }
+        fprintf(stderr, "%s: %s: %s\n", jobs[i].input.c_str(), errors[i], strerror(codes[i]));
+        failed = true;
+    }
+    if(failed) { exit(1); }
+}
+
+/*
+Scan the binary arrays stored one after another in A, each a header and its elements as in a binary file, into B in the
+same layout. Arrays of more than N elements are cut to N.
+param       arrSize -- the largest number of elements of an array
+            infileName -- path of the input, a regular file so that it can be mapped
+            outfileName -- path of the output
+            opts, op, overflow -- as for runScan
+*/
+template<class T, class Op>
+void runArrays(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    TextFile file;
+    if(mapTextFile(infileName, &file) < 0) {
+        releaseMemory(false, overflow);
         errmsg("Invalid input file.");
     }
 
-    // Calculate the number of iterations needed
-    int iterations = floor(log2f(arrSize));
+    // Find the arrays and the size of the output
+    const char* input = (const char*)file.base;
+    vector<size_t> starts;
+    vector<size_t> counts;
+    size_t outLength = 0;
+    bool valid = true;
+    for(size_t offset = 0 ; offset < file.length && valid ; ) {
+        BinaryHeader header;
+        valid = (file.length - offset >= BINARY_HEADER_SIZE);
+        if(valid) {
+            memcpy(&header, input + offset, sizeof(header));
+            valid = (checkBinaryHeader(&header, BinaryTypeOf<T>::value, sizeof(T)) == 0 &&
+                     header.count <= (file.length - offset - BINARY_HEADER_SIZE) / sizeof(T));
+        }
+        if(valid) {
+            starts.push_back(offset + BINARY_HEADER_SIZE);
+            counts.push_back(header.count < arrSize ? header.count : arrSize);
+            outLength += BINARY_HEADER_SIZE + sizeof(T)*counts.back();
+            offset += BINARY_HEADER_SIZE + sizeof(T)*header.count;
+        }
+    }
+    char* output = valid ? (char*)allocateMemory(false, outLength) : NULL;
+    if(output == NULL) {
+        int error = valid ? errno : EINVAL;
+        unmapTextFile(&file);
+        releaseMemory(false, overflow);
+        errno = error;
+        errmsg(valid ? "Error creating shared memory segment." : "Invalid input file.");
+    }
 
-    // Calculate the size of each block (index range per process)
-    int blockSize = round((float)arrSize/(float)numProcesses);
-    int status = 0; // For waiting for child processes
+    vector<BatchArray<T> > arrays(starts.size());
+    size_t outOffset = 0;
+    for(size_t i = 0 ; i < arrays.size() ; i++) {
+        initBinaryHeader((BinaryHeader*)(output + outOffset), BinaryTypeOf<T>::value, sizeof(T), counts[i]);
+        arrays[i].in = (const T*)(input + starts[i]);
+        arrays[i].out = (T*)(output + outOffset + BINARY_HEADER_SIZE);
+        arrays[i].n = counts[i];
+        outOffset += BINARY_HEADER_SIZE + sizeof(T)*counts[i];
+    }
 
-    /* Create the processes */
-    for(int j = 0 ; j < numProcesses ; j++) {
-        if(fork() == 0) {
-            // Child process begins here
-            // j is the process number
-            for(int i = 0 ; i <= iterations ; i++) {
-                parallelScan(inArray, outArray, j, numProcesses, i, blockSize, arrSize); // Compute for this iteration
-                synchronize(barrier, j, i, numProcesses); // synchronize all processes
-                swapArrays(&inArray, &outArray); // swap the arrays
-            }
-            // Child process ends
-            exit(0);
+    const char* error = NULL;
+    if(batchScan(arrays.data(), arrays.size(), op, opts.policy) < 0) { error = "Unable to run the scan."; }
+    else if(overflow != NULL && *overflow) {
+        errno = ERANGE;
+        error = "The prefix sum overflows the element type.";
+    }
+    else {
+        // The whole output in one write
+        vector<struct iovec> pieces(1);
+        pieces[0].iov_base = output;
+        pieces[0].iov_len = outLength;
+        int fd = openTextOutput(outfileName);
+        if(fd < 0 || writeBuffers(fd, &pieces) < 0 || closeTextOutput(fd) < 0) {
+            if(fd >= 0) { close(fd); }
+            error = "Unable to open the output file.";
         }
     }
-    // Parent wait for children to complete
-    while(wait(&status) > 0);
 
-    // If iterations is odd, swap the arrays
-    if((iterations % 2) != 0) swapArrays(&inArray, &outArray);
+    int code = errno;
+    unmapTextFile(&file);
+    releaseMemory(false, output);
+    releaseMemory(false, overflow);
+    if(error != NULL) {
+        errno = code;
+        errmsg(error);
+    }
+}
 
-    // Write the result to the output file
+/*
+Scan many arrays in one run, on one pool of workers
+param       arrSize, infileName, outfileName, opts, op, overflow -- as for runManifest and runArrays
+*/
+template<class T, class Op>
+void runBatch(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    if(opts.batch == MANIFEST_BATCH) { runManifest<T>(arrSize, infileName, outfileName, opts, op, overflow); }
+    else { runArrays<T>(arrSize, infileName, outfileName, opts, op, overflow); }
+}
+
+/*
+Scan only the values A gained since a previous output was written, continuing from its last value, and write B as the
+previous output followed by the new results. B is extended in place when it is the previous output itself.
+param       arrSize, infileName, outfileName, opts, op, overflow -- as for runScan
+*/
+template<class T, class Op>
+void runAppend(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    BinaryType type = BinaryTypeOf<T>::value;
+    Arrays<T> arrays;
+    arrays.inArray = NULL;
+    arrays.outArray = NULL;
+    arrays.sharedOut = (opts.policy.backend == PROCESS_BACKEND);
+    arrays.inMap.base = NULL;
+    arrays.outMap.base = NULL;
+    arrays.overflow = overflow;
+    arrays.heads = NULL;
+
+    /* The values scanned before and their running total */
+    size_t done = 0;
+    T carry = T();
+    if(readPrevious(opts.appendFile, opts.outFormat, &done, &carry) < 0 || done > arrSize) {
+        if(done > arrSize) { errno = EINVAL; }
+        fail(&arrays, "Invalid previous output file.");
+    }
+    size_t added = arrSize - done;
+
+    arrays.outArray = (T*)allocateMemory(arrays.sharedOut, sizeof(T)*(added > 0 ? added : 1));
+    if(arrays.outArray == NULL) {
+        fail(&arrays, "Error creating shared memory segment.");
+    }
+
+    /* Read the appended values. A binary file is read from the first of them, text has to be parsed up to them. */
+    TraceMark mark;
+    startPhase(opts, &mark);
+    const T* appended;
+    if(opts.inFormat == BINARY_FORMAT && !opts.mapFiles) {
+        arrays.inArray = (T*)allocateMemory(false, sizeof(T)*(added > 0 ? added : 1));
+        if(arrays.inArray == NULL) {
+            fail(&arrays, "Error creating shared memory segment.");
+        }
+        long long count = readBinaryRange(infileName, type, sizeof(T), arrays.inArray, done, added);
+        if(count < 0 || count < (long long)added - 1) {
+            fail(&arrays, "Invalid input file.");
+        }
+        if(count < (long long)added) { arrays.inArray[added - 1] = T(); } // A missing last value counts as zero
+        appended = arrays.inArray;
+    }
+    else {
+        readInput(arrSize, infileName, opts, &arrays);
+        appended = arrays.inArray + done;
+    }
+    endPhase(opts, "read", &mark);
+
+    /* Compute the prefix sum of the appended values */
+    startPhase(opts, &mark);
+    int scanned;
+    if(done > 0) { scanned = appendScan(appended, arrays.outArray, added, carry, op, opts.policy); }
+    else { scanned = inclusive_scan(appended, arrays.outArray, added, op, opts.policy); }
+    if(scanned < 0) {
+        fail(&arrays, "Unable to run the scan.");
+    }
+    endPhase(opts, "scan", &mark);
+    if(overflow != NULL && *overflow) {
+        errno = ERANGE;
+        fail(&arrays, "The prefix sum overflows the element type.");
+    }
+
+    /* Extend the previous output with the new results */
+    startPhase(opts, &mark);
+    if(outfileName != opts.appendFile && copyFile(opts.appendFile, outfileName) < 0) {
+        fail(&arrays, "Unable to open the output file.");
+    }
+    int written;
+    if(opts.outFormat == BINARY_FORMAT) { written = writeBinaryRange(outfileName, type, sizeof(T), arrays.outArray, done, added, arrSize); }
+    else {
+        int fd = open(outfileName.c_str(), O_RDWR | O_APPEND);
+        written = (fd < 0) ? -1 : 0;
+
+        // The new lines start on a line of their own
+        off_t size = (fd < 0) ? 0 : lseek(fd, 0, SEEK_END);
+        char last = '\n';
+        if(size > 0 && (pread(fd, &last, 1, size - 1) != 1 || (last != '\n' && write(fd, "\n", 1) != 1))) { written = -1; }
+        if(written == 0) { written = writeTextArray(fd, arrays.outArray, added, opts.policy); }
+        if(fd >= 0 && close(fd) < 0) { written = -1; }
+    }
+    if(written < 0) {
+        fail(&arrays, "Unable to write the output file.");
+    }
+    endPhase(opts, "write", &mark);
+
+    releaseArrays(&arrays);
+}
+
+/*
+Read the input, compute the prefix sum and write the output for one element type and operator
+param       arrSize -- the number of elements
+            infileName -- path of the input file
+            outfileName -- path of the output file
+            opts -- the options
+            op -- the operator
+            overflow -- flag set by a checked operator from allocateMemory, or NULL. It is released here.
+*/
+template<class T, class Op>
+void runScan(size_t arrSize, string infileName, string outfileName, const Options& opts, Op op, int* overflow) {
+    if(opts.streamChunk > 0) {
+        runStream<T>(arrSize, infileName, outfileName, opts, op, overflow);
+        return;
+    }
+    if(!opts.appendFile.empty()) {
+        runAppend<T>(arrSize, infileName, outfileName, opts, op, overflow);
+        return;
+    }
+    if(opts.pipeline) {
+        runPipeline<T>(arrSize, infileName, outfileName, opts, op, overflow);
+        return;
+    }
+    if(opts.batch != NO_BATCH) {
+        runBatch<T>(arrSize, infileName, outfileName, opts, op, overflow);
+        return;
+    }
+
+    // The running total a scan continues from
+    T carry = T();
+    if(!opts.carry.empty() && decodeValue(opts.carry.data(), opts.carry.data() + opts.carry.size(), &carry) !=
+                              opts.carry.data() + opts.carry.size()) {
+        releaseMemory(opts.policy.backend == PROCESS_BACKEND, overflow);
+        errno = EINVAL;
+        errmsg("Invalid carry value.");
+    }
+
+    BinaryType type = BinaryTypeOf<T>::value;
+    Arrays<T> arrays;
+    arrays.inArray = NULL;
+    arrays.outArray = NULL;
+    arrays.sharedOut = (opts.policy.backend == PROCESS_BACKEND); // Forked workers write the output
+    arrays.inMap.base = NULL;
+    arrays.outMap.base = NULL;
+    arrays.overflow = overflow;
+    arrays.heads = NULL;
+
+    /* Create the output array. A mapped output file is shared with forked workers already. */
+    if(opts.mapFiles && opts.outFormat == BINARY_FORMAT) {
+        if(mapOutputArray(outfileName, type, sizeof(T), arrSize, &arrays.outMap) < 0) {
+            fail(&arrays, "Unable to open the output file.");
+        }
+        arrays.outArray = (T*)arrays.outMap.data;
+    }
+    else {
+        arrays.outArray = (T*)allocateMemory(arrays.sharedOut, sizeof(T)*arrSize);
+        if(arrays.outArray == NULL) {
+            fail(&arrays, "Error creating shared memory segment."); // Clean exit if unable to create the shared memory
+        }
+    }
+    // Place every block on the node of its pinned worker before the parent fills the array in
+    if(opts.policy.affinity != AFFINITY_NONE && touchBlocks(arrays.outArray, arrSize, opts.policy) < 0) {
+        fail(&arrays, "Unable to run the scan.");
+    }
+
+    TraceMark mark;
+    startPhase(opts, &mark);
+    readInput(arrSize, infileName, opts, &arrays);
+    endPhase(opts, "read", &mark);
+
+    /* Read the segments of a segmented scan */
+    if(!opts.segmentFile.empty()) {
+        startPhase(opts, &mark);
+        arrays.heads = (unsigned char*)allocateMemory(false, arrSize);
+        if(arrays.heads == NULL) {
+            fail(&arrays, "Error creating shared memory segment.");
+        }
+        if(readSegmentHeads(opts.segmentFile, opts.segmentOffsets, arrays.heads, arrSize, opts.policy) < 0) {
+            fail(&arrays, "Invalid segment file.");
+        }
+        endPhase(opts, "segments", &mark);
+    }
+
+    /* Compute the prefix sum, of every segment for a segmented scan */
+    startPhase(opts, &mark);
+    int scanned;
+    if(arrays.heads != NULL) { scanned = segmentedScan(arrays.inArray, arrays.heads, arrays.outArray, arrSize, op, opts.policy); }
+    else if(!opts.carry.empty()) { scanned = appendScan((const T*)arrays.inArray, arrays.outArray, arrSize, carry, op, opts.policy); }
+    else { scanned = inclusive_scan(arrays.inArray, arrays.outArray, arrSize, op, opts.policy); }
+    if(scanned < 0) {
+        fail(&arrays, "Unable to run the scan.");
+    }
+    endPhase(opts, "scan", &mark);
+
+    // A checked scan that overflowed has no meaningful output
+    if(overflow != NULL && *overflow) {
+        errno = ERANGE;
+        fail(&arrays, "The prefix sum overflows the element type.");
+    }
+
+    // Write the result to the output file, a mapped output file is complete already
     // Clean exit if unable to open the output file
-    if(writeOutputArray(outfileName, outArray, arrSize) < 0) {
-        removeMemory(memID1, memID2, memID3, inArray, outArray, barrier);
-        errmsg("Unable to open the output file.");
+    startPhase(opts, &mark);
+    int written = 0;
+    if(arrays.outMap.base == NULL) { written = writeOutput(outfileName, arrays.outArray, arrSize, opts); }
+    if(written < 0) {
+        fail(&arrays, "Unable to open the output file.");
     }
+    endPhase(opts, "write", &mark);
 
     // Detach from shared memory and remove shared memory segment
-    removeMemory(memID1, memID2, memID3, inArray, outArray, barrier);
+    releaseArrays(&arrays);
+}
+
+/*
+Compute several scans of the input in one pass and write each to a file of its own, named after B and the operator, like
+B.max. The workers are always threads.
+param       arrSize, infileName, outfileName, opts -- as for runScan
+*/
+template<class T>
+void runFused(size_t arrSize, string infileName, string outfileName, const Options& opts) {
+    Arrays<T> arrays;
+    arrays.inArray = NULL;
+    arrays.outArray = NULL;
+    arrays.sharedOut = false;
+    arrays.inMap.base = NULL;
+    arrays.outMap.base = NULL;
+    arrays.overflow = NULL;
+    arrays.heads = NULL;
+
+    /* One output array per operator, together in one allocation */
+    int count = (int)opts.ops.size();
+    arrays.outArray = (T*)allocateMemory(false, sizeof(T)*arrSize*count);
+    if(arrays.outArray == NULL) {
+        fail(&arrays, "Error creating shared memory segment.");
+    }
+    vector<T*> outs(count);
+    vector<BuiltinOp> ops;
+    for(int i = 0 ; i < count ; i++) {
+        outs[i] = arrays.outArray + arrSize*i;
+        ops.push_back(BuiltinOp(opts.ops[i]));
+    }
+
+    TraceMark mark;
+    startPhase(opts, &mark);
+    readInput(arrSize, infileName, opts, &arrays);
+    endPhase(opts, "read", &mark);
+
+    /* Compute every scan */
+    startPhase(opts, &mark);
+    if(fusedScan((const T*)arrays.inArray, outs.data(), ops.data(), count, arrSize, opts.policy) < 0) {
+        fail(&arrays, "Unable to run the scan.");
+    }
+    endPhase(opts, "scan", &mark);
+
+    // Write each result to its own file
+    startPhase(opts, &mark);
+    for(int i = 0 ; i < count ; i++) {
+        string filename = outfileName + "." + OP_NAMES[opts.ops[i]];
+        int written = writeOutput(filename, outs[i], arrSize, opts);
+        if(written < 0) {
+            fail(&arrays, "Unable to open the output file.");
+        }
+    }
+    endPhase(opts, "write", &mark);
+
+    releaseArrays(&arrays);
+}
+
+/*
+Run the scan on a scan server. The input is read into a job buffer shared with the server, which scans it in place.
+param       arrSize, infileName, outfileName, opts -- as for runScan
+*/
+template<class T>
+void runRemote(size_t arrSize, string infileName, string outfileName, const Options& opts) {
+    BinaryType type = BinaryTypeOf<T>::value;
+    int fd;
+    T* buffer = (T*)createJobBuffer(sizeof(T)*arrSize, &fd);
+    if(buffer == NULL) {
+        errmsg("Error creating shared memory segment.");
+    }
+
+    /* Create the input array in the buffer */
+    TraceMark mark;
+    startPhase(opts, &mark);
+    long long count;
+    if(opts.inFormat == BINARY_FORMAT) { count = readBinaryArray(infileName, type, sizeof(T), buffer, arrSize); }
+    else {
+        count = parseTextArray(infileName, buffer, arrSize, opts.policy);
+        if(count < 0) { count = makeInputArray(infileName, buffer, arrSize); }
+    }
+    if(count < 0 || count < (long long)arrSize - 1) {
+        releaseJobBuffer(buffer, sizeof(T)*arrSize, fd);
+        errmsg("Invalid input file.");
+    }
+    if(count < (long long)arrSize) { buffer[arrSize - 1] = T(); } // A missing last value counts as zero
+    endPhase(opts, "read", &mark);
+
+    /* Let the server compute the scan */
+    startPhase(opts, &mark);
+    int server = connectScanServer(opts.server);
+    if(server < 0) {
+        int error = errno;
+        releaseJobBuffer(buffer, sizeof(T)*arrSize, fd);
+        errno = error;
+        errmsg("Unable to reach the scan server.");
+    }
+    int result = submitScan(server, fd, type, sizeof(T), opts.ops[0], arrSize);
+    int error = errno;
+    close(server);
+    if(result < 0) {
+        releaseJobBuffer(buffer, sizeof(T)*arrSize, fd);
+        errno = error;
+        errmsg("Unable to run the scan.");
+    }
+    endPhase(opts, "scan", &mark);
+
+    // Write the result to the output file
+    startPhase(opts, &mark);
+    int written = writeOutput(outfileName, buffer, arrSize, opts);
+    error = errno;
+    releaseJobBuffer(buffer, sizeof(T)*arrSize, fd);
+    if(written < 0) {
+        errno = error;
+        errmsg("Unable to open the output file.");
+    }
+    endPhase(opts, "write", &mark);
+}
+
+/*
+Apply changes of elements of A to a previous output, given as the input file, without A itself. The sums are kept in a
+Fenwick tree, so each change costs O(log N), and the new prefix sums are written as for a scan.
+param       arrSize, infileName, outfileName, opts -- as for runScan
+*/
+template<class T>
+void runUpdate(size_t arrSize, string infileName, string outfileName, const Options& opts) {
+    Arrays<T> arrays;
+    arrays.inArray = NULL;
+    arrays.outArray = NULL;
+    arrays.sharedOut = false;
+    arrays.inMap.base = NULL;
+    arrays.outMap.base = NULL;
+    arrays.overflow = NULL;
+    arrays.heads = NULL;
+
+    arrays.outArray = (T*)allocateMemory(false, sizeof(T)*arrSize);
+    if(arrays.outArray == NULL) {
+        fail(&arrays, "Error creating shared memory segment.");
+    }
+
+    /* Index the previous prefix sums */
+    TraceMark mark;
+    startPhase(opts, &mark);
+    readInput(arrSize, infileName, opts, &arrays);
+    FenwickTree<T> tree;
+    if(buildFenwickFromSums(&tree, (const T*)arrays.inArray, arrSize, opts.policy) < 0) {
+        fail(&arrays, "Error creating shared memory segment.");
+    }
+    endPhase(opts, "read", &mark);
+
+    /* Each line of the update file is the index of an element and its new value */
+    startPhase(opts, &mark);
+    ifstream in(opts.updateFile.c_str());
+    bool valid = in.is_open();
+    size_t index;
+    T value;
+    while(valid && in >> index >> value) {
+        if(index >= arrSize) { valid = false; }
+        else { fenwickSet(&tree, index, value); }
+    }
+    if(!valid || !in.eof()) {
+        releaseFenwick(&tree);
+        errno = EINVAL;
+        fail(&arrays, "Invalid update file.");
+    }
+    endPhase(opts, "update", &mark);
+
+    // Write the new prefix sums to the output file
+    startPhase(opts, &mark);
+    if(fenwickSums(tree, arrays.outArray, opts.policy) < 0) {
+        int error = errno;
+        releaseFenwick(&tree);
+        errno = error;
+        fail(&arrays, "Unable to run the scan.");
+    }
+    releaseFenwick(&tree);
+    int written = writeOutput(outfileName, arrays.outArray, arrSize, opts);
+    if(written < 0) {
+        fail(&arrays, "Unable to open the output file.");
+    }
+    endPhase(opts, "write", &mark);
+
+    releaseArrays(&arrays);
+}
+
+/*
+Select the operator, and for a sum the overflow mode, each combination is compiled separately
+param       arrSize, infileName, outfileName, opts -- as for runScan
+*/
+template<class T>
+void runType(size_t arrSize, string infileName, string outfileName, const Options& opts) {
+    if(!opts.server.empty()) {
+        runRemote<T>(arrSize, infileName, outfileName, opts);
+        return;
+    }
+    if(opts.ops.size() > 1) {
+        runFused<T>(arrSize, infileName, outfileName, opts);
+        return;
+    }
+    if(!opts.updateFile.empty()) {
+        // Updates and xor are rejected for floating point types by parseOptions
+        if constexpr(std::numeric_limits<T>::is_integer) { runUpdate<T>(arrSize, infileName, outfileName, opts); }
+        return;
+    }
+    switch(opts.ops[0]) {
+        case MAX_OP: runScan<T>(arrSize, infileName, outfileName, opts, Max(), NULL); return;
+        case MIN_OP: runScan<T>(arrSize, infileName, outfileName, opts, Min(), NULL); return;
+        case PRODUCT_OP: runScan<T>(arrSize, infileName, outfileName, opts, Multiplies(), NULL); return;
+        case XOR_OP:
+            if constexpr(std::numeric_limits<T>::is_integer) { runScan<T>(arrSize, infileName, outfileName, opts, BitXor(), NULL); }
+            return;
+        default: break;
+    }
+
+    if(opts.overflow == WRAP_OVERFLOW) {
+        runScan<T>(arrSize, infileName, outfileName, opts, Plus(), NULL);
+        return;
+    }
+    if(opts.overflow == SATURATE_OVERFLOW) {
+        // One work-efficient worker clamps every sum in order, as the clamped sums depend on their grouping
+        Options serial = opts;
+        serial.policy.engine = WORK_EFFICIENT;
+        serial.policy.workers = 1;
+        runScan<T>(arrSize, infileName, outfileName, serial, SaturatingPlus(), NULL);
+        return;
+    }
+
+    // The overflow flag is written by the workers
+    bool shared = (opts.policy.backend == PROCESS_BACKEND);
+    int* overflow = (int*)allocateMemory(shared, sizeof(int));
+    if(overflow == NULL) {
+        errmsg("Error creating shared memory segment.");
+    }
+    *overflow = 0;
+    runScan<T>(arrSize, infileName, outfileName, opts, CheckedPlus(overflow), overflow); // Releases the flag
+}
+
+/* Start of main */
+int main(int argc, char* argv[]) {
+    // Check the number of arguments and values for N and M are valid
+    if(verifyArgs(argc, argv) < 0) {
+        errmsg("Invalid arguments provided."); // clean exit
+    }
+
+    /* Assign the input args */
+    size_t arrSize = strtoull(argv[1], NULL, 10);
+    int numProcesses = atoi(argv[2]);
+    string infileName = argv[3];
+    string outfileName = argv[4];
+
+    /* Assign the optional args */
+    Options opts;
+    if(parseOptions(argc, argv, &opts) < 0) {
+        errmsg("Invalid option provided."); // clean exit
+    }
+    opts.policy.workers = numProcesses;
+
+    // A batch is many small scans, not one of N, so with M auto it keeps a worker on every core
+    if(string(argv[2]) == "auto" && opts.batch != NO_BATCH) {
+        opts.policy.workers = ExecPolicy().workers;
+        numProcesses = opts.policy.workers;
+    }
+    // With M auto the backend and the workers are chosen from the size of a scan and the calibration profile
+    else if(string(argv[2]) == "auto") {
+        TuneProfile profile;
+        if(tuneProfile(opts.profile, opts.calibrate, &profile) < 0) {
+            errmsg("Unable to calibrate the scan.");
+        }
+        size_t elementSize = (opts.type == INT32_TYPE || opts.type == FLOAT_TYPE) ? 4 : 8;
+        size_t scanned = (opts.streamChunk > 0 && opts.streamChunk < arrSize) ? opts.streamChunk : arrSize;
+        ExecPolicy tuned = opts.policy;
+        autoPolicy(profile, scanned, elementSize, &tuned);
+        if(opts.backendSet) { tuned.workers = autoWorkers(profile, scanned, elementSize, opts.policy.backend); }
+        else { opts.policy.backend = tuned.backend; }
+        if(!opts.engineSet) { opts.policy.engine = tuned.engine; }
+        opts.policy.workers = tuned.workers;
+        numProcesses = tuned.workers;
+    }
+    // The arrays share one pool of threads instead of the default process backend, an explicit one is rejected by parseOptions
+    if(opts.batch != NO_BATCH) { opts.policy.backend = THREAD_BACKEND; }
+
+    // The trace is shared with forked workers, which write their own spans into it
+    Trace trace;
+    if(opts.stats || !opts.traceFile.empty()) {
+        if(createTrace(&trace, numProcesses, opts.counters, opts.policy.backend == PROCESS_BACKEND) < 0) {
+            errmsg("Error creating shared memory segment.");
+        }
+        opts.policy.trace = &trace;
+    }
+
+    switch(opts.type) {
+        case INT32_TYPE: runType<int32_t>(arrSize, infileName, outfileName, opts); break;
+        case INT64_TYPE: runType<int64_t>(arrSize, infileName, outfileName, opts); break;
+        case UINT64_TYPE: runType<uint64_t>(arrSize, infileName, outfileName, opts); break;
+        case FLOAT_TYPE: runType<float>(arrSize, infileName, outfileName, opts); break;
+        case DOUBLE_TYPE: runType<double>(arrSize, infileName, outfileName, opts); break;
+    }
+
+    if(opts.policy.trace != NULL) {
+        if(opts.stats) { writeTraceReport(&trace, stderr); }
+        if(!opts.traceFile.empty() && writeChromeTrace(&trace, opts.traceFile) < 0) {
+            releaseTrace(&trace);
+            errmsg("Unable to write the trace file.");
+        }
+        releaseTrace(&trace);
+    }
 
     return 0;
 }
@@ -0,0 +1,195 @@
+/*
+
+Pipelined scans of text: parsing, scanning and formatting fused into one pass, for text in and text out. Reading the input
+into an array, scanning it and formatting the result each go over all of memory, N elements several times over. Here the
+text is taken in rounds, and in a round every worker
+
+    parses its piece of the text and scans the values as they are decoded, into a buffer of its own that stays in cache
+    publishes the total of its piece, and the totals are scanned into one offset per piece
+    formats its values with its offset folded in, into a text buffer of its own
+
+and the text buffers of the round go to the file with a single writev. The input is read once and the output written
+once, and neither the values nor the text of more than a round is ever in memory.
+
+Reading stops at N values or at the first value that cannot be decoded, as parseTextBuffer does. The workers are always
+threads, and the engines of the policy are not used.
+
+*/
+
+#ifndef PIPELINE_SCAN_H
+#define PIPELINE_SCAN_H
+
+#include <charconv>
+#include <cstddef>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+#include "exec-policy.h"
+#include "scan-engine.h"
+#include "text-io.h"
+
+namespace psum {
+
+/* Bytes of text every worker parses in a round, small enough that its values stay in the L2 cache */
+const size_t PIPELINE_CHUNK = 1 << 18;
+
+/*
+Inclusive scan of the values of a piece of text, written as text to an open file
+param       text -- the text, values separated by whitespace
+            length -- the number of bytes
+            fd -- the file descriptor of the output
+            N -- the maximum number of values to be scanned
+            op -- the associative operator
+            policy -- the number of workers, they always run as threads
+            total -- Pointer receiving the last value written, if any
+return      the number of values scanned and written, or -1 if the output could not be written
+*/
+template<class T, class Op>
+long long pipelineScan(const char* text, size_t length, int fd, size_t N, Op op, const ExecPolicy& policy, T* total) {
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    const size_t maxLength = 48; // Enough for any integer or shortest round-trip float, and the newline
+
+    std::vector<std::vector<T> > values(workers);
+    std::vector<std::vector<char> > buffers(workers);
+    std::vector<size_t> counts(workers);
+    std::vector<char> stopped(workers);
+    std::vector<size_t> lengths(workers);
+    std::vector<T> offsets(workers);
+    std::vector<char> hasOffset(workers);
+    std::vector<size_t> bounds;
+    std::vector<struct iovec> pieces;
+
+    size_t done = 0;
+    T carry = T();
+    bool end = false;
+    for(size_t roundStart = 0 ; roundStart < length && done < N && !end ; ) {
+        // A round ends at whitespace, so that no value is cut in two
+        size_t roundEnd = roundStart + PIPELINE_CHUNK*workers;
+        if(roundEnd >= length) { roundEnd = length; }
+        while(roundEnd < length && !isSpace(text[roundEnd])) { roundEnd++; }
+        const char* round = text + roundStart;
+        splitText(round, roundEnd - roundStart, workers, &bounds);
+
+        /* Parse and scan every piece, the running value of a piece is its total */
+        int started = runWorkers(threads, workers, [&](int j) {
+            const char* p = round + bounds[j];
+            const char* pieceEnd = round + bounds[j + 1];
+            std::vector<T>& scanned = values[j];
+            size_t capacity = (pieceEnd - p) / 2 + 1; // Every value is followed by whitespace but the last
+            if(scanned.size() < capacity) { scanned.resize(capacity); }
+
+            size_t k = 0;
+            bool bad = false;
+            while(true) {
+                while(p < pieceEnd && isSpace(*p)) { p++; }
+                if(p == pieceEnd) { break; }
+                const char* valueEnd = p;
+                while(valueEnd < pieceEnd && !isSpace(*valueEnd)) { valueEnd++; }
+
+                T value;
+                const char* next = decodeValue(p, valueEnd, &value);
+                if(next == NULL) { // Not a value, reading stops here
+                    bad = true;
+                    break;
+                }
+                scanned[k] = (k == 0) ? value : op(scanned[k - 1], value);
+                k++;
+                p = next;
+                if(next != valueEnd) { // Trailing garbage, ifstream >> would stop after this value
+                    bad = true;
+                    break;
+                }
+            }
+            counts[j] = k;
+            stopped[j] = bad;
+        });
+        if(started < 0) { return -1; }
+
+        /* The offset of every piece, up to N values and the first piece that stopped early */
+        int used = 0;
+        for(int j = 0 ; j < workers && done < N ; j++) {
+            if(counts[j] > N - done) { counts[j] = N - done; }
+            offsets[j] = carry;
+            hasOffset[j] = (done > 0);
+            if(counts[j] > 0) {
+                T last = values[j][counts[j] - 1];
+                carry = hasOffset[j] ? op(carry, last) : last;
+            }
+            done += counts[j];
+            used = j + 1;
+            if(stopped[j]) {
+                end = true;
+                break;
+            }
+        }
+
+        /* Format every piece with its offset */
+        if(used > 0) {
+            started = runWorkers(threads, used, [&](int j) {
+                std::vector<char>& buffer = buffers[j];
+                if(buffer.size() < counts[j]*maxLength) { buffer.resize(counts[j]*maxLength); }
+                char* p = buffer.data();
+                const T* scanned = values[j].data();
+                for(size_t k = 0 ; k < counts[j] ; k++) {
+                    T value = hasOffset[j] ? op(offsets[j], scanned[k]) : scanned[k];
+                    p = std::to_chars(p, p + maxLength, value).ptr;
+                    *p++ = '\n';
+                }
+                lengths[j] = p - buffer.data();
+            });
+            if(started < 0) { return -1; }
+        }
+
+        pieces.resize(used);
+        for(int j = 0 ; j < used ; j++) {
+            pieces[j].iov_base = buffers[j].data();
+            pieces[j].iov_len = lengths[j];
+        }
+        if(writeBuffers(fd, &pieces) < 0) { return -1; }
+        roundStart = roundEnd;
+    }
+
+    if(done > 0) { *total = carry; }
+    return (long long)done;
+}
+
+/*
+Inclusive scan of a text file into a text file in one pass
+param       infile -- path of the input, a regular file so that it can be mapped
+            outfile -- path of the output, replaced if it exists
+            N -- the maximum number of values to be scanned
+            op -- the associative operator
+            policy -- the number of workers, they always run as threads
+return      the number of values scanned and written, or -1 if the input cannot be mapped or the output written
+*/
+template<class T, class Op>
+long long pipelineScanFile(std::string infile, std::string outfile, size_t N, Op op, const ExecPolicy& policy) {
+    TextFile file;
+    if(mapTextFile(infile, &file) < 0) { return -1; }
+    int fd = openTextOutput(outfile);
+    if(fd < 0) {
+        int error = errno;
+        unmapTextFile(&file);
+        errno = error;
+        return -1;
+    }
+
+    T total;
+    long long count = file.base == NULL ? 0 : pipelineScan((const char*)file.base, file.length, fd, N, op, policy, &total);
+    int error = errno;
+    unmapTextFile(&file);
+    if(closeTextOutput(fd) < 0 && count >= 0) {
+        count = -1;
+        error = errno;
+    }
+    errno = error;
+    return count;
+}
+
+} // namespace psum
+
+#endif
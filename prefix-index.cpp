@@ -0,0 +1,208 @@
+/*
+
+Implementation of the prefix index files declared in prefix-index.h
+
+*/
+
+#include "prefix-index.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace psum {
+
+// The values are stored as they are in memory, which is only the file's byte order on little-endian hosts
+static const bool NATIVE_LITTLE_ENDIAN = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+
+int createIndexFile(string filename, const IndexHeader& header, size_t length, IndexWriter* writer) {
+    writer->base = NULL;
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) { return -1; }
+    if(ftruncate(fd, length) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    void* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) { return -1; }
+
+    memcpy(base, &header, sizeof(header));
+    writer->base = base;
+    writer->length = length;
+    writer->directory = (IndexBlock*)((char*)base + header.directory);
+    writer->data = (unsigned char*)base + header.data;
+    return 0;
+}
+
+int finishIndexFile(IndexWriter* writer) {
+    if(writer->base == NULL) { return 0; }
+    int result = munmap(writer->base, writer->length); // The pages go to the file like those of a mapped output array
+    writer->base = NULL;
+    return result;
+}
+
+/*
+Check that the header of an index agrees with the size of the file
+param       header -- the header
+            length -- the size of the file
+return      true if every part the header describes lies inside the file
+*/
+static bool validIndex(const IndexHeader* header, size_t length) {
+    if(memcmp(header->magic, "PSIX", 4) != 0 || header->version != 1 || header->data > length || header->data % 8 != 0) { return false; }
+    if(header->elementSize != 4 && header->elementSize != 8) { return false; }
+    size_t dataLength = length - header->data;
+    if(header->layout == INDEX_PLAIN) { return header->count <= dataLength / header->elementSize; }
+    if((header->layout != INDEX_PACKED && header->layout != INDEX_COMPRESSED) || header->blockSize == 0) { return false; }
+
+    // Every block needs an entry, the entries are checked when a query reads them
+    uint64_t blocks = header->count / header->blockSize + (header->count % header->blockSize != 0);
+    return header->blocks == blocks && header->directory >= sizeof(IndexHeader) && header->directory <= header->data &&
+           blocks <= (header->data - header->directory) / sizeof(IndexBlock);
+}
+
+int openPrefixIndex(string filename, PrefixIndex* index) {
+    index->base = NULL;
+    if(!NATIVE_LITTLE_ENDIAN) { errno = ENOTSUP; return -1; }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) { return -1; }
+    struct stat status;
+    if(fstat(fd, &status) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    size_t length = status.st_size;
+    if(length < sizeof(IndexHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void* base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) { return -1; }
+    madvise(base, length, MADV_RANDOM); // A query reads a few values, reading ahead around them is wasted
+
+    const IndexHeader* header = (const IndexHeader*)base;
+    if(!validIndex(header, length)) {
+        munmap(base, length);
+        errno = EINVAL;
+        return -1;
+    }
+    index->base = base;
+    index->length = length;
+    index->header = header;
+    index->directory = (const IndexBlock*)((const char*)base + header->directory);
+    index->data = (const unsigned char*)base + header->data;
+    index->dataLength = length - header->data;
+    return 0;
+}
+
+void closePrefixIndex(PrefixIndex* index) {
+    if(index->base == NULL) { return; }
+    munmap(index->base, index->length);
+    index->base = NULL;
+}
+
+/*
+Get the number of words of an Elias-Fano block
+param       values -- the number of values
+            range -- the largest difference from the first value
+            low -- the low bits per value
+return      the words of the low bits and of the upper bit vector
+*/
+static size_t eliasFanoWords(size_t values, uint64_t range, uint32_t low) {
+    uint64_t upperBits = values + (low >= 64 ? 0 : range >> low);
+    return packedWords(values, low) + (upperBits + 63) / 64;
+}
+
+size_t planBlock(IndexBlock* entry, size_t values, uint64_t range, bool sorted, IndexLayout layout) {
+    entry->encoding = BLOCK_PACKED;
+    entry->bits = bitWidth(range);
+    size_t words = packedWords(values, entry->bits);
+    if(layout == INDEX_COMPRESSED && sorted) {
+        // About log2(range / values) low bits leave about 2 upper bits per value
+        uint64_t spacing = range / values;
+        uint32_t low = spacing == 0 ? 0 : bitWidth(spacing) - 1;
+        size_t fanoWords = eliasFanoWords(values, range, low);
+        if(fanoWords < words) {
+            entry->encoding = BLOCK_ELIAS_FANO;
+            entry->bits = low;
+            words = fanoWords;
+        }
+    }
+    return words*8;
+}
+
+/*
+Find a set bit of a bit vector
+param       words -- the bit vector
+            count -- the number of its words
+            k -- the number of set bits before the one wanted
+            position -- Pointer receiving the position of the bit
+return      true if it was found
+*/
+static bool selectBit(const uint64_t* words, size_t count, size_t k, uint64_t* position) {
+    for(size_t w = 0 ; w < count ; w++) {
+        uint64_t word = words[w];
+        size_t ones = __builtin_popcountll(word);
+        if(k >= ones) {
+            k -= ones;
+            continue;
+        }
+        for( ; k > 0 ; k--) { word &= word - 1; }
+        *position = (uint64_t)w*64 + __builtin_ctzll(word);
+        return true;
+    }
+    return false;
+}
+
+int blockValue(const PrefixIndex& index, size_t i, uint64_t* value) {
+    const IndexHeader* header = index.header;
+    size_t block = i / header->blockSize;
+    size_t k = i - block*header->blockSize;
+    size_t values = block + 1 < header->blocks ? header->blockSize : header->count - block*header->blockSize;
+    const IndexBlock& entry = index.directory[block];
+    uint64_t end = block + 1 < header->blocks ? index.directory[block + 1].offset : index.dataLength;
+    if(entry.bits > 64 || entry.offset % 8 != 0 || end % 8 != 0 || entry.offset > end || end > index.dataLength) {
+        errno = EINVAL;
+        return -1;
+    }
+    const uint64_t* words = (const uint64_t*)(index.data + entry.offset);
+    size_t count = (end - entry.offset) / 8;
+    uint32_t bits = entry.bits;
+
+    if(entry.encoding == BLOCK_PACKED) {
+        if(packedWords(values, bits) > count) {
+            errno = EINVAL;
+            return -1;
+        }
+        *value = entry.base + (bits == 0 ? 0 : readBits(words, (uint64_t)k*bits, bits));
+        return 0;
+    }
+
+    // Elias-Fano: the k-th set bit of the upper vector is at its high bits plus k
+    size_t lowWords = packedWords(values, bits);
+    uint64_t position;
+    if(entry.encoding != BLOCK_ELIAS_FANO || lowWords > count || !selectBit(words + lowWords, count - lowWords, k, &position)) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t high = position - k;
+    uint64_t delta = bits == 0 ? high : (bits == 64 ? 0 : high << bits) | readBits(words, (uint64_t)k*bits, bits);
+    *value = entry.base + delta;
+    return 0;
+}
+
+} // namespace psum
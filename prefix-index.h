@@ -0,0 +1,381 @@
+/*
+
+Prefix index files: the output B of a prefix sum stored so that a range sum sum(A[l..r]) = B[r] - B[l-1] is answered from
+the file in O(1), without parsing it. A query maps the file and reads only the pages of the values it needs.
+
+    header          64 bytes: "PSIX", version, element type and size, count, layout, block size, offsets
+    directory       packed and compressed layouts, one entry per block: offset of its data, its base and its encoding
+    data            at a multiple of 64 bytes
+
+The plain layout stores the values as they are, little-endian. The other layouts split them into blocks, and are for
+integer types only. The packed layout stores every value of a block as its difference from the smallest one, in as many
+bits as the largest difference needs. A value is then the base of its block plus a bit field at a position computed from
+its index, still O(1).
+
+The compressed layout is for the non-decreasing prefix sums of non-negative inputs. A block that never decreases is stored
+with Elias-Fano coding instead when that is smaller: of the differences x from the first value, the low l bits are packed
+as above, with l about log2(range / values), and the rest of each x is written in unary as one bit set at position
+(x >> l) + k of an upper bit vector, for the k-th value. That takes under 2 + l bits per value however large the range,
+close to the least any coding of a sorted sequence needs. A value is found by selecting the k-th set bit of its block's
+upper vector, a few popcounts for a block of 1024 values. Blocks that decrease somewhere are packed.
+
+The index is written by the workers in parallel, each encoding its own blocks into the mapped file.
+
+*/
+
+#ifndef PREFIX_INDEX_H
+#define PREFIX_INDEX_H
+
+#include <cstddef>
+#include <cstring>
+#include <errno.h>
+#include <limits>
+#include <stdint.h>
+#include <string>
+
+#include "binary-io.h"
+#include "exec-policy.h"
+#include "scan-engine.h"
+
+namespace psum {
+
+/* How the values of an index are stored */
+enum IndexLayout { INDEX_PLAIN = 1, INDEX_PACKED = 2, INDEX_COMPRESSED = 3 };
+
+/* How the values of one block are stored */
+enum BlockEncoding { BLOCK_PACKED = 0, BLOCK_ELIAS_FANO = 1 };
+
+/* Values per block of a packed or compressed index unless given */
+const size_t INDEX_BLOCK = 1024;
+
+/* Header at the start of an index file */
+struct IndexHeader {
+    char magic[4];          // "PSIX"
+    uint32_t version;       // 1
+    uint32_t type;          // BinaryType of the values
+    uint32_t elementSize;
+    uint64_t count;         // number of values
+    uint32_t layout;        // IndexLayout
+    uint32_t blockSize;     // values per block of the packed and compressed layouts
+    uint64_t blocks;        // entries of the directory, 0 for the plain layout
+    uint64_t directory;     // file offset of the directory
+    uint64_t data;          // file offset of the data
+    uint8_t reserved[8];
+};
+
+/* Directory entry of a block, its data ends where the data of the next block starts */
+struct IndexBlock {
+    uint64_t offset;        // offset of the block's data from the start of the data, a multiple of 8
+    uint64_t base;          // smallest value of the block, as the bits of a 64-bit integer
+    uint32_t bits;          // bits per packed value, or low bits per Elias-Fano value, 0 to 64
+    uint32_t encoding;      // BlockEncoding
+};
+
+/* An index file mapped for queries */
+struct PrefixIndex {
+    void* base;             // the mapping, NULL if not open
+    size_t length;
+    const IndexHeader* header;
+    const IndexBlock* directory;
+    const unsigned char* data;
+    size_t dataLength;      // bytes from the data offset to the end of the file
+};
+
+/* An index file mapped for writing */
+struct IndexWriter {
+    void* base;
+    size_t length;
+    IndexBlock* directory;
+    unsigned char* data;
+};
+
+/*
+Create an index file of the given size and map it, the header is filled in
+param       filename -- path of the file, replaced if it exists
+            header -- the header, including the offsets
+            length -- the size of the file in bytes
+            writer -- Pointer to the mapping to be filled in
+return      0 if successful, or -1 if the file cannot be created or mapped
+*/
+int createIndexFile(std::string filename, const IndexHeader& header, size_t length, IndexWriter* writer);
+
+/*
+Unmap an index file mapped by createIndexFile, the kernel writes it back
+param       writer -- Pointer to the mapping
+return      0 if successful, or -1 if the file could not be written
+*/
+int finishIndexFile(IndexWriter* writer);
+
+/*
+Map an index file for queries. Pages are only read when a query touches them.
+param       filename -- path of the file
+            index -- Pointer to the index to be filled in
+return      0 if successful, or -1 if the file cannot be mapped, with errno EINVAL if it is not a valid index
+*/
+int openPrefixIndex(std::string filename, PrefixIndex* index);
+
+/*
+Unmap an index from openPrefixIndex
+param       index -- Pointer to the index
+*/
+void closePrefixIndex(PrefixIndex* index);
+
+/*
+Choose the encoding and bits per value of a block
+param       entry -- Pointer to the directory entry, its base is set already
+            values -- the number of values of the block
+            range -- the largest difference from the base
+            sorted -- true if the block never decreases
+            layout -- INDEX_PACKED, or INDEX_COMPRESSED to use Elias-Fano coding where it is smaller
+return      the size of the block's data in bytes, a multiple of 8
+*/
+size_t planBlock(IndexBlock* entry, size_t values, uint64_t range, bool sorted, IndexLayout layout);
+
+/*
+Decode one value of a packed or compressed index
+param       index -- the index
+            i -- the index of the value, less than the count
+            value -- Pointer receiving the bits of the value as a 64-bit integer
+return      0 if successful, or -1 with errno EINVAL if its block is not valid
+*/
+int blockValue(const PrefixIndex& index, size_t i, uint64_t* value);
+
+/*
+Get the number of bits a packed value needs
+param       range -- the largest value
+return      the number of bits, 0 for a range of 0
+*/
+inline uint32_t bitWidth(uint64_t range) {
+    return range == 0 ? 0 : 64 - (uint32_t)__builtin_clzll(range);
+}
+
+/*
+Get the number of words holding packed values
+param       values -- the number of values
+            bits -- the bits per value
+return      the number of 64-bit words
+*/
+inline size_t packedWords(size_t values, uint32_t bits) {
+    return ((uint64_t)values*bits + 63) / 64;
+}
+
+/*
+Read a bit field of a packed block
+param       words -- the words of the block
+            position -- the bit position of the field
+            bits -- the width of the field, 1 to 64
+return      the field
+*/
+inline uint64_t readBits(const uint64_t* words, uint64_t position, uint32_t bits) {
+    size_t word = position >> 6;
+    uint32_t shift = position & 63;
+    uint64_t value = words[word] >> shift;
+    if(shift + bits > 64) { value |= words[word + 1] << (64 - shift); }
+    return bits == 64 ? value : value & (((uint64_t)1 << bits) - 1);
+}
+
+/*
+Write a bit field into zeroed words
+param       words -- the words of the block
+            position -- the bit position of the field
+            bits -- the width of the field, 1 to 64
+            value -- the field, less than 2^bits
+*/
+inline void writeBits(uint64_t* words, uint64_t position, uint32_t bits, uint64_t value) {
+    uint32_t shift = position & 63;
+    words[position >> 6] |= value << shift;
+    if(shift + bits > 64) { words[(position >> 6) + 1] |= value >> (64 - shift); }
+}
+
+/*
+Encode one value into the zeroed data of its block
+param       words -- the data of the block
+            entry -- the directory entry of the block
+            values -- the number of values of the block
+            k -- the number of the value within the block
+            delta -- the value minus the base
+*/
+inline void encodeValue(uint64_t* words, const IndexBlock& entry, size_t values, size_t k, uint64_t delta) {
+    uint32_t bits = entry.bits;
+    if(entry.encoding == BLOCK_PACKED) {
+        if(bits > 0) { writeBits(words, (uint64_t)k*bits, bits, delta); }
+        return;
+    }
+    // Elias-Fano: the low bits packed, then the high bits in unary after them
+    if(bits > 0) { writeBits(words, (uint64_t)k*bits, bits, bits == 64 ? delta : delta & (((uint64_t)1 << bits) - 1)); }
+    uint64_t* upper = words + packedWords(values, bits);
+    uint64_t position = (bits == 64 ? 0 : delta >> bits) + k;
+    upper[position >> 6] |= (uint64_t)1 << (position & 63);
+}
+
+/*
+Write an array of prefix sums to a prefix index file
+param       filename -- path of the file to be written
+            sums -- the values, usually inclusive prefix sums
+            n -- the number of values
+            layout -- INDEX_PLAIN, or INDEX_PACKED or INDEX_COMPRESSED for integer types
+            blockSize -- values per block of the packed and compressed layouts, 0 for INDEX_BLOCK
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if the file cannot be written, with errno EINVAL for blocks of floating point values
+*/
+template<class T>
+int writePrefixIndex(std::string filename, const T* sums, size_t n, IndexLayout layout, size_t blockSize, const ExecPolicy& policy) {
+    if(blockSize == 0) { blockSize = INDEX_BLOCK; }
+    bool blocked = (layout != INDEX_PLAIN);
+    if((blocked && !std::numeric_limits<T>::is_integer) || blockSize > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "PSIX", 4);
+    header.version = 1;
+    header.type = BinaryTypeOf<T>::value;
+    header.elementSize = sizeof(T);
+    header.count = n;
+    header.layout = layout;
+    header.blockSize = (uint32_t)blockSize;
+    header.blocks = blocked ? (n + blockSize - 1) / blockSize : 0;
+    header.directory = sizeof(IndexHeader);
+    header.data = (sizeof(IndexHeader) + header.blocks*sizeof(IndexBlock) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+
+    size_t blocks = header.blocks;
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    size_t units = blocked ? blocks : n;
+    if((size_t)workers > units) { workers = units > 0 ? (int)units : 1; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+
+    /* The base and encoding of every block, then the offsets of their data */
+    IndexBlock* entries = NULL;
+    size_t dataLength = sizeof(T)*n;
+    if(blocked) {
+        entries = (IndexBlock*)allocateMemory(false, sizeof(IndexBlock)*(blocks > 0 ? blocks : 1));
+        if(entries == NULL) { return -1; }
+        int result = runWorkers(threads, workers, [=](int j) {
+            size_t first, last;
+            getChunkRange(j, workers, blocks, &first, &last);
+            for(size_t b = first ; b < last ; b++) {
+                size_t start = b*blockSize;
+                size_t end = start + blockSize < n ? start + blockSize : n;
+                T low = sums[start], high = sums[start];
+                bool sorted = true;
+                for(size_t k = start + 1 ; k < end ; k++) {
+                    if(sums[k] < low) { low = sums[k]; }
+                    if(sums[k] > high) { high = sums[k]; }
+                    sorted &= !(sums[k] < sums[k - 1]);
+                }
+                entries[b].base = (uint64_t)low;
+                entries[b].offset = planBlock(&entries[b], end - start, (uint64_t)high - (uint64_t)low, sorted, layout);
+            }
+        });
+        if(result < 0) {
+            releaseMemory(false, entries);
+            return -1;
+        }
+        dataLength = 0;
+        for(size_t b = 0 ; b < blocks ; b++) {
+            size_t size = entries[b].offset; // The size of the block until now
+            entries[b].offset = dataLength;
+            dataLength += size;
+        }
+    }
+
+    IndexWriter writer;
+    if(createIndexFile(filename, header, header.data + dataLength, &writer) < 0) {
+        int error = errno;
+        releaseMemory(false, entries);
+        errno = error;
+        return -1;
+    }
+
+    /* Every worker writes its own part of the data, the file is zero so fields are or-ed in */
+    int result;
+    unsigned char* data = writer.data;
+    if(!blocked) {
+        result = runWorkers(threads, workers, [=](int j) {
+            size_t start, end;
+            getChunkRange(j, workers, n, &start, &end);
+            memcpy(data + start*sizeof(T), sums + start, (end - start)*sizeof(T));
+        });
+    }
+    else {
+        memcpy(writer.directory, entries, sizeof(IndexBlock)*blocks);
+        result = runWorkers(threads, workers, [=](int j) {
+            size_t first, last;
+            getChunkRange(j, workers, blocks, &first, &last);
+            for(size_t b = first ; b < last ; b++) {
+                const IndexBlock& entry = entries[b];
+                if(entry.encoding == BLOCK_PACKED && entry.bits == 0) { continue; }
+                uint64_t* words = (uint64_t*)(data + entry.offset);
+                size_t start = b*blockSize;
+                size_t end = start + blockSize < n ? start + blockSize : n;
+                for(size_t k = start ; k < end ; k++) {
+                    encodeValue(words, entry, end - start, k - start, (uint64_t)sums[k] - entry.base);
+                }
+            }
+        });
+    }
+    int error = errno;
+    releaseMemory(false, entries);
+    if(finishIndexFile(&writer) < 0 && result == 0) {
+        result = -1;
+        error = errno;
+    }
+    errno = error;
+    return result;
+}
+
+/*
+Look up one value of an index
+param       index -- the index, of values of type T
+            i -- the index of the value
+            value -- Pointer receiving the value
+return      0 if successful, or -1 with errno EINVAL if i is out of range, T is not the type of the index or the file is
+            not valid
+*/
+template<class T>
+int indexValue(const PrefixIndex& index, size_t i, T* value) {
+    const IndexHeader* header = index.header;
+    if(header->type != (uint32_t)BinaryTypeOf<T>::value || header->elementSize != sizeof(T) || i >= header->count) {
+        errno = EINVAL;
+        return -1;
+    }
+    if(header->layout == INDEX_PLAIN) {
+        memcpy(value, index.data + i*sizeof(T), sizeof(T)); // Checked to fit when the index was opened
+        return 0;
+    }
+
+    if constexpr(std::numeric_limits<T>::is_integer) {
+        uint64_t bits;
+        if(blockValue(index, i, &bits) < 0) { return -1; }
+        *value = (T)bits;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/*
+Answer a range sum from an index of inclusive prefix sums: sum(A[l..r]) = B[r] - B[l-1]
+param       index -- the index, of values of type T
+            l, r -- the first and last index of the range, l <= r
+            sum -- Pointer receiving the sum
+return      0 if successful, or -1 with errno EINVAL if the range is not valid, as for indexValue
+*/
+template<class T>
+int indexRangeSum(const PrefixIndex& index, size_t l, size_t r, T* sum) {
+    T last, before = T();
+    if(l > r) {
+        errno = EINVAL;
+        return -1;
+    }
+    if(indexValue(index, r, &last) < 0 || (l > 0 && indexValue(index, l - 1, &before) < 0)) { return -1; }
+    *sum = last - before;
+    return 0;
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,111 @@
+/*
+
+Embeddable prefix-sum library. Scans run on the caller's arrays with any element type and associative operator, on a
+persistent thread pool or on forked worker processes, without any file I/O.
+
+    #include "prefix-sum.h"
+
+    psum::ExecPolicy policy;
+    policy.workers = 8;
+    psum::inclusive_scan(in, out, n, psum::Plus(), policy);
+
+binary-io.h reads, writes and memory-maps raw binary arrays, and text-io.h reads and writes text arrays in parallel, for
+callers that keep their data in files. stream-scan.h scans inputs larger than memory chunk by chunk, overlapping the I/O of
+binary files with the scans through async-io.h, and segmented-scan.h scans many segments of one array at once, restarting
+at each head flag. fused-scan.h computes scans of one array with several operators in one pass. incremental-scan.h
+continues a scan over appended values and keeps sums of elements that change in a Fenwick tree. pipeline-scan.h parses,
+scans and formats text in one pass. prefix-index.h writes prefix sums as an index file that answers range sums in O(1)
+from a mapping. scan-service.h runs scans on a server with a warm thread pool. trace.h records where the time of a scan
+goes when ExecPolicy::trace is set. autotune.h chooses the backend and the workers of a scan from its size and a calibration
+of the machine. batch-scan.h scans many independent arrays on one pool of workers.
+
+Every scan function returns 0 if successful, or -1 if the working memory or the workers could not be allocated, with errno set.
+Link with libprefixsum.a and -pthread.
+
+*/
+
+#ifndef PREFIX_SUM_H
+#define PREFIX_SUM_H
+
+#include <cstddef>
+
+#include "autotune.h"
+#include "batch-scan.h"
+#include "binary-io.h"
+#include "exec-policy.h"
+#include "fused-scan.h"
+#include "incremental-scan.h"
+#include "pipeline-scan.h"
+#include "prefix-index.h"
+#include "scan-ops.h"
+#include "scan-service.h"
+#include "scan-engine.h"
+#include "segmented-scan.h"
+#include "shared-memory.h"
+#include "stream-scan.h"
+#include "text-io.h"
+#include "topology.h"
+#include "trace.h"
+
+namespace psum {
+
+/*
+Inclusive scan: out[i] = in[0] op in[1] op ... op in[i]
+param       in -- the input array
+            out -- the output array, may be the same as in
+            n -- the number of elements
+            op -- the associative operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 on failure
+*/
+template<class T, class Op>
+int inclusive_scan(const T* in, T* out, size_t n, Op op, const ExecPolicy& policy = ExecPolicy()) {
+    return scan(in, out, n, false, T(), op, policy);
+}
+
+/*
+Exclusive scan: out[0] = init and out[i] = init op in[0] op ... op in[i-1]
+param       in -- the input array
+            out -- the output array, may be the same as in
+            n -- the number of elements
+            init -- the first value of the scan, usually the identity of op
+            op -- the associative operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 on failure
+*/
+template<class T, class Op>
+int exclusive_scan(const T* in, T* out, size_t n, T init, Op op, const ExecPolicy& policy = ExecPolicy()) {
+    return scan(in, out, n, true, init, op, policy);
+}
+
+/*
+Inclusive scan overwriting its input. The work-efficient engine needs no working memory beyond one total per worker, so this
+halves the memory of a scan. Hillis and Steele's algorithm still allocates one scratch array.
+param       data -- the array to be scanned
+            n -- the number of elements
+            op -- the associative operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 on failure
+*/
+template<class T, class Op>
+int inclusive_scan_inplace(T* data, size_t n, Op op, const ExecPolicy& policy = ExecPolicy()) {
+    return scan((const T*)data, data, n, false, T(), op, policy);
+}
+
+/*
+Exclusive scan overwriting its input
+param       data -- the array to be scanned
+            n -- the number of elements
+            init -- the first value of the scan, usually the identity of op
+            op -- the associative operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 on failure
+*/
+template<class T, class Op>
+int exclusive_scan_inplace(T* data, size_t n, T init, Op op, const ExecPolicy& policy = ExecPolicy()) {
+    return scan((const T*)data, data, n, true, init, op, policy);
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,286 @@
+/*
+
+Throughput benchmark of the scan engines, run by "make bench". Every configuration in the sweep is timed on its own phase,
+so the cost of the scan is not mixed up with the text parsing, process start-up and writing that my-count times together:
+
+    parse       parseTextBuffer of the input formatted as text in memory
+    scan        the scan alone, array to array, workers started by the backend as part of it
+    format      writeTextArray of the result to /dev/null
+    pipeline    pipelineScan of the text to /dev/null, the three phases above fused into one pass
+
+Each phase is repeated and reported as the median and the 99th percentile of the runs, with the bytes read and written per
+second and the elements per second at the median. The output is CSV, or JSON with --format=json.
+
+    ./scan-bench [--sizes=n,...] [--workers=m,...] [--types=int32,int64,float,double] [--repeat=r] [--format=csv|json]
+                 [--shared-pool=bytes]
+
+--shared-pool keeps the shared memory of the process backend between runs (setSharedPool), so its scans are timed without
+creating and faulting in their segments every time.
+
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "prefix-sum.h"
+
+using namespace std;
+using namespace psum;
+
+/* An engine configuration of the sweep */
+struct Variant {
+    const char* name;
+    Engine engine;
+    SimdLevel simd;     // kernel of the work-efficient engine
+};
+
+const Variant VARIANTS[] = {
+    { "hillis-steele", HILLIS_STEELE, SIMD_SCALAR },
+    { "tiled-hillis-steele", TILED_HILLIS_STEELE, SIMD_SCALAR },
+    { "work-efficient-scalar", WORK_EFFICIENT, SIMD_SCALAR },
+    { "work-efficient-simd", WORK_EFFICIENT, SIMD_AUTO },
+};
+
+/* Settings of a run of the benchmark */
+struct BenchOptions {
+    vector<size_t> sizes;
+    vector<int> workers;
+    vector<string> types;
+    int repeat;
+    bool json;
+};
+
+/* Timings of one phase */
+struct PhaseStats {
+    double median;      // seconds
+    double p99;         // seconds
+};
+
+/*
+Handle errors and bad input
+param      String to be printed to user
+*/
+void errmsg(string msg) {
+    perror(msg.c_str());
+    exit(1);
+}
+
+/*
+Split a comma-separated list
+param       list -- the list
+return      the items, empty ones left out
+*/
+vector<string> splitList(const string& list) {
+    vector<string> items;
+    size_t start = 0;
+    while(start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if(comma == string::npos) { comma = list.size(); }
+        if(comma > start) { items.push_back(list.substr(start, comma - start)); }
+        start = comma + 1;
+    }
+    return items;
+}
+
+/*
+Parse the arguments
+param       argCount -- number of total arguments from main
+            args -- arguments array from main
+            opts -- Pointer to the options to be filled in
+return      -1 if an option is not recognized, 0 if valid
+*/
+int parseOptions(int argCount, char* args[], BenchOptions* opts) {
+    int cores = (int)thread::hardware_concurrency();
+    opts->sizes = { 10000, 1000000, 10000000 };
+    opts->workers = { 1, 2, 4 };
+    if(cores > 4) { opts->workers.push_back(cores); }
+    opts->types = { "int32", "int64", "float", "double" };
+    opts->repeat = 11;
+    opts->json = false;
+
+    for(int i = 1; i < argCount; i++) {
+        string arg = args[i];
+        if(arg.compare(0, 8, "--sizes=") == 0 || arg.compare(0, 10, "--workers=") == 0) {
+            bool sizes = (arg[2] == 's');
+            vector<string> items = splitList(arg.substr(sizes ? 8 : 10));
+            if(items.empty()) { return -1; }
+            if(sizes) { opts->sizes.clear(); }
+            else { opts->workers.clear(); }
+            for(size_t k = 0 ; k < items.size() ; k++) {
+                if(items[k].find_first_not_of("0123456789") != string::npos) { return -1; }
+                unsigned long long value = strtoull(items[k].c_str(), NULL, 10);
+                if(value == 0) { return -1; }
+                if(sizes) { opts->sizes.push_back(value); }
+                else { opts->workers.push_back((int)value); }
+            }
+        }
+        else if(arg.compare(0, 8, "--types=") == 0) {
+            opts->types = splitList(arg.substr(8));
+            for(size_t k = 0 ; k < opts->types.size() ; k++) {
+                const string& t = opts->types[k];
+                if(t != "int32" && t != "int64" && t != "float" && t != "double") { return -1; }
+            }
+            if(opts->types.empty()) { return -1; }
+        }
+        else if(arg.compare(0, 9, "--repeat=") == 0) {
+            opts->repeat = atoi(arg.substr(9).c_str());
+            if(opts->repeat < 1) { return -1; }
+        }
+        else if(arg == "--format=csv") { opts->json = false; }
+        else if(arg == "--format=json") { opts->json = true; }
+        else if(arg.compare(0, 14, "--shared-pool=") == 0) {
+            if(parseSharedPool(arg.c_str() + 14) < 0) { return -1; } // Global like the kernel selection
+        }
+        else { return -1; }
+    }
+    return 0;
+}
+
+/*
+Time a phase
+param       repeat -- the number of runs
+            run -- the phase, returns a negative value on failure
+return      the median and 99th percentile (nearest rank) of the runs
+*/
+template<class Run>
+PhaseStats timePhase(int repeat, Run run) {
+    vector<double> times;
+    for(int r = 0 ; r < repeat ; r++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if(run() < 0) { errmsg("Unable to run the benchmark."); }
+        times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    PhaseStats stats;
+    stats.median = times[times.size() / 2];
+    size_t rank = (size_t)(0.99*times.size() + 0.999999);
+    stats.p99 = times[(rank > 0 ? rank : 1) - 1];
+    return stats;
+}
+
+/*
+Print one result line
+param       opts -- the options, for the output format
+            first -- true for the first result, JSON separates the others with commas
+            phase, variant, backend, type -- what was timed
+            n, workers -- the size and the number of workers
+            bytes -- bytes read and written by the phase
+            stats -- the timings
+*/
+void report(const BenchOptions& opts, bool first, const char* phase, const char* variant, const char* backend,
+            const string& type, size_t n, int workers, double bytes, const PhaseStats& stats) {
+    double gbps = bytes / stats.median / 1e9;
+    double eps = (double)n / stats.median;
+    if(opts.json) {
+        printf("%s\n  {\"phase\": \"%s\", \"engine\": \"%s\", \"backend\": \"%s\", \"type\": \"%s\", \"n\": %zu, \"workers\": %d, "
+               "\"median_s\": %.9f, \"p99_s\": %.9f, \"gb_per_s\": %.3f, \"elements_per_s\": %.0f}",
+               first ? "" : ",", phase, variant, backend, type.c_str(), n, workers, stats.median, stats.p99, gbps, eps);
+    }
+    else {
+        printf("%s,%s,%s,%s,%zu,%d,%.9f,%.9f,%.3f,%.0f\n", phase, variant, backend, type.c_str(), n, workers,
+               stats.median, stats.p99, gbps, eps);
+    }
+    fflush(stdout);
+}
+
+/*
+Run the sweep for one element type
+param       opts -- the options
+            type -- the name of the type
+            first -- Pointer to true until the first result is printed
+*/
+template<class T>
+void benchType(const BenchOptions& opts, const string& type, bool* first) {
+    int nullFd = open("/dev/null", O_WRONLY);
+    if(nullFd < 0) { errmsg("Unable to open /dev/null."); }
+
+    for(size_t s = 0 ; s < opts.sizes.size() ; s++) {
+        size_t n = opts.sizes[s];
+        vector<T> in(n);
+        for(size_t k = 0 ; k < n ; k++) { in[k] = (T)(int)(k % 201) - (T)100; }
+
+        // The text of the input, for the parse phase
+        string text;
+        char digits[64];
+        for(size_t k = 0 ; k < n ; k++) {
+            to_chars_result end = to_chars(digits, digits + sizeof(digits), in[k]);
+            text.append(digits, end.ptr - digits);
+            text.push_back('\n');
+        }
+
+        // Shared for both backends, so the process backend writes it directly instead of staging the result
+        T* out = (T*)allocateShared(sizeof(T)*n);
+        T* parsed = (T*)allocateMemory(false, sizeof(T)*n);
+        if(out == NULL || parsed == NULL) { errmsg("Error creating shared memory segment."); }
+
+        for(size_t w = 0 ; w < opts.workers.size() ; w++) {
+            ExecPolicy policy;
+            policy.workers = opts.workers[w];
+            policy.deviceThreshold = 0; // The CPU engines are measured
+
+            PhaseStats stats = timePhase(opts.repeat, [&]() {
+                size_t used;
+                return parseTextBuffer(text.data(), text.size(), parsed, n, policy, &used) == n ? 0 : -1;
+            });
+            report(opts, *first, "parse", "text", "thread", type, n, policy.workers, (double)text.size() + sizeof(T)*n, stats);
+            *first = false;
+
+            for(size_t v = 0 ; v < sizeof(VARIANTS) / sizeof(VARIANTS[0]) ; v++) {
+                for(int b = 0 ; b < 2 ; b++) {
+                    policy.engine = VARIANTS[v].engine;
+                    policy.backend = (b == 0) ? THREAD_BACKEND : PROCESS_BACKEND;
+                    if(setSimdLevel(VARIANTS[v].simd) < 0) { continue; }
+                    stats = timePhase(opts.repeat, [&]() { return inclusive_scan(in.data(), out, n, Plus(), policy); });
+                    report(opts, false, "scan", VARIANTS[v].name, b == 0 ? "thread" : "process", type, n, policy.workers,
+                           2.0*sizeof(T)*n, stats);
+                }
+            }
+            setSimdLevel(SIMD_AUTO);
+
+            policy.backend = THREAD_BACKEND;
+            stats = timePhase(opts.repeat, [&]() { return writeTextArray(nullFd, out, n, policy); });
+            report(opts, false, "format", "text", "thread", type, n, policy.workers, sizeof(T)*n + (double)text.size(), stats);
+
+            stats = timePhase(opts.repeat, [&]() {
+                T total;
+                return pipelineScan(text.data(), text.size(), nullFd, n, Plus(), policy, &total) == (long long)n ? 0 : -1;
+            });
+            report(opts, false, "pipeline", "text", "thread", type, n, policy.workers, 2.0*text.size(), stats);
+        }
+
+        freeShared(out);
+        releaseMemory(false, parsed);
+    }
+    close(nullFd);
+}
+
+/* Start of main */
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    if(parseOptions(argc, argv, &opts) < 0) {
+        errmsg("Invalid option provided.");
+    }
+
+    if(opts.json) { printf("["); }
+    else { printf("phase,engine,backend,type,n,workers,median_s,p99_s,gb_per_s,elements_per_s\n"); }
+
+    bool first = true;
+    for(size_t t = 0 ; t < opts.types.size() ; t++) {
+        const string& type = opts.types[t];
+        if(type == "int32") { benchType<int32_t>(opts, type, &first); }
+        else if(type == "int64") { benchType<int64_t>(opts, type, &first); }
+        else if(type == "float") { benchType<float>(opts, type, &first); }
+        else { benchType<double>(opts, type, &first); }
+    }
+
+    if(opts.json) { printf("\n]\n"); }
+    return 0;
+}
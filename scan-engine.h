@@ -0,0 +1,623 @@
+/*
+
+The scan engines, templated on the element type and the operator. Every engine is run by a number of workers that each own a
+block of the array and meet at a barrier between phases.
+
+Hillis and Steele's algorithm runs log N rounds. In round i every element is combined with the element 2^i before it, so the
+work is O(N log N) and every round is a full pass over memory. Two arrays of size N are used for the intermediate results.
+
+The tiled variant computes the same values with fewer passes. Each worker takes its block one cache-sized tile at a time and
+runs every round with a stride below a quarter of the tile size on a window holding the tile and the elements before it that
+those rounds reach, which keeps the extra work on that history to a quarter. Every value is combined from the same operands
+as in the plain rounds, so the results are identical, floating point included. Only the remaining log(N/tile) rounds are
+global passes with a barrier.
+
+The work-efficient engine scans each block on its own, the block totals are scanned, and each worker combines the total of the
+preceding blocks with its block. This is O(N) work with two passes over memory and a single barrier. The per-block pass of
+the integer prefix sum is vectorized (simd-scan.h).
+
+Prefix sums of large arrays go to a GPU instead when the library is built with a device backend (device-scan.h). The CPU
+engines remain the fallback for everything else and when the device fails.
+
+*/
+
+#ifndef SCAN_ENGINE_H
+#define SCAN_ENGINE_H
+
+#include <cstddef>
+#include <cstring>
+#include <errno.h>
+#include <stdint.h>
+
+#include "barrier.h"
+#include "control-block.h"
+#include "device-scan.h"
+#include "exec-policy.h"
+#include "scan-ops.h"
+#include "shared-memory.h"
+#include "simd-scan.h"
+#include "trace.h"
+
+namespace psum {
+
+/* Chunks per worker with dynamic partitioning, enough to even out a slow worker without making the passes much longer */
+const int DYNAMIC_CHUNKS = 8;
+
+/* Everything a worker needs to take part in a scan */
+template<class T, class Op>
+struct ScanTask {
+    Engine engine;
+    const T* in;
+    T* out;
+    T* scratch;         // second array of Hillis and Steele
+    T* windows;         // private window of each worker for the tiled engine, in two halves
+    size_t windowSize;  // elements per half window, padded to cache lines
+    size_t tileSize;    // elements per tile
+    int tileRounds;     // rounds run inside the tiles, 0 for the plain engine
+    WorkerSlot<T>* slots; // chunk totals, and the status of each worker
+    ClaimCounter* counters; // next chunk of each pass, for dynamic partitioning
+    Barrier* barrier;
+    size_t arraySize;
+    int processes;
+    int chunks;         // pieces the array is split into, one per worker unless partitioning is dynamic
+    bool dynamic;       // workers claim chunks as they finish instead of owning one each
+    int rounds;         // Hillis and Steele rounds, including the shift of an exclusive scan
+    bool copyFirst;     // in-place Hillis and Steele: copy the input aside before the first round
+    bool exclusive;
+    T init;             // first value of an exclusive scan
+    Op op;
+    Trace* trace;       // records the passes of each worker, or NULL
+    int64_t launched;   // traceClock() when the workers were started
+
+    explicit ScanTask(const Op& op) : op(op) {}
+};
+
+/*
+Determine the index range of a chunk when the array is split into equal chunks. Sizes differ by at most one element, the
+first arraySize % chunks chunks get the extra one.
+param       chunk -- the number of the chunk
+            chunks -- the total number of chunks
+            arraySize -- the size of the arrays
+            chunkStart, chunkEnd -- Pointers to the first index and one past the last index of the range
+*/
+inline void getChunkRange(int chunk, int chunks, size_t arraySize, size_t* chunkStart, size_t* chunkEnd) {
+    size_t base = arraySize / chunks;
+    size_t extra = arraySize % chunks;
+    *chunkStart = chunk*base + ((size_t)chunk < extra ? chunk : extra);
+    *chunkEnd = *chunkStart + base + ((size_t)chunk < extra ? 1 : 0);
+}
+
+/*
+Run one pass of a scan over the chunks of the current worker. With static partitioning worker j has chunk j. With dynamic
+partitioning the workers take chunks from the pass's counter until none are left, so a worker that is slowed down takes
+fewer of them.
+param       task -- the scan
+            thisProcess -- the number associated with the current worker
+            pass -- the number of the pass, each pass has its own counter
+            body -- called with the chunk number and its index range
+*/
+template<class T, class Op, class Body>
+void forEachChunk(const ScanTask<T, Op>& task, int thisProcess, int pass, Body body) {
+    size_t chunkStart, chunkEnd;
+    if(!task.dynamic) {
+        getChunkRange(thisProcess, task.chunks, task.arraySize, &chunkStart, &chunkEnd);
+        body(thisProcess, chunkStart, chunkEnd);
+        return;
+    }
+    for(;;) {
+        int chunk = (int)__atomic_fetch_add(&task.counters[pass].next, 1, __ATOMIC_RELAXED);
+        if(chunk >= task.chunks) { return; }
+        getChunkRange(chunk, task.chunks, task.arraySize, &chunkStart, &chunkEnd);
+        body(chunk, chunkStart, chunkEnd);
+    }
+}
+
+/*
+Run one pass and wait at the barrier for the other workers, the pass number is also the barrier episode. When the scan is
+traced, the time spent computing and the time spent waiting are recorded as spans of their own.
+param       task -- the scan
+            thisProcess -- the number associated with the current worker
+            pass -- the number of the pass
+            wait -- false for the last pass of the work-efficient engine, which needs no barrier
+            body -- called with the chunk number and its index range
+*/
+template<class T, class Op, class Body>
+void runPass(const ScanTask<T, Op>& task, int thisProcess, int pass, bool wait, Body body) {
+    if(task.trace == NULL) {
+        forEachChunk(task, thisProcess, pass, body);
+        if(wait) { synchronize(task.barrier, thisProcess, pass); }
+        return;
+    }
+    TraceMark mark;
+    traceMark(task.trace, thisProcess, &mark);
+    forEachChunk(task, thisProcess, pass, body);
+    traceSpan(task.trace, thisProcess, "compute", pass, &mark);
+    if(!wait) { return; }
+    traceMark(task.trace, thisProcess, &mark);
+    synchronize(task.barrier, thisProcess, pass);
+    traceSpan(task.trace, thisProcess, "wait", pass, &mark);
+}
+
+/*
+Perform one round of the Hillis and Steele algorithm on a range of the array
+param       thisArray -- Array for the current iteration
+            nextArray -- array for the next iteration
+            start, end -- the index range
+            iter -- the number of the current iteration
+            op -- the operator
+*/
+template<class T, class Op>
+void parallelScan(const T* thisArray, T* nextArray, size_t start, size_t end, int iter, Op op) {
+    size_t temp = (size_t)1 << iter; // value to be used in the algorithm
+
+    // Elements before temp keep their value, split off so that the main loop has no branch and vectorizes
+    size_t k = start;
+    for( ; k < end && k < temp ; k++) {
+        nextArray[k] = thisArray[k]; // Same value copied for next iteration
+    }
+
+    // Perform algorithm
+    for( ; k < end ; k++) {
+        nextArray[k] = op(thisArray[k - temp], thisArray[k]);
+    }
+}
+
+/*
+Shift an inclusive scan one place to the right to make it exclusive, the last Hillis and Steele round of an exclusive scan
+param       thisArray -- the inclusive scan
+            nextArray -- array receiving the exclusive scan
+            start, end -- the index range
+            init -- the first value of the exclusive scan
+            op -- the operator
+*/
+template<class T, class Op>
+void shiftRound(const T* thisArray, T* nextArray, size_t start, size_t end, T init, Op op) {
+    for(size_t k = start ; k < end ; k++) {
+        nextArray[k] = (k == 0) ? init : op(init, thisArray[k - 1]);
+    }
+}
+
+/*
+Run the first rounds of Hillis and Steele tile by tile for a range of the array. After r rounds an element depends on the
+2^r - 1 elements before it, so each tile is loaded into the window together with that many elements of history and the
+rounds run there in cache, alternating between the two halves of the window like the plain rounds alternate arrays. Each
+round only computes the part of the window the tile still depends on.
+param       inArray -- the input array
+            outArray -- the array receiving the values after tileRounds rounds
+            window -- private buffer holding two halves of windowSize elements
+            windowSize -- at least tileSize + 2^tileRounds - 1
+            start, end -- the index range
+            tileSize -- the number of elements of a tile
+            tileRounds -- the number of rounds, at most log2(tileSize)
+            op -- the operator
+*/
+template<class T, class Op>
+void tileRounds(const T* inArray, T* outArray, T* window, size_t windowSize, size_t start, size_t end, size_t tileSize,
+                int tileRounds, Op op) {
+    size_t history = ((size_t)1 << tileRounds) - 1;
+
+    for(size_t tileStart = start ; tileStart < end ; tileStart += tileSize) {
+        size_t tileEnd = tileStart + tileSize < end ? tileStart + tileSize : end;
+        size_t windowStart = tileStart > history ? tileStart - history : 0;
+        size_t length = tileEnd - windowStart;
+        size_t tileOffset = tileStart - windowStart;
+
+        T* thisWindow = window;
+        T* nextWindow = window + windowSize;
+        memcpy(thisWindow, inArray + windowStart, sizeof(T)*length);
+
+        for(int r = 0 ; r < tileRounds ; r++) {
+            size_t temp = (size_t)1 << r;
+            // The tile depends on the history - (2*temp - 1) elements before it after this round
+            size_t reach = history - (2*temp - 1);
+            size_t w = tileOffset > reach ? tileOffset - reach : 0;
+
+            // Only the start of the array has elements before temp, they keep their value as in parallelScan
+            for( ; w < length && w < temp ; w++) {
+                nextWindow[w] = thisWindow[w];
+            }
+            for( ; w < length ; w++) {
+                nextWindow[w] = op(thisWindow[w - temp], thisWindow[w]);
+            }
+
+            T* swap = thisWindow;
+            thisWindow = nextWindow;
+            nextWindow = swap;
+        }
+        memcpy(outArray + tileStart, thisWindow + tileOffset, sizeof(T)*(tileEnd - tileStart));
+    }
+}
+
+/*
+Copy a range of one array to another
+param       thisArray -- the source array
+            nextArray -- the destination array
+            start, end -- the index range
+*/
+template<class T>
+void copyBlock(const T* thisArray, T* nextArray, size_t start, size_t end) {
+    memcpy(nextArray + start, thisArray + start, sizeof(T)*(end - start));
+}
+
+/*
+Kernel for the inclusive per-block pass. The generic version is a scalar loop, the prefix sums of 32 and 64-bit integers
+use the vectorized kernels.
+*/
+template<class T, class Op>
+struct BlockKernel {
+    /*
+    Inclusive scan of a block, in and out may be the same array
+    param       in -- the input elements
+                out -- the output elements
+                n -- the number of elements, at least 1
+                op -- the operator
+    return      the total of the block
+    */
+    static T scan(const T* in, T* out, size_t n, Op op) {
+        T sum = in[0];
+        out[0] = sum;
+        for(size_t k = 1 ; k < n ; k++) {
+            sum = op(sum, in[k]);
+            out[k] = sum;
+        }
+        return sum;
+    }
+};
+
+template<>
+struct BlockKernel<int32_t, Plus> {
+    static int32_t scan(const int32_t* in, int32_t* out, size_t n, Plus) { return scanBlockSimd(in, out, n, 0); }
+};
+
+template<>
+struct BlockKernel<int64_t, Plus> {
+    static int64_t scan(const int64_t* in, int64_t* out, size_t n, Plus) { return scanBlockSimd(in, out, n, 0); }
+};
+
+// Unsigned addition wraps the same way, so it shares the signed kernels
+template<>
+struct BlockKernel<uint32_t, Plus> {
+    static uint32_t scan(const uint32_t* in, uint32_t* out, size_t n, Plus) { return scanBlockSimd((const int32_t*)in, (int32_t*)out, n, 0); }
+};
+
+template<>
+struct BlockKernel<uint64_t, Plus> {
+    static uint64_t scan(const uint64_t* in, uint64_t* out, size_t n, Plus) { return scanBlockSimd((const int64_t*)in, (int64_t*)out, n, 0); }
+};
+
+/*
+Scan on a device, for the element types and operators the device backend supports. The generic version supports none.
+*/
+template<class T, class Op>
+struct DeviceKernel {
+    static const bool supported = false;
+
+    /*
+    Scan a whole array on the device
+    param       in, out, n, exclusive, init -- as for scan
+    return      0 if successful, or -1 if the device cannot run it
+    */
+    static int scan(const T*, T*, size_t, bool, T) { return -1; }
+};
+
+template<>
+struct DeviceKernel<int32_t, Plus> {
+    static const bool supported = true;
+    static int scan(const int32_t* in, int32_t* out, size_t n, bool exclusive, int32_t init) { return deviceScan(in, out, n, exclusive, init); }
+};
+
+template<>
+struct DeviceKernel<int64_t, Plus> {
+    static const bool supported = true;
+    static int scan(const int64_t* in, int64_t* out, size_t n, bool exclusive, int64_t init) { return deviceScan(in, out, n, exclusive, init); }
+};
+
+// Unsigned sums use the signed device scans, as for BlockKernel
+template<>
+struct DeviceKernel<uint32_t, Plus> {
+    static const bool supported = true;
+    static int scan(const uint32_t* in, uint32_t* out, size_t n, bool exclusive, uint32_t init) {
+        return deviceScan((const int32_t*)in, (int32_t*)out, n, exclusive, (int32_t)init);
+    }
+};
+
+template<>
+struct DeviceKernel<uint64_t, Plus> {
+    static const bool supported = true;
+    static int scan(const uint64_t* in, uint64_t* out, size_t n, bool exclusive, uint64_t init) {
+        return deviceScan((const int64_t*)in, (int64_t*)out, n, exclusive, (int64_t)init);
+    }
+};
+
+template<>
+struct DeviceKernel<float, Plus> {
+    static const bool supported = true;
+    static int scan(const float* in, float* out, size_t n, bool exclusive, float init) { return deviceScan(in, out, n, exclusive, init); }
+};
+
+template<>
+struct DeviceKernel<double, Plus> {
+    static const bool supported = true;
+    static int scan(const double* in, double* out, size_t n, bool exclusive, double init) { return deviceScan(in, out, n, exclusive, init); }
+};
+
+/*
+Scan one chunk on its own (work-efficient phase 1). Each input element is read before the output element at the same index
+is written, so inArray and outArray may be the same array.
+param       inArray -- the input array
+            outArray -- the array receiving the scan of each chunk. For an exclusive scan the first element of the chunk
+                        is left for addOffsets.
+            slots -- shared slots receiving the total of each chunk
+            chunk -- the number of the chunk
+            start, end -- the index range of the chunk
+            exclusive -- true for an exclusive scan
+            op -- the operator
+*/
+template<class T, class Op>
+void localScan(const T* inArray, T* outArray, WorkerSlot<T>* slots, int chunk, size_t start, size_t end, bool exclusive, Op op) {
+    if(start == end) { return; } // Chunks are only empty when there are more chunks than elements, which scan avoids
+
+    T sum;
+    if(exclusive) {
+        sum = inArray[start];
+        for(size_t k = start + 1 ; k < end ; k++) {
+            T value = inArray[k];
+            outArray[k] = sum;
+            sum = op(sum, value);
+        }
+    }
+    else {
+        sum = BlockKernel<T, Op>::scan(inArray + start, outArray + start, end - start, op);
+    }
+    slots[chunk].total = sum; // Publish the total for the other workers
+}
+
+/*
+Combine the total of all preceding chunks with one chunk (work-efficient phases 2 and 3)
+param       outArray -- the array holding the scan of each chunk
+            slots -- shared slots holding the total of each chunk
+            chunk -- the number of the chunk
+            start, end -- the index range of the chunk
+            exclusive -- true for an exclusive scan
+            init -- the first value of an exclusive scan
+            op -- the operator
+*/
+template<class T, class Op>
+void addOffsets(T* outArray, const WorkerSlot<T>* slots, int chunk, size_t start, size_t end, bool exclusive, T init, Op op) {
+    if(start == end) { return; }
+
+    // Scan the chunk totals up to the current chunk. There are only a few per worker, so each chunk scans them again.
+    if(!exclusive && chunk == 0) { return; } // Nothing to combine with the first chunk
+    T offset = exclusive ? init : slots[0].total;
+    for(int j = exclusive ? 0 : 1 ; j < chunk ; j++) {
+        offset = op(offset, slots[j].total);
+    }
+
+    size_t k = start;
+    if(exclusive) { outArray[k++] = offset; }
+    for( ; k < end ; k++) {
+        outArray[k] = op(offset, outArray[k]);
+    }
+}
+
+/*
+Run the selected engine as one worker, executed by child processes or pool threads
+param       task -- the scan to take part in
+            thisProcess -- the number associated with the current worker
+*/
+template<class T, class Op>
+void runEngine(const ScanTask<T, Op>& task, int thisProcess) {
+    if(task.engine == WORK_EFFICIENT) {
+        // Scan each chunk alone, then wait for every chunk total
+        runPass(task, thisProcess, 0, true, [&task](int chunk, size_t start, size_t end) {
+            localScan(task.in, task.out, task.slots, chunk, start, end, task.exclusive, task.op);
+        });
+        // Add the preceding chunks
+        runPass(task, thisProcess, 1, false, [&task](int chunk, size_t start, size_t end) {
+            addOffsets(task.out, task.slots, chunk, start, end, task.exclusive, task.init, task.op);
+        });
+        return;
+    }
+
+    int episode = 0; // Also the number of the pass
+    const T* thisArray = task.in;
+    if(task.copyFirst) {
+        runPass(task, thisProcess, episode++, true, [&task](int, size_t start, size_t end) {
+            copyBlock(task.in, task.scratch, start, end);
+        });
+        thisArray = task.scratch;
+    }
+
+    // The tiles write the array the last of their rounds would have written
+    if(task.tileRounds > 0) {
+        T* nextArray = ((task.rounds - task.tileRounds) % 2 == 0) ? task.out : task.scratch;
+        T* window = task.windows + 2*thisProcess*task.windowSize;
+        runPass(task, thisProcess, episode++, true, [&](int, size_t start, size_t end) {
+            tileRounds(thisArray, nextArray, window, task.windowSize, start, end, task.tileSize, task.tileRounds, task.op);
+        });
+        thisArray = nextArray;
+    }
+
+    // The arrays alternate so that the last round writes the output
+    for(int i = task.tileRounds ; i < task.rounds ; i++) {
+        T* nextArray = ((task.rounds - 1 - i) % 2 == 0) ? task.out : task.scratch;
+        bool shift = (task.exclusive && i == task.rounds - 1);
+        runPass(task, thisProcess, episode++, true, [&](int, size_t start, size_t end) {
+            if(shift) { shiftRound(thisArray, nextArray, start, end, task.init, task.op); }
+            else { parallelScan(thisArray, nextArray, start, end, i, task.op); } // Compute for this iteration
+        }); // synchronize all workers
+        thisArray = nextArray;
+    }
+}
+
+/*
+Run the selected engine as one worker and report in its slot that it finished
+param       task -- the scan to take part in
+            thisProcess -- the number associated with the current worker
+*/
+template<class T, class Op>
+void runWorker(const ScanTask<T, Op>& task, int thisProcess) {
+    if(task.trace != NULL) {
+        // From the start of the workers to this one running, a fork or a wake up of a pool thread
+        TraceMark mark = { task.launched, { -1, -1, -1 } };
+        traceSpan(task.trace, thisProcess, "start", -1, &mark);
+        openTraceCounters(task.trace, thisProcess);
+    }
+    runEngine(task, thisProcess);
+    if(task.trace != NULL) { closeTraceCounters(task.trace, thisProcess); }
+    __atomic_store_n(&task.slots[thisProcess].status, (int)WORKER_FINISHED, __ATOMIC_RELEASE);
+}
+
+/*
+Run a scan with the given policy. Elements must be trivially copyable, the process backend moves them through shared memory.
+param       in -- the input array
+            out -- the output array, may be the same as in
+            n -- the number of elements
+            exclusive -- true for an exclusive scan
+            init -- the first value of an exclusive scan
+            op -- the operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 if memory or workers could not be allocated, or a forked worker died
+*/
+template<class T, class Op>
+int scan(const T* in, T* out, size_t n, bool exclusive, T init, Op op, const ExecPolicy& policy) {
+    if(n == 0) { return 0; }
+
+    // Large arrays go to a device if there is one, and to the CPU engines if the device fails
+    if(DeviceKernel<T, Op>::supported && policy.deviceThreshold > 0 && n >= policy.deviceThreshold && deviceAvailable() &&
+       DeviceKernel<T, Op>::scan(in, out, n, exclusive, init) == 0) {
+        return 0;
+    }
+
+    /* If there are more workers than N, no need to make additional workers */
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    bool shared = (policy.backend == PROCESS_BACKEND);
+
+    // One thread worker needs no barrier or slots, the block kernel scans the array in the calling thread. A forked worker still
+    // runs in a process of its own.
+    if(workers == 1 && policy.backend == THREAD_BACKEND && policy.engine == WORK_EFFICIENT && policy.affinity == AFFINITY_NONE &&
+       policy.trace == NULL) {
+        if(exclusive) {
+            T sum = init;
+            for(size_t k = 0 ; k < n ; k++) {
+                T value = in[k]; // Read before the write, in and out may be the same array
+                out[k] = sum;
+                sum = op(sum, value);
+            }
+        }
+        else { BlockKernel<T, Op>::scan(in, out, n, op); }
+        return 0;
+    }
+
+    ScanTask<T, Op> task(op);
+    task.engine = policy.engine;
+    task.in = in;
+    task.out = out;
+    task.scratch = NULL;
+    task.windows = NULL;
+    task.tileRounds = 0;
+    task.arraySize = n;
+    task.processes = workers;
+    task.exclusive = exclusive;
+    task.init = init;
+    task.trace = policy.trace;
+
+    // Equal chunks, one per worker, or several per worker to be claimed for dynamic partitioning
+    task.dynamic = (policy.partition == DYNAMIC_PARTITION && workers > 1);
+    size_t chunks = task.dynamic ? (size_t)workers*DYNAMIC_CHUNKS : (size_t)workers;
+    task.chunks = (int)(chunks < n ? chunks : n);
+
+    // Calculate the number of iterations needed, floor(log2(n)) + 1
+    task.rounds = 0;
+    while((n >> task.rounds) > 1) { task.rounds++; }
+    task.rounds += exclusive ? 2 : 1;
+
+    /* The barrier, the slots of the workers and chunks, and a counter per pass, each on cache lines of their own */
+    ControlBlock<T> control;
+    createControlBlock(&control, policy.barrier, workers, task.chunks, task.rounds + 2, shared);
+
+    // Forked workers cannot write to the caller's memory, so the result is staged unless out is already shared
+    SharedArena arena; // The working arrays, released on return
+    T* stage = NULL;
+    if(shared && !isShared(out, sizeof(T)*n)) {
+        stage = (T*)arena.allocate(shared, sizeof(T)*n);
+        task.out = stage;
+    }
+    bool hillisSteele = (task.engine != WORK_EFFICIENT);
+    if(hillisSteele) {
+        task.scratch = (T*)arena.allocate(shared, sizeof(T)*n);
+    }
+
+    /* Tiles of a power of two hold every round with a stride below a quarter of the tile, the shift of an exclusive scan is never tiled */
+    if(task.engine == TILED_HILLIS_STEELE) {
+        task.tileSize = policy.tileSize;
+        if(task.tileSize == 0) {
+            task.tileSize = 2;
+            while(task.tileSize*4*sizeof(T) <= (256 << 10)) { task.tileSize *= 2; } // Both halves of the window fit
+        }
+        while((task.tileSize >> (task.tileRounds + 3)) > 0 && task.tileRounds < task.rounds - (exclusive ? 1 : 0)) { task.tileRounds++; }
+
+        // One window per worker, private even when forked, as each child writes only its own copy
+        size_t perLine = CACHE_LINE / sizeof(T) > 0 ? CACHE_LINE / sizeof(T) : 1;
+        task.windowSize = (task.tileSize + ((size_t)1 << task.tileRounds) - 1 + perLine - 1) / perLine * perLine;
+        task.windows = (T*)arena.allocate(false, 2*sizeof(T)*task.windowSize*workers);
+    }
+
+    int result = -1;
+    if(control.memory != NULL && (!shared || isShared(task.out, sizeof(T)*n)) && (!hillisSteele || task.scratch != NULL) &&
+       (task.engine != TILED_HILLIS_STEELE || task.windows != NULL)) {
+        task.barrier = control.barrier;
+        task.slots = control.slots;
+        task.counters = control.counters;
+
+        // The first pass cannot write to the array it reads, whether it is the first round or the tiles
+        int firstWritten = task.tileRounds > 0 ? task.tileRounds - 1 : 0;
+        task.copyFirst = (hillisSteele && task.in == task.out && (task.rounds - 1 - firstWritten) % 2 == 0);
+
+        TraceMark mark = { 0, { -1, -1, -1 } };
+        if(task.trace != NULL) { traceMark(task.trace, TRACE_CALLER, &mark); }
+        task.launched = mark.time;
+        result = runWorkers(policy, workers, [&task](int j) { runWorker(task, j); });
+        if(task.trace != NULL) { traceSpan(task.trace, TRACE_CALLER, "workers", -1, &mark); }
+        if(result == 0 && !allFinished(&control)) {
+            // A forked worker died before its block was done
+            errno = ECHILD;
+            result = -1;
+        }
+        if(result == 0 && stage != NULL) {
+            memcpy(out, stage, sizeof(T)*n);
+        }
+    }
+
+    releaseControlBlock(&control);
+    return result;
+}
+
+/*
+Write zeros to the block of every worker from that worker, using the blocks of scan. Memory is placed on the node that first
+touches it, so with an affinity each block of a fresh array ends up local to the worker that scans it, instead of wherever
+the thread that fills the array in runs. The workers are always threads, which works for any memory.
+param       data -- the array, not yet filled in
+            n -- the number of elements
+            policy -- the workers and their affinity, as for the scan that will use the array
+return      0 if successful, or -1 if the workers could not be started
+*/
+template<class T>
+int touchBlocks(T* data, size_t n, const ExecPolicy& policy) {
+    if(n == 0) { return 0; }
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+    return runWorkers(threads, workers, [=](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        memset((void*)(data + chunkStart), 0, sizeof(T)*(chunkEnd - chunkStart));
+    });
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,187 @@
+/*
+
+Associative operators for the scan engines. An operator is any copyable object with T operator()(T, T). Operands are
+always given in array order, so operators do not need to be commutative.
+
+The element type and the operator are template parameters of the engines, so choosing a checked or saturating addition is
+resolved at compile time and the plain prefix sum pays nothing for it.
+
+*/
+
+#ifndef SCAN_OPS_H
+#define SCAN_OPS_H
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace psum {
+
+/*
+Add two values, wrapping integers around on overflow. Signed overflow is undefined, so integers are added in the unsigned
+type of their size, which wraps, and converted back.
+param       a, b -- the operands
+return      the sum
+*/
+template<class T>
+inline T wrappingAdd(T a, T b) {
+    if constexpr(std::is_integral<T>::value && !std::is_same<T, bool>::value) {
+        typedef typename std::make_unsigned<T>::type Unsigned;
+        return (T)((Unsigned)a + (Unsigned)b);
+    }
+    else { return a + b; }
+}
+
+/* Ordinary addition, the prefix sum. Integers wrap around on overflow. */
+struct Plus {
+    template<class T>
+    T operator()(const T& a, const T& b) const { return wrappingAdd(a, b); }
+};
+
+/*
+Add two values and report if the result does not fit the type
+param       a, b -- the operands
+            result -- Pointer receiving the (wrapped) sum
+return      true if the addition overflowed
+*/
+template<class T>
+inline bool addOverflows(T a, T b, T* result) {
+    return __builtin_add_overflow(a, b, result);
+}
+
+// Floating point sums overflow to infinity
+inline bool addOverflows(float a, float b, float* result) {
+    *result = a + b;
+    return std::isinf(*result) && !std::isinf(a) && !std::isinf(b);
+}
+
+inline bool addOverflows(double a, double b, double* result) {
+    *result = a + b;
+    return std::isinf(*result) && !std::isinf(a) && !std::isinf(b);
+}
+
+/*
+Addition that records any overflow in a flag. Every partial sum the engine computes is checked, so an overflowing prefix sum
+is always reported. With mixed signs a partial sum that is not itself a prefix can also overflow, which is reported as well.
+For the process backend the flag must be in memory from allocateShared.
+*/
+struct CheckedPlus {
+    int* overflow; // set to 1 by the first overflowing addition
+
+    explicit CheckedPlus(int* overflow) : overflow(overflow) {}
+
+    template<class T>
+    T operator()(const T& a, const T& b) const {
+        T result;
+        if(addOverflows(a, b, &result)) { __atomic_store_n(overflow, 1, __ATOMIC_RELAXED); }
+        return result;
+    }
+};
+
+/*
+Add two values, clamping the result to the range of the type
+param       a, b -- the operands
+return      the sum, or the largest or smallest value of the type
+*/
+template<class T>
+inline T saturatingAdd(T a, T b) {
+    T result;
+    if(!__builtin_add_overflow(a, b, &result)) { return result; }
+    return (b > T()) ? std::numeric_limits<T>::max() : std::numeric_limits<T>::min();
+}
+
+// Floating point sums already saturate at infinity
+inline float saturatingAdd(float a, float b) { return a + b; }
+inline double saturatingAdd(double a, double b) { return a + b; }
+
+/*
+Addition clamped to the range of the type. It is only associative while the inputs all have the same sign, which is the
+usual case of running totals of counts. Otherwise a parallel scan groups the sums differently on every engine and worker
+count, and only a scan by one work-efficient worker gives the clamped sums from left to right.
+*/
+struct SaturatingPlus {
+    template<class T>
+    T operator()(const T& a, const T& b) const { return saturatingAdd(a, b); }
+};
+
+/* Running maximum, a watermark */
+struct Max {
+    template<class T>
+    T operator()(const T& a, const T& b) const { return a < b ? b : a; }
+};
+
+/* Running minimum */
+struct Min {
+    template<class T>
+    T operator()(const T& a, const T& b) const { return b < a ? b : a; }
+};
+
+/* Exclusive or of integers */
+struct BitXor {
+    template<class T>
+    T operator()(const T& a, const T& b) const { return a ^ b; }
+};
+
+/* Running product. Integers wrap around on overflow, like Plus. */
+struct Multiplies {
+    template<class T>
+    T operator()(const T& a, const T& b) const { return a * b; }
+};
+
+/* The built-in operators, for choosing one at run time */
+enum OpKind { SUM_OP, MAX_OP, MIN_OP, XOR_OP, PRODUCT_OP };
+
+/*
+One of the built-in operators chosen at run time, so that scans with different operators can share one operator type, as in
+fusedScan. The choice is a branch on every call, the compile-time operators cost nothing for it. XOR_OP is only defined for
+integers, for floating point types it keeps the right operand.
+*/
+struct BuiltinOp {
+    OpKind kind;
+
+    explicit BuiltinOp(OpKind kind) : kind(kind) {}
+
+    template<class T>
+    T operator()(const T& a, const T& b) const {
+        switch(kind) {
+            case MAX_OP: return Max()(a, b);
+            case MIN_OP: return Min()(a, b);
+            case XOR_OP:
+                if constexpr(std::numeric_limits<T>::is_integer) { return BitXor()(a, b); }
+                else { return b; }
+            case PRODUCT_OP: return Multiplies()(a, b);
+            default: return Plus()(a, b);
+        }
+    }
+};
+
+/* An element of a segmented scan: a value and whether a segment starts at it */
+template<class T>
+struct SegmentedValue {
+    T value;
+    int head;           // nonzero if a segment starts here, or after combining, anywhere in the combined range
+};
+
+/*
+Segmented version of another operator. Combining two ranges keeps the right one alone if a segment starts in it, so a scan
+with this operator restarts at every head. It is associative whenever the wrapped operator is, so every engine computes a
+segmented scan with its ordinary rounds and block totals.
+*/
+template<class Op>
+struct SegmentedOp {
+    Op op;
+
+    explicit SegmentedOp(const Op& op) : op(op) {}
+
+    template<class T>
+    SegmentedValue<T> operator()(const SegmentedValue<T>& a, const SegmentedValue<T>& b) const {
+        SegmentedValue<T> result;
+        result.value = b.head ? b.value : op(a.value, b.value);
+        result.head = a.head | b.head;
+        return result;
+    }
+};
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,120 @@
+/*
+
+Range-sum queries on a prefix index file written by my-count --out-format=index, packed-index or compressed-index. Each
+query "l r" prints sum(A[l..r]) = B[r] - B[l-1] on a line of its own. The index is mapped, so a query reads the pages of two
+values instead of the whole output.
+
+    ./scan-query <index> [<l> <r>]...
+
+Without queries on the command line, they are read from stdin, one "l r" pair per line.
+
+*/
+
+#include <stdio.h>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <errno.h>
+
+#include "prefix-sum.h"
+
+using namespace std;
+using namespace psum;
+
+/*
+Handle errors and bad input
+param      String to be printed to user
+*/
+void errmsg(string msg) {
+    perror(msg.c_str());
+    exit(1);
+}
+
+/*
+Parse an index of the array
+param       text -- the decimal number
+            value -- Pointer receiving the number
+return      0 if valid, or -1 if the text is not a number
+*/
+int parseIndex(const char* text, size_t* value) {
+    const char* end = text + strlen(text);
+    from_chars_result result = from_chars(text, end, *value);
+    return (result.ec == errc() && result.ptr == end && end > text) ? 0 : -1;
+}
+
+/*
+Answer one query and print the sum
+param       index -- the index
+            l, r -- the range
+return      0 if successful, or -1 if the range is not valid
+*/
+template<class T>
+int answer(const PrefixIndex& index, size_t l, size_t r) {
+    T sum;
+    if(indexRangeSum(index, l, r, &sum) < 0) { return -1; }
+    char text[64];
+    to_chars_result end = to_chars(text, text + sizeof(text), sum);
+    *end.ptr = '\0';
+    puts(text);
+    return 0;
+}
+
+/*
+Answer the queries of the command line, or of stdin if there are none
+param       index -- the index
+            argCount -- number of total arguments from main
+            args -- arguments array from main
+*/
+template<class T>
+void runQueries(const PrefixIndex& index, int argCount, char* args[]) {
+    if(argCount > 2) {
+        for(int i = 2; i + 1 < argCount; i += 2) {
+            size_t l, r;
+            if(parseIndex(args[i], &l) < 0 || parseIndex(args[i + 1], &r) < 0 || answer<T>(index, l, r) < 0) {
+                errno = EINVAL;
+                errmsg("Invalid query.");
+            }
+        }
+        return;
+    }
+
+    size_t l, r;
+    while(cin >> l >> r) {
+        if(answer<T>(index, l, r) < 0) { errmsg("Invalid query."); }
+    }
+    if(!cin.eof()) {
+        errno = EINVAL;
+        errmsg("Invalid query.");
+    }
+}
+
+/* Start of main */
+int main(int argc, char* argv[]) {
+    // The index and pairs of bounds
+    if(argc < 2 || argc % 2 != 0) {
+        errno = EINVAL;
+        errmsg("Invalid arguments provided.");
+    }
+
+    PrefixIndex index;
+    if(openPrefixIndex(argv[1], &index) < 0) {
+        errmsg("Invalid index file.");
+    }
+
+    switch(index.header->type) {
+        case BINARY_INT32: runQueries<int32_t>(index, argc, argv); break;
+        case BINARY_UINT32: runQueries<uint32_t>(index, argc, argv); break;
+        case BINARY_INT64: runQueries<int64_t>(index, argc, argv); break;
+        case BINARY_UINT64: runQueries<uint64_t>(index, argc, argv); break;
+        case BINARY_FLOAT: runQueries<float>(index, argc, argv); break;
+        case BINARY_DOUBLE: runQueries<double>(index, argc, argv); break;
+        default:
+            errno = EINVAL;
+            errmsg("Invalid index file.");
+    }
+
+    closePrefixIndex(&index);
+    return 0;
+}
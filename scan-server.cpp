@@ -0,0 +1,76 @@
+/*
+
+Scan server: keeps M worker threads warm and scans the jobs of my-count --server=<socket> and other clients of
+scan-service.h.
+
+    ./scan-server <socket> <M> [options]
+
+*/
+
+#include <stdio.h>
+#include <cstdlib>
+#include <climits>
+#include <string>
+#include <errno.h>
+
+#include "prefix-sum.h"
+#include "scan-service.h"
+
+using namespace std;
+using namespace psum;
+
+/* 
+Handle errors and bad input
+param      String to be printed to user
+*/
+void errmsg(string msg) {
+    perror(msg.c_str());
+    exit(1);
+}
+
+/*
+Parse the optional arguments that follow the socket and M
+param       argCount -- number of total arguments from main
+            args -- arguments array from main
+            policy -- Pointer to the policy to be filled in
+return      -1 if an option is not recognized, 0 if valid
+*/
+int parseOptions(int argCount, char* args[], ExecPolicy* policy) {
+    for(int i = 3; i < argCount; i++) {
+        string arg = args[i];
+        if(arg == "--engine=hillis-steele") { policy->engine = HILLIS_STEELE; }
+        else if(arg == "--engine=work-efficient") { policy->engine = WORK_EFFICIENT; }
+        else if(arg == "--engine=tiled-hillis-steele") { policy->engine = TILED_HILLIS_STEELE; }
+        else if(arg == "--barrier=counter") { policy->barrier = COUNTER_BARRIER; }
+        else if(arg == "--barrier=sense") { policy->barrier = SENSE_BARRIER; }
+        else if(arg == "--barrier=dissemination") { policy->barrier = DISSEMINATION_BARRIER; }
+        else if(arg == "--barrier=futex") { policy->barrier = FUTEX_BARRIER; }
+        else if(arg == "--partition=static") { policy->partition = STATIC_PARTITION; }
+        else if(arg == "--partition=dynamic") { policy->partition = DYNAMIC_PARTITION; }
+        else if(arg == "--affinity=none") { policy->affinity = AFFINITY_NONE; }
+        else if(arg == "--affinity=compact") { policy->affinity = AFFINITY_COMPACT; }
+        else if(arg == "--affinity=scatter") { policy->affinity = AFFINITY_SCATTER; }
+        else { return -1; }
+    }
+    return 0;
+}
+
+/* Start of main */
+int main(int argc, char* argv[]) {
+    // The socket and a positive number of workers
+    string workers = argc >= 3 ? argv[2] : "";
+    if(argc < 3 || workers.empty() || workers.find_first_not_of("0123456789") != string::npos ||
+       strtoull(argv[2], NULL, 10) == 0 || strtoull(argv[2], NULL, 10) > INT_MAX) {
+        errmsg("Invalid arguments provided.");
+    }
+
+    ExecPolicy policy;
+    if(parseOptions(argc, argv, &policy) < 0) {
+        errmsg("Invalid option provided.");
+    }
+    policy.workers = atoi(argv[2]);
+
+    serveScans(argv[1], policy); // Only returns on failure
+    errmsg("Unable to serve scans.");
+    return 1;
+}
@@ -0,0 +1,340 @@
+/*
+
+Implementation of the scan server and client declared in scan-service.h
+
+*/
+
+#include "scan-service.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "scan-engine.h"
+#include "thread-pool.h"
+
+using namespace std;
+
+namespace psum {
+
+static const char JOB_MAGIC[4] = { 'P', 'S', 'J', 'B' };
+
+/*
+Fill in the address of a Unix socket
+param       path -- the path of the socket
+            address -- Pointer to the address
+return      0 if successful, or -1 with errno ENAMETOOLONG if the path does not fit
+*/
+static int socketAddress(const string& path, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(address->sun_path, path.c_str(), path.size());
+    return 0;
+}
+
+/*
+Send or receive a whole buffer on a socket
+param       fd -- the socket
+            buffer -- Pointer to the bytes
+            size -- the number of bytes
+            sending -- true to send, false to receive
+return      the number of bytes transferred, less than size only if the peer closed the connection, or -1 on error
+*/
+static long long transferSocket(int fd, char* buffer, size_t size, bool sending) {
+    size_t done = 0;
+    while(done < size) {
+        ssize_t n = sending ? send(fd, buffer + done, size - done, MSG_NOSIGNAL) : recv(fd, buffer + done, size - done, 0);
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n < 0) { return -1; }
+        if(n == 0) { break; }
+        done += n;
+    }
+    return (long long)done;
+}
+
+/*
+Receive the next job of a connection and the descriptor sent with it
+param       conn -- the connection
+            job -- Pointer to the job to be filled in
+            fd -- Pointer receiving the descriptor, or -1 if none came with the job
+return      1 if a job was received, 0 if the client closed the connection, or -1 on error
+*/
+static int receiveJob(int conn, ScanJob* job, int* fd) {
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec part;
+    part.iov_base = job;
+    part.iov_len = sizeof(*job);
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    *fd = -1;
+    ssize_t n;
+    do { n = recvmsg(conn, &message, MSG_CMSG_CLOEXEC); } while(n < 0 && errno == EINTR);
+    if(n <= 0) { return (int)n; }
+
+    for(struct cmsghdr* header = CMSG_FIRSTHDR(&message) ; header != NULL ; header = CMSG_NXTHDR(&message, header)) {
+        if(header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) { memcpy(fd, CMSG_DATA(header), sizeof(int)); }
+    }
+
+    // The descriptor comes with the first byte, the rest of a job cut short follows on its own
+    long long rest = transferSocket(conn, (char*)job + n, sizeof(*job) - n, false);
+    if(rest != (long long)(sizeof(*job) - n)) {
+        if(*fd >= 0) { close(*fd); }
+        return rest < 0 ? -1 : 0;
+    }
+    return 1;
+}
+
+/*
+Scan a job buffer in place with a compile-time operator
+param       data -- the elements
+            n -- the number of elements
+            op -- the operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 with errno EINVAL for xor of floating point elements or the errno of the scan
+*/
+template<class T>
+static int scanBuffer(T* data, size_t n, OpKind op, const ExecPolicy& policy) {
+    switch(op) {
+        case SUM_OP: return scan((const T*)data, data, n, false, T(), Plus(), policy);
+        case MAX_OP: return scan((const T*)data, data, n, false, T(), Max(), policy);
+        case MIN_OP: return scan((const T*)data, data, n, false, T(), Min(), policy);
+        case PRODUCT_OP: return scan((const T*)data, data, n, false, T(), Multiplies(), policy);
+        case XOR_OP:
+            if constexpr(numeric_limits<T>::is_integer) { return scan((const T*)data, data, n, false, T(), BitXor(), policy); }
+            break;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/* The mapping of the last job buffer of a connection, kept for the jobs that follow with the same buffer */
+struct BufferMap {
+    dev_t device;       // the inode of the memfd
+    ino_t inode;
+    void* data;         // NULL when nothing is mapped
+    size_t length;      // the whole buffer, which its seals keep at this size
+};
+
+/*
+Map the buffer of a job, or reuse the mapping of the connection if it is the same buffer
+param       fd -- the descriptor of the buffer
+            status -- its status from fstat
+            map -- Pointer to the mapping of the connection
+return      0 if successful, or -1 if it cannot be mapped
+*/
+static int mapJobBuffer(int fd, const struct stat& status, BufferMap* map) {
+    if(map->data != NULL && map->device == status.st_dev && map->inode == status.st_ino) { return 0; }
+    if(map->data != NULL) { munmap(map->data, map->length); }
+    map->data = NULL;
+    void* data = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(data == MAP_FAILED) { return -1; }
+    map->device = status.st_dev;
+    map->inode = status.st_ino;
+    map->data = data;
+    map->length = (size_t)status.st_size;
+    return 0;
+}
+
+/*
+Run one job
+param       job -- the job
+            fd -- the descriptor of its buffer, which must be sealed against shrinking and growing
+            policy -- how the scan is executed
+            jobLock -- held while the job uses the pool
+            map -- Pointer to the mapping of the connection
+return      0 if successful, or -1 if the job is not valid, its buffer cannot be mapped or the scan failed
+*/
+static int runJob(const ScanJob& job, int fd, const ExecPolicy& policy, mutex* jobLock, BufferMap* map) {
+    size_t expected = 0;
+    switch(job.type) {
+        case BINARY_INT32: case BINARY_UINT32: case BINARY_FLOAT: expected = 4; break;
+        case BINARY_INT64: case BINARY_UINT64: case BINARY_DOUBLE: expected = 8; break;
+    }
+    // A buffer the client could truncate while it is scanned would kill the server with SIGBUS
+    const int seals = F_SEAL_SHRINK | F_SEAL_GROW;
+    int sealed = fd < 0 ? -1 : fcntl(fd, F_GET_SEALS);
+    struct stat status;
+    if(memcmp(job.magic, JOB_MAGIC, sizeof(JOB_MAGIC)) != 0 || job.elementSize != expected || job.op > PRODUCT_OP || sealed < 0 ||
+       (sealed & seals) != seals || fstat(fd, &status) < 0 || job.count > (uint64_t)status.st_size / expected) {
+        errno = EINVAL;
+        return -1;
+    }
+    if(job.count == 0) { return 0; }
+    if(mapJobBuffer(fd, status, map) < 0) { return -1; }
+    void* data = map->data;
+
+    int result;
+    {
+        lock_guard<mutex> guard(*jobLock); // The pool runs one task at a time
+        OpKind op = (OpKind)job.op;
+        switch(job.type) {
+            case BINARY_INT32: result = scanBuffer((int32_t*)data, job.count, op, policy); break;
+            case BINARY_UINT32: result = scanBuffer((uint32_t*)data, job.count, op, policy); break;
+            case BINARY_INT64: result = scanBuffer((int64_t*)data, job.count, op, policy); break;
+            case BINARY_UINT64: result = scanBuffer((uint64_t*)data, job.count, op, policy); break;
+            case BINARY_FLOAT: result = scanBuffer((float*)data, job.count, op, policy); break;
+            default: result = scanBuffer((double*)data, job.count, op, policy); break;
+        }
+    }
+    return result;
+}
+
+/*
+Serve the jobs of one connection until the client closes it
+param       conn -- the connection, closed here
+            policy -- how the jobs are scanned
+            jobLock -- shared by all connections
+*/
+static void serveConnection(int conn, const ExecPolicy* policy, mutex* jobLock) {
+    BufferMap map;
+    memset(&map, 0, sizeof(map)); // Nothing mapped
+    for(;;) {
+        ScanJob job;
+        int fd;
+        if(receiveJob(conn, &job, &fd) <= 0) { break; }
+
+        ScanResult reply;
+        reply.status = runJob(job, fd, *policy, jobLock, &map);
+        reply.error = reply.status < 0 ? errno : 0;
+        if(fd >= 0) { close(fd); }
+        if(transferSocket(conn, (char*)&reply, sizeof(reply), true) != (long long)sizeof(reply)) { break; }
+    }
+    if(map.data != NULL) { munmap(map.data, map.length); }
+    close(conn);
+}
+
+int serveScans(string path, const ExecPolicy& policy) {
+    struct sockaddr_un address;
+    if(socketAddress(path, &address) < 0) { return -1; }
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener < 0) { return -1; }
+    unlink(path.c_str()); // A socket left by an earlier server
+    if(bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+        int error = errno;
+        close(listener);
+        errno = error;
+        return -1;
+    }
+
+    // The pool and the policy live as long as the server, connections only borrow them
+    ExecPolicy* jobs = new ExecPolicy(policy);
+    jobs->backend = THREAD_BACKEND;
+    jobs->workers = policy.workers < 1 ? 1 : policy.workers;
+    jobs->pool = new ThreadPool(jobs->workers);
+    mutex* jobLock = new mutex();
+
+    for(;;) {
+        int conn = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if(conn < 0 && (errno == EINTR || errno == ECONNABORTED)) { continue; }
+        if(conn < 0) { break; }
+        thread(serveConnection, conn, jobs, jobLock).detach();
+    }
+
+    int error = errno;
+    close(listener);
+    errno = error;
+    return -1;
+}
+
+int connectScanServer(string path) {
+    struct sockaddr_un address;
+    if(socketAddress(path, &address) < 0) { return -1; }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) { return -1; }
+    if(connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+void* createJobBuffer(size_t size, int* fd) {
+    *fd = memfd_create("psum-job", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(*fd < 0) { return NULL; }
+    size_t length = size > 0 ? size : 1;
+    void* buffer = MAP_FAILED;
+    // Sealed at its size, so the server may map it without fearing a truncation
+    if(ftruncate(*fd, length) == 0 && fcntl(*fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) == 0) {
+        buffer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    }
+    if(buffer == MAP_FAILED) {
+        int error = errno;
+        close(*fd);
+        *fd = -1;
+        errno = error;
+        return NULL;
+    }
+    return buffer;
+}
+
+void releaseJobBuffer(void* buffer, size_t size, int fd) {
+    if(buffer == NULL) { return; }
+    munmap(buffer, size > 0 ? size : 1);
+    close(fd);
+}
+
+int submitScan(int server, int fd, BinaryType type, size_t elementSize, OpKind op, size_t count) {
+    ScanJob job;
+    memcpy(job.magic, JOB_MAGIC, sizeof(JOB_MAGIC));
+    job.type = type;
+    job.elementSize = (uint32_t)elementSize;
+    job.op = op;
+    job.count = count;
+
+    /* The job and the descriptor of its buffer in one message */
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec part;
+    part.iov_base = &job;
+    part.iov_len = sizeof(job);
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+    ssize_t n;
+    do { n = sendmsg(server, &message, MSG_NOSIGNAL); } while(n < 0 && errno == EINTR);
+    if(n < 0) { return -1; }
+    if(transferSocket(server, (char*)&job + n, sizeof(job) - n, true) != (long long)(sizeof(job) - n)) { return -1; }
+
+    ScanResult reply;
+    long long got = transferSocket(server, (char*)&reply, sizeof(reply), false);
+    if(got < 0) { return -1; }
+    if(got != (long long)sizeof(reply)) {
+        errno = ECONNRESET;
+        return -1;
+    }
+    if(reply.status < 0) {
+        errno = reply.error;
+        return -1;
+    }
+    return 0;
+}
+
+} // namespace psum
@@ -0,0 +1,95 @@
+/*
+
+Scan server and its client. The server keeps a warm thread pool and takes scan jobs over a Unix socket, so a job costs the
+scan and a round trip instead of starting workers and setting up shared memory every time.
+
+The data of a job is never copied through the socket. The client fills a job buffer, a memfd it has mapped, and sends the
+descriptor with the job; the server maps the same pages, scans them in place and replies. The result is then already in
+the client's mapping. The buffer is sealed against shrinking and growing, which the server checks, so the client cannot
+truncate it under the scan. The server keeps the mapping of the last buffer of each connection, and the jobs that follow
+in the same buffer are scanned without mapping it again.
+
+    client                                          server
+    createJobBuffer, fill it in
+    ScanJob + descriptor (SCM_RIGHTS)   ------->    map unless mapped already, scan in place with the pool
+                                        <-------    ScanResult
+
+A connection can carry any number of jobs, one at a time. Jobs of different connections take turns on the pool.
+
+*/
+
+#ifndef SCAN_SERVICE_H
+#define SCAN_SERVICE_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+#include "binary-io.h"
+#include "exec-policy.h"
+#include "scan-ops.h"
+
+namespace psum {
+
+/* A job, sent together with the descriptor of its buffer */
+struct ScanJob {
+    char magic[4];          // "PSJB"
+    uint32_t type;          // BinaryType of the elements
+    uint32_t elementSize;   // size of an element in bytes
+    uint32_t op;            // OpKind of the inclusive scan
+    uint64_t count;         // number of elements at the start of the buffer
+};
+
+/* The reply to a job */
+struct ScanResult {
+    int32_t status;         // 0 if the buffer holds the scan, -1 if not
+    int32_t error;          // errno of a failed job
+};
+
+/*
+Run a scan server until it fails. Jobs run with the given policy on a pool of policy.workers threads kept for the lifetime
+of the server. A stale socket file at the path is replaced.
+param       path -- path of the Unix socket
+            policy -- how the jobs are scanned, the backend is always threads
+return      -1 if the socket cannot be created or accepting connections fails
+*/
+int serveScans(std::string path, const ExecPolicy& policy);
+
+/*
+Connect to a scan server
+param       path -- path of the server's socket
+return      the connection, or -1 if the server cannot be reached
+*/
+int connectScanServer(std::string path);
+
+/*
+Create a job buffer, a memfd sealed at its size and mapped shared so that the server sees the same pages
+param       size -- the size in bytes
+            fd -- Pointer receiving the descriptor to be sent with jobs
+return      the mapping, or NULL if it cannot be created
+*/
+void* createJobBuffer(size_t size, int* fd);
+
+/*
+Release a buffer from createJobBuffer
+param       buffer -- the mapping, nothing happens if it is NULL
+            size -- the size given to createJobBuffer
+            fd -- the descriptor
+*/
+void releaseJobBuffer(void* buffer, size_t size, int fd);
+
+/*
+Run a job on the server and wait for it to finish. The buffer then holds the inclusive scan of its first count elements.
+param       server -- the connection from connectScanServer
+            fd -- the descriptor of the job buffer
+            type -- the element type
+            elementSize -- the size of an element in bytes
+            op -- the operator
+            count -- the number of elements
+return      0 if successful, or -1 with the server's errno if the job failed or errno of the connection if it broke
+*/
+int submitScan(int server, int fd, BinaryType type, size_t elementSize, OpKind op, size_t count);
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,99 @@
+/*
+
+Segmented scan: many independent scans packed back to back in one array, computed by a single parallel scan. A head flag
+marks the first element of each segment and the scan starts again there, so running totals per user or per key need
+neither one run per segment nor a split input.
+
+Each element is paired with its head flag and the pairs are scanned with SegmentedOp (scan-ops.h). The rounds, block totals
+and carries of the engines stay as they are, the operator stops them at the next head.
+
+*/
+
+#ifndef SEGMENTED_SCAN_H
+#define SEGMENTED_SCAN_H
+
+#include <cstddef>
+#include <cstring>
+#include <errno.h>
+
+#include "exec-policy.h"
+#include "scan-engine.h"
+#include "scan-ops.h"
+#include "shared-memory.h"
+
+namespace psum {
+
+/*
+Turn the start offsets of segments into head flags
+param       offsets -- the index of the first element of each segment, in ascending order
+            segments -- the number of offsets
+            n -- the number of elements
+            heads -- Pointer to the n flags to be filled in, 1 where a segment starts
+return      0 if successful, or -1 with errno EINVAL if the offsets are not ascending or out of range
+*/
+inline int headsFromOffsets(const size_t* offsets, size_t segments, size_t n, unsigned char* heads) {
+    memset(heads, 0, n);
+    for(size_t s = 0 ; s < segments ; s++) {
+        if(offsets[s] >= n || (s > 0 && offsets[s] <= offsets[s - 1])) {
+            errno = EINVAL;
+            return -1;
+        }
+        heads[offsets[s]] = 1;
+    }
+    return 0;
+}
+
+/*
+Inclusive segmented scan: out[i] = in[h] op ... op in[i], where h is the last head at or before i. The first element always
+starts a segment.
+param       in -- the input array
+            heads -- n flags, nonzero where a segment starts
+            out -- the output array, may be the same as in
+            n -- the number of elements
+            op -- the associative operator
+            policy -- how the scan is executed
+return      0 if successful, or -1 if memory or workers could not be allocated, or a forked worker died
+*/
+template<class T, class Op>
+int segmentedScan(const T* in, const unsigned char* heads, T* out, size_t n, Op op, const ExecPolicy& policy = ExecPolicy()) {
+    if(n == 0) { return 0; }
+
+    // The pairs are scanned in place, by forked workers if the policy says so
+    bool shared = (policy.backend == PROCESS_BACKEND);
+    SegmentedValue<T>* pairs = (SegmentedValue<T>*)allocateMemory(shared, sizeof(SegmentedValue<T>)*n);
+    if(pairs == NULL) { return -1; }
+
+    // Pairing and unpairing run on threads over the chunks of a static partition, which works for any memory
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if((size_t)workers > n) { workers = (int)n; }
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+
+    int result = runWorkers(threads, workers, [=](int j) {
+        size_t chunkStart, chunkEnd;
+        getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+        for(size_t k = chunkStart ; k < chunkEnd ; k++) {
+            pairs[k].value = in[k];
+            pairs[k].head = (heads[k] != 0);
+        }
+    });
+    if(result == 0) {
+        result = scan((const SegmentedValue<T>*)pairs, pairs, n, false, SegmentedValue<T>(), SegmentedOp<Op>(op), policy);
+    }
+    if(result == 0) {
+        result = runWorkers(threads, workers, [=](int j) {
+            size_t chunkStart, chunkEnd;
+            getChunkRange(j, workers, n, &chunkStart, &chunkEnd);
+            for(size_t k = chunkStart ; k < chunkEnd ; k++) { out[k] = pairs[k].value; }
+        });
+    }
+
+    int error = errno; // Releasing must not change the reported error
+    releaseMemory(shared, pairs);
+    errno = error;
+    return result;
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,325 @@
+/*
+
+Implementation of the shared memory helpers declared in shared-memory.h
+
+*/
+
+#include "shared-memory.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace psum {
+
+/* A segment created by allocateShared, or memory from registerShared */
+struct Segment {
+    bool owned;     // false for registered memory
+    char* ptr;
+    size_t size;    // the whole mapping of a segment
+};
+
+/* A private huge page mapping from allocateMemory, released with munmap instead of free */
+struct Mapping {
+    char* ptr;
+    size_t size;
+};
+
+static mutex segmentsLock;
+static vector<Segment> segments; // Segments currently attached
+static vector<Mapping> mappings; // Private mappings currently in use, under segmentsLock as well
+static vector<Segment> pooled;   // Released segments kept for reuse, under segmentsLock as well
+static size_t pooledBytes = 0;
+static size_t poolLimit = 0;
+
+static PageSize selectedPages = NORMAL_PAGES;
+static once_flag hugeWarning;
+
+void setPageSize(PageSize pages) {
+    selectedPages = pages;
+}
+
+PageSize pageSize() {
+    return selectedPages;
+}
+
+/*
+Read the huge page size from the kernel
+return      the size in bytes, or 2 MiB if the kernel does not say
+*/
+static size_t readHugePageSize() {
+    size_t size = 2 << 20;
+    FILE* file = fopen("/proc/meminfo", "r");
+    if(file == NULL) { return size; }
+    char line[256];
+    while(fgets(line, sizeof(line), file) != NULL) {
+        unsigned long kilobytes;
+        if(sscanf(line, "Hugepagesize: %lu kB", &kilobytes) == 1) {
+            size = kilobytes << 10;
+            break;
+        }
+    }
+    fclose(file);
+    return size;
+}
+
+size_t hugePageSize() {
+    static size_t size = readHugePageSize();
+    return size;
+}
+
+/*
+Report once that huge pages were asked for but could not be had
+param       error -- errno of the failed allocation
+*/
+static void warnNoHugePages(int error) {
+    call_once(hugeWarning, [error]() {
+        fprintf(stderr, "Huge pages are not available (%s), using normal pages. See /proc/sys/vm/nr_hugepages.\n", strerror(error));
+    });
+}
+
+/*
+Determine if a buffer should get huge pages: they were selected and it fills at least one
+param       size -- the number of bytes
+return      the size rounded up to whole huge pages, or 0 for normal pages
+*/
+static size_t hugeLength(size_t size) {
+    if(selectedPages != HUGE_PAGES || size < hugePageSize()) { return 0; }
+    return (size + hugePageSize() - 1) / hugePageSize() * hugePageSize();
+}
+
+/*
+Map shared memory that the kernel frees as soon as no process maps it any more, however the processes end. It comes from a
+memfd that is closed at once, or is an anonymous shared mapping where the kernel has no memfd_create.
+param       length -- the number of bytes, whole huge pages for huge pages
+            huge -- true for huge pages
+            populate -- true to fault every page in now
+return      a pointer to the memory, or NULL if it could not be mapped
+*/
+static void* mapShared(size_t length, bool huge, bool populate) {
+    int flags = MAP_SHARED | (populate ? MAP_POPULATE : 0);
+    void* ptr = MAP_FAILED;
+    int fd = memfd_create("psum-shared", MFD_CLOEXEC | (huge ? MFD_HUGETLB : 0));
+    if(fd >= 0) {
+        if(ftruncate(fd, (off_t)length) == 0) { ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, fd, 0); }
+        int error = errno;
+        close(fd); // The mapping keeps the memory
+        errno = error;
+    }
+    else if(errno == ENOSYS) {
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, flags | MAP_ANONYMOUS | (huge ? MAP_HUGETLB : 0), -1, 0);
+    }
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+/*
+Create a segment, of huge pages if they were selected and it fills one
+param       size -- the number of bytes needed
+            populate -- true to fault every page in now
+            segment -- Pointer to the segment to be filled in
+return      0 if successful, or -1 if the memory could not be mapped
+*/
+static int createSegment(size_t size, bool populate, Segment* segment) {
+    size_t huge = hugeLength(size);
+    void* ptr = NULL;
+    if(huge > 0) {
+        ptr = mapShared(huge, true, populate);
+        if(ptr == NULL) { warnNoHugePages(errno); }
+    }
+    size_t length = huge;
+    if(ptr == NULL) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        length = (size + page - 1) / page * page;
+        ptr = mapShared(length, false, populate);
+    }
+    if(ptr == NULL) { return -1; }
+    segment->owned = true;
+    segment->ptr = (char*)ptr;
+    segment->size = length;
+    return 0;
+}
+
+/*
+Unmap released segments until the pool holds at most its limit, under segmentsLock
+*/
+static void trimPool() {
+    while(pooledBytes > poolLimit) {
+        munmap(pooled.back().ptr, pooled.back().size);
+        pooledBytes -= pooled.back().size;
+        pooled.pop_back();
+    }
+}
+
+void* allocateShared(size_t size) {
+    if(size == 0) { size = 1; }
+    {
+        // The smallest released segment that fits, unless it would waste more than the request
+        lock_guard<mutex> guard(segmentsLock);
+        size_t best = pooled.size();
+        for(size_t i = 0; i < pooled.size(); i++) {
+            if(pooled[i].size >= size && pooled[i].size / 2 <= size && (best == pooled.size() || pooled[i].size < pooled[best].size)) {
+                best = i;
+            }
+        }
+        if(best < pooled.size()) {
+            Segment segment = pooled[best];
+            pooled.erase(pooled.begin() + best);
+            pooledBytes -= segment.size;
+            segments.push_back(segment);
+            return segment.ptr;
+        }
+    }
+
+    // With a pool, segments are faulted in once when they are created instead of on their first use by every job
+    Segment segment;
+    if(createSegment(size, poolLimit > 0, &segment) < 0) { return NULL; }
+    lock_guard<mutex> guard(segmentsLock);
+    segments.push_back(segment);
+    return segment.ptr;
+}
+
+void freeShared(void* ptr) {
+    if(ptr == NULL) { return; }
+
+    lock_guard<mutex> guard(segmentsLock);
+    for(size_t i = 0; i < segments.size(); i++) {
+        if(segments[i].ptr == ptr && segments[i].owned) {
+            Segment segment = segments[i];
+            segments.erase(segments.begin() + i);
+            if(pooledBytes + segment.size <= poolLimit) {
+                pooled.push_back(segment);
+                pooledBytes += segment.size;
+            }
+            else { munmap(ptr, segment.size); }
+            return;
+        }
+    }
+}
+
+void setSharedPool(size_t bytes) {
+    lock_guard<mutex> guard(segmentsLock);
+    poolLimit = bytes;
+    trimPool();
+}
+
+int parseSharedPool(const char* bytes) {
+    // Only digits, strtoull would accept a sign and leading spaces
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(bytes, &end, 10);
+    if(*bytes < '0' || *bytes > '9' || *end != '\0' || errno == ERANGE || value > SIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    setSharedPool((size_t)value);
+    return 0;
+}
+
+int reserveShared(size_t size) {
+    Segment segment;
+    if(createSegment(size, true, &segment) < 0) { return -1; }
+    lock_guard<mutex> guard(segmentsLock);
+    pooled.push_back(segment);
+    pooledBytes += segment.size;
+    trimPool(); // The newest segment goes first if the pool is full
+    return 0;
+}
+
+/*
+Map private memory of huge pages, or of normal pages that transparent huge pages may merge if none are reserved
+param       size -- the number of bytes, rounded to whole huge pages
+return      a pointer to the memory, or NULL if it could not be mapped
+*/
+static void* mapHuge(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(ptr == MAP_FAILED) {
+        warnNoHugePages(errno);
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr == MAP_FAILED) { return NULL; }
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+
+    Mapping mapping = { (char*)ptr, size };
+    lock_guard<mutex> guard(segmentsLock);
+    mappings.push_back(mapping);
+    return ptr;
+}
+
+void* allocateMemory(bool shared, size_t size) {
+    if(size == 0) { size = 1; } // Neither mmap nor malloc are asked for nothing
+    if(shared) { return allocateShared(size); }
+
+    size_t huge = hugeLength(size);
+    return huge > 0 ? mapHuge(huge) : malloc(size);
+}
+
+void releaseMemory(bool shared, void* ptr) {
+    if(shared) {
+        freeShared(ptr);
+        return;
+    }
+    if(ptr == NULL) { return; }
+
+    {
+        lock_guard<mutex> guard(segmentsLock);
+        for(size_t i = 0; i < mappings.size(); i++) {
+            if(mappings[i].ptr == ptr) {
+                munmap(ptr, mappings[i].size);
+                mappings.erase(mappings.begin() + i);
+                return;
+            }
+        }
+    }
+    free(ptr);
+}
+
+SharedArena::~SharedArena() {
+    for(size_t i = buffers.size(); i > 0; i--) {
+        releaseMemory(buffers[i - 1].second, buffers[i - 1].first);
+    }
+}
+
+void* SharedArena::allocate(bool shared, size_t size) {
+    void* ptr = allocateMemory(shared, size);
+    if(ptr != NULL) { buffers.push_back(make_pair(ptr, shared)); }
+    return ptr;
+}
+
+void registerShared(void* ptr, size_t size) {
+    Segment segment = { false, (char*)ptr, size };
+    lock_guard<mutex> guard(segmentsLock);
+    segments.push_back(segment);
+}
+
+void unregisterShared(void* ptr) {
+    lock_guard<mutex> guard(segmentsLock);
+    for(size_t i = 0; i < segments.size(); i++) {
+        if(segments[i].ptr == ptr && !segments[i].owned) {
+            segments.erase(segments.begin() + i);
+            return;
+        }
+    }
+}
+
+bool isShared(const void* ptr, size_t size) {
+    const char* start = (const char*)ptr;
+
+    lock_guard<mutex> guard(segmentsLock);
+    for(size_t i = 0; i < segments.size(); i++) {
+        if(start >= segments[i].ptr && start + size <= segments[i].ptr + segments[i].size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace psum
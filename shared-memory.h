@@ -0,0 +1,141 @@
+/*
+
+Working buffers for the process backend. Forked workers only see each other's writes in memory shared between processes, so
+everything a worker writes lives in a shared segment or a shared mapping. Both are remembered, so the scan can tell when the
+caller already handed it a shared output buffer and write into it directly instead of staging the result.
+
+A segment is a shared mapping of a memfd that is closed as soon as it is mapped. The kernel frees it when the last process
+unmaps it, so it cannot outlive the run when a worker crashes or the parent is killed, as a System V segment would. Released
+segments can be kept in a pool with setSharedPool and handed out again, with their pages already faulted in, to the
+scans that follow.
+
+*/
+
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace psum {
+
+/* Pages backing the working buffers */
+enum PageSize { NORMAL_PAGES, HUGE_PAGES };
+
+/*
+Select the pages of the buffers allocated from now on. With huge pages, buffers of at least one huge page use MFD_HUGETLB
+segments or MAP_HUGETLB mappings, and fall back to normal pages with a message on stderr if none are reserved. Private
+buffers then ask for transparent huge pages instead.
+param       pages -- the page size
+*/
+void setPageSize(PageSize pages);
+
+/*
+Get the pages selected with setPageSize
+return      the page size, NORMAL_PAGES unless selected
+*/
+PageSize pageSize();
+
+/*
+Get the size of a huge page
+return      the size in bytes from /proc/meminfo, or 2 MiB
+*/
+size_t hugePageSize();
+
+/*
+Create a shared memory segment, or take one from the pool. A new segment is zeroed, one from the pool holds what its last
+user left in it.
+param       size -- the number of bytes needed
+return      a pointer to the segment, or NULL if it could not be created
+*/
+void* allocateShared(size_t size);
+
+/*
+Unmap a segment from allocateShared, or return it to the pool if it has room
+param       ptr -- Pointer returned by allocateShared, may be NULL
+*/
+void freeShared(void* ptr);
+
+/*
+Keep released segments for reuse. Segments created while the pool is on are faulted in at once, so a scan that reuses one
+pays neither the system calls nor the page faults of fresh memory. A segment is reused for requests of at least half its size.
+param       bytes -- the most memory kept in the pool, 0 to unmap the pooled segments and release every segment again (default)
+*/
+void setSharedPool(size_t bytes);
+
+/*
+Set the limit of the pool from a command line value, as the --shared-pool option of the programs does
+param       bytes -- the most memory kept in the pool, in decimal
+return      0 if successful, or -1 with errno EINVAL if it is not a number of bytes, which leaves the pool as it was
+*/
+int parseSharedPool(const char* bytes);
+
+/*
+Create a segment faulted in and put it in the pool, ahead of the scans that will use it
+param       size -- the number of bytes
+return      0 if successful, or -1 if it could not be created. A segment beyond the limit of the pool is unmapped again.
+*/
+int reserveShared(size_t size);
+
+/*
+Record memory that is shared between processes by other means, such as a shared file mapping, so isShared accepts it
+param       ptr -- Pointer to the first byte of the memory
+            size -- the number of bytes
+*/
+void registerShared(void* ptr, size_t size);
+
+/*
+Forget memory recorded with registerShared, before it is unmapped
+param       ptr -- Pointer given to registerShared
+*/
+void unregisterShared(void* ptr);
+
+/*
+Determine if a range lies inside a single segment from allocateShared or registerShared
+param       ptr -- Pointer to the first byte of the range
+            size -- the number of bytes in the range
+return      true if forked workers can write the whole range
+*/
+bool isShared(const void* ptr, size_t size);
+
+/*
+Allocate a working buffer, shared between processes or on the heap
+param       shared -- true if forked workers write the buffer
+            size -- the number of bytes needed
+return      a pointer to the buffer, or NULL if it could not be allocated
+*/
+void* allocateMemory(bool shared, size_t size);
+
+/*
+Release a buffer from allocateMemory
+param       shared -- the value given to allocateMemory
+            ptr -- Pointer to the buffer, may be NULL
+*/
+void releaseMemory(bool shared, void* ptr);
+
+/*
+Working buffers from allocateMemory that are released together when the arena is destroyed, on every way out of the scope
+that holds it
+*/
+class SharedArena {
+public:
+    SharedArena() {}
+    ~SharedArena();
+    SharedArena(const SharedArena&) = delete;
+    SharedArena& operator=(const SharedArena&) = delete;
+
+    /*
+    Allocate a buffer owned by the arena
+    param       shared, size -- as for allocateMemory
+    return      a pointer to the buffer, or NULL if it could not be allocated
+    */
+    void* allocate(bool shared, size_t size);
+
+private:
+    std::vector<std::pair<void*, bool> > buffers;   // every buffer and whether it is shared
+};
+
+} // namespace psum
+
+#endif
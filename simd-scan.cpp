@@ -0,0 +1,247 @@
+/*
+
+Implementation of the vectorized block kernels declared in simd-scan.h. The x86 kernels are compiled for their instruction
+set with target attributes, so the rest of the library does not need -mavx2 and still runs on older processors.
+
+*/
+
+#include "simd-scan.h"
+#include "scan-ops.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PSUM_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace psum {
+
+// Resolved on first use, which may be by several threads at once
+static std::atomic<SimdLevel> selected(SIMD_AUTO);
+
+/*
+Determine the best kernel the processor supports
+return      the kernel
+*/
+static SimdLevel detectSimd() {
+#ifdef PSUM_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) { return SIMD_AVX512; }
+    if(__builtin_cpu_supports("avx2")) { return SIMD_AVX2; }
+#endif
+#if defined(__aarch64__)
+    return SIMD_NEON; // Part of the base instruction set
+#endif
+    return SIMD_SCALAR;
+}
+
+int setSimdLevel(SimdLevel level) {
+    SimdLevel best = detectSimd();
+    if(level == SIMD_AUTO) { level = best; }
+
+    bool supported = (level == SIMD_SCALAR || level == best);
+    if(best == SIMD_AVX512 && level == SIMD_AVX2) { supported = true; }
+    if(!supported) { return -1; }
+
+    selected.store(level, std::memory_order_relaxed);
+    return 0;
+}
+
+SimdLevel simdLevel() {
+    SimdLevel level = selected.load(std::memory_order_relaxed);
+    if(level == SIMD_AUTO) {
+        // Unless setSimdLevel chose a kernel meanwhile
+        SimdLevel expected = SIMD_AUTO;
+        level = detectSimd();
+        if(!selected.compare_exchange_strong(expected, level, std::memory_order_relaxed)) { level = expected; }
+    }
+    return level;
+}
+
+const char* simdName(SimdLevel level) {
+    switch(level) {
+        case SIMD_AUTO: return "auto";
+        case SIMD_SCALAR: return "scalar";
+        case SIMD_AVX2: return "avx2";
+        case SIMD_AVX512: return "avx512";
+        case SIMD_NEON: return "neon";
+    }
+    return "unknown";
+}
+
+/*
+Scalar kernel, used as the fallback and for the elements after the last full vector
+param       in, out, n, carry -- as for scanBlockSimd
+return      the last output element, or carry if n is 0
+*/
+template<class T>
+static T scanBlockScalar(const T* in, T* out, size_t n, T carry) {
+    for(size_t k = 0 ; k < n ; k++) {
+        carry = wrappingAdd(carry, in[k]);
+        out[k] = carry;
+    }
+    return carry;
+}
+
+#ifdef PSUM_X86
+
+/* AVX2, 8 lanes of int32 */
+__attribute__((target("avx2")))
+static int32_t scanBlockAvx2(const int32_t* in, int32_t* out, size_t n, int32_t carry) {
+    __m256i sum = _mm256_set1_epi32(carry);
+    __m256i lastLane = _mm256_set1_epi32(7);
+    __m256i lowLast = _mm256_set1_epi32(3);
+    size_t k = 0;
+    for( ; k + 8 <= n ; k += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + k));
+        // Scan each 128-bit half, the byte shifts do not cross halves
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        // Add the total of the low half to the high half
+        __m256i low = _mm256_permutevar8x32_epi32(x, lowLast);
+        x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(), low, 0xF0));
+        x = _mm256_add_epi32(x, sum);
+        _mm256_storeu_si256((__m256i*)(out + k), x);
+        sum = _mm256_permutevar8x32_epi32(x, lastLane);
+    }
+    carry = _mm_cvtsi128_si32(_mm256_castsi256_si128(sum));
+    return scanBlockScalar(in + k, out + k, n - k, carry);
+}
+
+/* AVX2, 4 lanes of int64 */
+__attribute__((target("avx2")))
+static int64_t scanBlockAvx2(const int64_t* in, int64_t* out, size_t n, int64_t carry) {
+    __m256i sum = _mm256_set1_epi64x(carry);
+    size_t k = 0;
+    for( ; k + 4 <= n ; k += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + k));
+        x = _mm256_add_epi64(x, _mm256_slli_si256(x, 8));
+        __m256i low = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 1, 1, 1));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_setzero_si256(), low, 0xF0));
+        x = _mm256_add_epi64(x, sum);
+        _mm256_storeu_si256((__m256i*)(out + k), x);
+        sum = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    carry = _mm_cvtsi128_si64(_mm256_castsi256_si128(sum));
+    return scanBlockScalar(in + k, out + k, n - k, carry);
+}
+
+/*
+AVX-512, 16 lanes of int32. Each step adds the vector shifted up by 1, 2, 4 and 8 lanes with zeros shifted in. Only the
+zero-masking permutes are used, the unmasked ones trip a false uninitialized warning in GCC's headers.
+*/
+__attribute__((target("avx512f")))
+static int32_t scanBlockAvx512(const int32_t* in, int32_t* out, size_t n, int32_t carry) {
+    __m512i sum = _mm512_set1_epi32(carry);
+    __m512i lastLane = _mm512_set1_epi32(15);
+    __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i shift1 = _mm512_sub_epi32(lanes, _mm512_set1_epi32(1));
+    __m512i shift2 = _mm512_sub_epi32(lanes, _mm512_set1_epi32(2));
+    __m512i shift4 = _mm512_sub_epi32(lanes, _mm512_set1_epi32(4));
+    __m512i shift8 = _mm512_sub_epi32(lanes, _mm512_set1_epi32(8));
+    size_t k = 0;
+    for( ; k + 16 <= n ; k += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + k));
+        x = _mm512_add_epi32(x, _mm512_maskz_permutexvar_epi32((__mmask16)0xFFFE, shift1, x));
+        x = _mm512_add_epi32(x, _mm512_maskz_permutexvar_epi32((__mmask16)0xFFFC, shift2, x));
+        x = _mm512_add_epi32(x, _mm512_maskz_permutexvar_epi32((__mmask16)0xFFF0, shift4, x));
+        x = _mm512_add_epi32(x, _mm512_maskz_permutexvar_epi32((__mmask16)0xFF00, shift8, x));
+        x = _mm512_add_epi32(x, sum);
+        _mm512_storeu_si512((void*)(out + k), x);
+        sum = _mm512_maskz_permutexvar_epi32((__mmask16)0xFFFF, lastLane, x);
+    }
+    if(k > 0) { carry = out[k - 1]; }
+    return scanBlockScalar(in + k, out + k, n - k, carry);
+}
+
+/* AVX-512, 8 lanes of int64 */
+__attribute__((target("avx512f")))
+static int64_t scanBlockAvx512(const int64_t* in, int64_t* out, size_t n, int64_t carry) {
+    __m512i sum = _mm512_set1_epi64(carry);
+    __m512i lastLane = _mm512_set1_epi64(7);
+    __m512i lanes = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    __m512i shift1 = _mm512_sub_epi64(lanes, _mm512_set1_epi64(1));
+    __m512i shift2 = _mm512_sub_epi64(lanes, _mm512_set1_epi64(2));
+    __m512i shift4 = _mm512_sub_epi64(lanes, _mm512_set1_epi64(4));
+    size_t k = 0;
+    for( ; k + 8 <= n ; k += 8) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + k));
+        x = _mm512_add_epi64(x, _mm512_maskz_permutexvar_epi64((__mmask8)0xFE, shift1, x));
+        x = _mm512_add_epi64(x, _mm512_maskz_permutexvar_epi64((__mmask8)0xFC, shift2, x));
+        x = _mm512_add_epi64(x, _mm512_maskz_permutexvar_epi64((__mmask8)0xF0, shift4, x));
+        x = _mm512_add_epi64(x, sum);
+        _mm512_storeu_si512((void*)(out + k), x);
+        sum = _mm512_maskz_permutexvar_epi64((__mmask8)0xFF, lastLane, x);
+    }
+    if(k > 0) { carry = out[k - 1]; }
+    return scanBlockScalar(in + k, out + k, n - k, carry);
+}
+
+#endif
+
+#if defined(__aarch64__)
+
+/* NEON, 4 lanes of int32 */
+static int32_t scanBlockNeon(const int32_t* in, int32_t* out, size_t n, int32_t carry) {
+    int32x4_t sum = vdupq_n_s32(carry);
+    int32x4_t zero = vdupq_n_s32(0);
+    size_t k = 0;
+    for( ; k + 4 <= n ; k += 4) {
+        int32x4_t x = vld1q_s32(in + k);
+        x = vaddq_s32(x, vextq_s32(zero, x, 3));
+        x = vaddq_s32(x, vextq_s32(zero, x, 2));
+        x = vaddq_s32(x, sum);
+        vst1q_s32(out + k, x);
+        sum = vdupq_laneq_s32(x, 3);
+    }
+    return scanBlockScalar(in + k, out + k, n - k, vgetq_lane_s32(sum, 0));
+}
+
+/* NEON, 2 lanes of int64 */
+static int64_t scanBlockNeon(const int64_t* in, int64_t* out, size_t n, int64_t carry) {
+    int64x2_t sum = vdupq_n_s64(carry);
+    int64x2_t zero = vdupq_n_s64(0);
+    size_t k = 0;
+    for( ; k + 2 <= n ; k += 2) {
+        int64x2_t x = vld1q_s64(in + k);
+        x = vaddq_s64(x, vextq_s64(zero, x, 1));
+        x = vaddq_s64(x, sum);
+        vst1q_s64(out + k, x);
+        sum = vdupq_laneq_s64(x, 1);
+    }
+    return scanBlockScalar(in + k, out + k, n - k, vgetq_lane_s64(sum, 0));
+}
+
+#endif
+
+int32_t scanBlockSimd(const int32_t* in, int32_t* out, size_t n, int32_t carry) {
+    switch(simdLevel()) {
+#ifdef PSUM_X86
+        case SIMD_AVX512: return scanBlockAvx512(in, out, n, carry);
+        case SIMD_AVX2: return scanBlockAvx2(in, out, n, carry);
+#endif
+#if defined(__aarch64__)
+        case SIMD_NEON: return scanBlockNeon(in, out, n, carry);
+#endif
+        default: return scanBlockScalar(in, out, n, carry);
+    }
+}
+
+int64_t scanBlockSimd(const int64_t* in, int64_t* out, size_t n, int64_t carry) {
+    switch(simdLevel()) {
+#ifdef PSUM_X86
+        case SIMD_AVX512: return scanBlockAvx512(in, out, n, carry);
+        case SIMD_AVX2: return scanBlockAvx2(in, out, n, carry);
+#endif
+#if defined(__aarch64__)
+        case SIMD_NEON: return scanBlockNeon(in, out, n, carry);
+#endif
+        default: return scanBlockScalar(in, out, n, carry);
+    }
+}
+
+} // namespace psum
@@ -0,0 +1,53 @@
+/*
+
+Vectorized kernels for the per-block pass of the work-efficient engine. Each vector is scanned in registers with log2(lanes)
+shift-and-add steps, and a running carry is broadcast from the last lane into the next vector. The kernel is picked at run
+time from what the processor supports, with a scalar loop as the fallback.
+
+*/
+
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace psum {
+
+/* Kernels for the per-block pass */
+enum SimdLevel { SIMD_AUTO, SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512, SIMD_NEON };
+
+/*
+Select the kernel used from now on. Forked workers inherit the selection.
+param       level -- the kernel, or SIMD_AUTO for the best one the processor supports
+return      0 if successful, or -1 if the processor does not support the kernel
+*/
+int setSimdLevel(SimdLevel level);
+
+/*
+Determine the kernel in use
+return      the selected kernel, never SIMD_AUTO
+*/
+SimdLevel simdLevel();
+
+/*
+Name of a kernel for messages
+param       level -- the kernel
+return      a short lower case name
+*/
+const char* simdName(SimdLevel level);
+
+/*
+Inclusive prefix sum of a block, starting from a carry. in and out may be the same array.
+param       in -- the input elements
+            out -- the output elements, out[i] = carry + in[0] + ... + in[i]
+            n -- the number of elements
+            carry -- the value added to every element
+return      the last output element, or carry if n is 0
+*/
+int32_t scanBlockSimd(const int32_t* in, int32_t* out, size_t n, int32_t carry);
+int64_t scanBlockSimd(const int64_t* in, int64_t* out, size_t n, int64_t carry);
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,221 @@
+/*
+
+Streaming scan for inputs larger than memory. The input is read in chunks of a fixed number of elements, each chunk is
+scanned in parallel with the total of everything before it folded into its first element, and the chunk is written while
+the next one is read and scanned. Only two chunks are ever in memory, so the memory used is bounded by the chunk size and
+not by the length of the input, and the input and output can be pipes.
+
+Binary arrays in files that can be read and written at offsets are streamed with asynchronous I/O instead, through a ring
+of chunk buffers. While chunk k is scanned, the next chunks are being read into the buffers ahead of it and chunk k-1 is
+being written from the buffer behind it, so a stream takes about as long as the slower of its I/O and its scans rather
+than their sum.
+
+*/
+
+#ifndef STREAM_SCAN_H
+#define STREAM_SCAN_H
+
+#include <cstddef>
+#include <errno.h>
+#include <functional>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "async-io.h"
+#include "exec-policy.h"
+#include "scan-engine.h"
+#include "shared-memory.h"
+
+namespace psum {
+
+/* Fills a chunk with up to capacity elements. Returns the number filled in, 0 at the end of the input, or -1 on error. */
+template<class T>
+using ChunkReader = std::function<long long(T* chunk, size_t capacity)>;
+
+/* Consumes n scanned elements. Returns 0 if successful, or -1 on error. */
+template<class T>
+using ChunkWriter = std::function<int(const T* chunk, size_t n)>;
+
+/*
+Inclusive scan of a stream, chunk by chunk. The writer runs on a thread of its own, at the same time as the next chunk is
+read and scanned, and is called in order.
+param       read -- the source of the input
+            write -- the destination of the output
+            chunkSize -- the number of elements in a chunk
+            op -- the associative operator
+            policy -- how each chunk is scanned
+return      the number of elements scanned, or -1 if reading, writing or a scan failed or memory could not be allocated
+*/
+template<class T, class Op>
+long long streamScan(const ChunkReader<T>& read, const ChunkWriter<T>& write, size_t chunkSize, Op op,
+                     const ExecPolicy& policy = ExecPolicy()) {
+    if(chunkSize == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Forked workers scan the chunks in place, so they are shared
+    bool shared = (policy.backend == PROCESS_BACKEND);
+    T* chunks[2];
+    chunks[0] = (T*)allocateMemory(shared, sizeof(T)*chunkSize);
+    chunks[1] = (T*)allocateMemory(shared, sizeof(T)*chunkSize);
+    if(chunks[0] == NULL || chunks[1] == NULL) {
+        int error = errno;
+        releaseMemory(shared, chunks[0]);
+        releaseMemory(shared, chunks[1]);
+        errno = error;
+        return -1;
+    }
+
+    std::thread writer;
+    int written = 0;        // result of the last write
+    int writeError = 0;     // errno of the last write
+    long long total = 0;
+    int result = 0;
+    int error = 0;
+    T carry = T();
+
+    // A chunk is only reused after the write of its previous contents has been joined
+    for(int b = 0 ; ; b ^= 1) {
+        long long n = read(chunks[b], chunkSize);
+        if(n < 0) { result = -1; error = errno; }
+        if(n > 0) {
+            // Fold the total so far into the first element, the scan then continues the previous chunk
+            if(total > 0) { chunks[b][0] = op(carry, chunks[b][0]); }
+            if(scan((const T*)chunks[b], chunks[b], (size_t)n, false, T(), op, policy) < 0) { result = -1; error = errno; }
+        }
+
+        if(writer.joinable()) { writer.join(); }
+        if(written < 0 && result == 0) { result = -1; error = writeError; }
+        if(result < 0 || n <= 0) { break; }
+
+        carry = chunks[b][n - 1];
+        total += n;
+        writer = std::thread([&write, &written, &writeError, chunk = chunks[b], n]() {
+            written = write(chunk, (size_t)n);
+            writeError = errno;
+        });
+    }
+
+    releaseMemory(shared, chunks[0]);
+    releaseMemory(shared, chunks[1]);
+    if(result < 0) {
+        errno = error;
+        return -1;
+    }
+    return total;
+}
+
+/* Settings of an asynchronous stream */
+struct IoConfig {
+    size_t chunk;       // elements per chunk
+    unsigned depth;     // chunk buffers, at least 2: depth - 2 chunks are read ahead of the one scanned
+    IoMode mode;        // how the reads and writes are done
+};
+
+/*
+Inclusive scan of a binary array in a file into another, chunk by chunk with asynchronous reads and writes
+param       inFd -- the input file, read at offsets
+            inOffset -- the file offset of the first input element
+            available -- the number of elements the input holds, those after them up to n are zero
+            outFd -- the output file, written at offsets
+            outOffset -- the file offset of the first output element
+            n -- the number of elements scanned and written
+            config -- the chunk size, the number of chunk buffers and the I/O mode
+            op -- the associative operator
+            stop -- flag that stops the stream when it is set after a chunk, like the flag of CheckedPlus, or NULL
+            policy -- how each chunk is scanned
+return      the number of elements scanned, or -1 if reading, writing or a scan failed, memory could not be allocated, or
+            with errno ECANCELED if stop was set
+*/
+template<class T, class Op>
+long long streamScanFiles(int inFd, uint64_t inOffset, size_t available, int outFd, uint64_t outOffset, size_t n,
+                          const IoConfig& config, Op op, const int* stop, const ExecPolicy& policy = ExecPolicy()) {
+    if(config.chunk == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t capacity = config.chunk < n ? config.chunk : (n > 0 ? n : 1);
+    size_t chunks = (n + capacity - 1) / capacity;
+    unsigned depth = config.depth < 2 ? 2 : config.depth;
+    if(available > n) { available = n; }
+
+    // Forked workers scan the chunks in place, so they are shared
+    bool shared = (policy.backend == PROCESS_BACKEND);
+    std::vector<T*> buffers(depth, (T*)NULL);
+    int result = 0;
+    for(unsigned s = 0 ; s < depth && result == 0 ; s++) {
+        buffers[s] = (T*)allocateMemory(shared, sizeof(T)*capacity);
+        if(buffers[s] == NULL) { result = -1; }
+    }
+    AsyncIo io;
+    if(result == 0 && openAsyncIo(&io, 2*depth, config.mode) < 0) { result = -1; }
+    if(result < 0) {
+        int error = errno;
+        for(unsigned s = 0 ; s < depth ; s++) { releaseMemory(shared, buffers[s]); }
+        errno = error;
+        return -1;
+    }
+
+    /* The read of a chunk into its buffer, of the part the input holds */
+    std::vector<IoRequest> reads(depth), writes(depth);
+    auto startRead = [&](size_t c) -> int {
+        size_t start = c*capacity;
+        size_t end = start + capacity < n ? start + capacity : n;
+        size_t stored = available > start ? (available < end ? available : end) - start : 0;
+        IoRequest* request = &reads[c % depth];
+        prepareIo(request, inFd, false, buffers[c % depth], stored*sizeof(T), inOffset + start*sizeof(T));
+        if(stored == 0) {
+            request->complete = true;
+            return 0;
+        }
+        return submitIo(&io, request);
+    };
+
+    int error = 0;
+    for(size_t c = 0 ; c < chunks && c < depth && result == 0 ; c++) {
+        if(startRead(c) < 0) { result = -1; error = errno; }
+    }
+
+    // A buffer is read into again once the write of its previous chunk is done, which had the next scan to run
+    T carry = T();
+    for(size_t c = 0 ; c < chunks && result == 0 ; c++) {
+        unsigned s = c % depth;
+        size_t start = c*capacity;
+        size_t count = start + capacity < n ? capacity : n - start;
+        T* chunk = buffers[s];
+        if(waitIo(&io, &reads[s]) < 0) { result = -1; error = errno; break; }
+        size_t stored = reads[s].done / sizeof(T);
+        if(reads[s].done < reads[s].length) { result = -1; error = EIO; break; } // The input became shorter
+        for(size_t k = stored ; k < count ; k++) { chunk[k] = T(); }
+
+        // Fold the total so far into the first element, the scan then continues the previous chunk
+        if(c > 0) { chunk[0] = op(carry, chunk[0]); }
+        if(scan((const T*)chunk, chunk, count, false, T(), op, policy) < 0) { result = -1; error = errno; break; }
+        if(stop != NULL && __atomic_load_n(stop, __ATOMIC_RELAXED)) { result = -1; error = ECANCELED; break; }
+        carry = chunk[count - 1];
+
+        prepareIo(&writes[s], outFd, true, chunk, count*sizeof(T), outOffset + start*sizeof(T));
+        if(submitIo(&io, &writes[s]) < 0) { result = -1; error = errno; break; }
+        if(c > 0) {
+            unsigned previous = (c - 1) % depth;
+            if(waitIo(&io, &writes[previous]) < 0) { result = -1; error = errno; break; }
+            if(c - 1 + depth < chunks && startRead(c - 1 + depth) < 0) { result = -1; error = errno; break; }
+        }
+    }
+    if(result == 0 && chunks > 0 && waitIo(&io, &writes[(chunks - 1) % depth]) < 0) { result = -1; error = errno; }
+
+    // Every request is done before its buffer is released
+    closeAsyncIo(&io);
+    for(unsigned s = 0 ; s < depth ; s++) { releaseMemory(shared, buffers[s]); }
+    if(result < 0) {
+        errno = error;
+        return -1;
+    }
+    return (long long)n;
+}
+
+} // namespace psum
+
+#endif
@@ -0,0 +1,152 @@
+/*
+
+Implementation of the non-template parts of the text arrays declared in text-io.h
+
+*/
+
+#include "text-io.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace psum {
+
+int mapTextFile(string filename, TextFile* file) {
+    file->base = NULL;
+    file->length = 0;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) { return -1; }
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    if(info.st_size == 0) {
+        close(fd);
+        return 0; // Nothing to map
+    }
+
+    void* base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if(base == MAP_FAILED) { return -1; }
+
+    madvise(base, info.st_size, MADV_SEQUENTIAL);
+    file->base = base;
+    file->length = info.st_size;
+    return 0;
+}
+
+void unmapTextFile(TextFile* file) {
+    if(file->base != NULL) { munmap(file->base, file->length); }
+    file->base = NULL;
+}
+
+void splitText(const char* text, size_t length, int chunks, vector<size_t>* bounds) {
+    bounds->assign(chunks + 1, length);
+    (*bounds)[0] = 0;
+    for(int j = 1 ; j < chunks ; j++) {
+        // Move the even split forward to the next whitespace, but never before the previous bound
+        size_t k = length / chunks * j;
+        if(k < (*bounds)[j - 1]) { k = (*bounds)[j - 1]; }
+        while(k < length && !isSpace(text[k])) { k++; }
+        (*bounds)[j] = k;
+    }
+}
+
+size_t countValues(const char* text, size_t length) {
+    size_t count = 0;
+    bool inValue = false;
+    for(size_t k = 0 ; k < length ; k++) {
+        bool space = isSpace(text[k]);
+        count += (!space && !inValue);
+        inValue = !space;
+    }
+    return count;
+}
+
+int openTextOutput(string filename) {
+    return open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+int closeTextOutput(int fd) {
+    return close(fd);
+}
+
+int writeBuffers(int fd, vector<struct iovec>* buffers) {
+    struct iovec* next = buffers->data();
+    int remaining = (int)buffers->size();
+    while(remaining > 0) {
+        int batch = remaining < IOV_MAX ? remaining : IOV_MAX;
+        ssize_t written = writev(fd, next, batch);
+        if(written < 0 && errno == EINTR) { continue; }
+        if(written < 0) { return -1; }
+
+        // Skip the buffers that were written completely, and the written part of the next one
+        while(remaining > 0 && (size_t)written >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            remaining--;
+        }
+        if(remaining > 0) {
+            next->iov_base = (char*)next->iov_base + written;
+            next->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+int openTextStream(string filename, size_t capacity, TextStream* stream) {
+    stream->buffer = NULL;
+    stream->fd = open(filename.c_str(), O_RDONLY);
+    if(stream->fd < 0) { return -1; }
+
+    stream->buffer = (char*)malloc(capacity);
+    if(stream->buffer == NULL) {
+        close(stream->fd);
+        stream->fd = -1;
+        errno = ENOMEM;
+        return -1;
+    }
+    stream->capacity = capacity;
+    stream->start = 0;
+    stream->end = 0;
+    stream->atEnd = false;
+    stream->stopped = false;
+    return 0;
+}
+
+int fillTextStream(TextStream* stream) {
+    if(stream->start > 0) {
+        memmove(stream->buffer, stream->buffer + stream->start, stream->end - stream->start);
+        stream->end -= stream->start;
+        stream->start = 0;
+    }
+    while(!stream->atEnd && stream->end < stream->capacity) {
+        ssize_t n = read(stream->fd, stream->buffer + stream->end, stream->capacity - stream->end);
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n < 0) { return -1; }
+        if(n == 0) { stream->atEnd = true; }
+        stream->end += n;
+    }
+    return 0;
+}
+
+void closeTextStream(TextStream* stream) {
+    if(stream->fd >= 0) { close(stream->fd); }
+    free(stream->buffer);
+    stream->fd = -1;
+    stream->buffer = NULL;
+}
+
+} // namespace psum
@@ -0,0 +1,335 @@
+/*
+
+Parallel reading and writing of text arrays, one decimal value per line (any whitespace separates values when reading).
+
+The reader maps the file and splits it at whitespace into one chunk per worker. The workers count the values of their
+chunks, an exclusive scan of the counts gives each chunk the index of its first value, and the workers then decode their
+chunks with from_chars straight into place. Reading stops at the first value that cannot be decoded, like reading with
+ifstream >> would.
+
+The writer formats the array with to_chars in rounds. Every worker formats a run of values into its own buffer, and the
+buffers of a round go to the file with a single writev, so the memory used is bounded by the round size and not by N.
+
+*/
+
+#ifndef TEXT_IO_H
+#define TEXT_IO_H
+
+#include <charconv>
+#include <cstddef>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+#include "exec-policy.h"
+
+namespace psum {
+
+/* A text file mapped for reading */
+struct TextFile {
+    void* base;         // start of the mapping, NULL for an empty file
+    size_t length;      // length of the mapping
+};
+
+/*
+Map a text file for reading
+param       filename -- path of the file to be read
+            file -- Pointer to the mapping to be filled in
+return      0 if successful, or -1 if the file cannot be opened or is not a regular file
+*/
+int mapTextFile(std::string filename, TextFile* file);
+
+/*
+Unmap a file from mapTextFile
+param       file -- Pointer to the mapping
+*/
+void unmapTextFile(TextFile* file);
+
+/*
+Split text into chunks that start and end at whitespace, so that no value is cut in two
+param       text -- the text
+            length -- the number of bytes
+            chunks -- the number of chunks wanted
+            bounds -- Pointer to the chunks+1 offsets to be filled in, chunk j is bounds[j] to bounds[j+1]
+*/
+void splitText(const char* text, size_t length, int chunks, std::vector<size_t>* bounds);
+
+/*
+Count the values in a piece of text
+param       text -- the text
+            length -- the number of bytes
+return      the number of runs of non-whitespace characters
+*/
+size_t countValues(const char* text, size_t length);
+
+/*
+Open a file for writing text
+param       filename -- path of the file to be written to
+return      the file descriptor, or -1 if unable to open the file
+*/
+int openTextOutput(std::string filename);
+
+/*
+Close a file from openTextOutput, reporting errors of delayed writes
+param       fd -- the file descriptor
+return      0 if successful, or -1 on error
+*/
+int closeTextOutput(int fd);
+
+/*
+Write a list of buffers to a file, continuing after short writes
+param       fd -- the file descriptor
+            buffers -- the buffers, changed by this function
+return      0 if successful, or -1 on error
+*/
+int writeBuffers(int fd, std::vector<struct iovec>* buffers);
+
+/* A text file read in pieces, for files that do not fit in memory or cannot be mapped */
+struct TextStream {
+    int fd;             // the file, -1 when closed
+    char* buffer;       // bytes read and not decoded yet are buffer[start] to buffer[end]
+    size_t capacity;
+    size_t start;
+    size_t end;
+    bool atEnd;         // the whole file has been read into the buffer
+    bool stopped;       // a value could not be decoded, reading stops like ifstream >> does
+};
+
+/*
+Open a text file to be read in pieces
+param       filename -- path of the file to be read, which can be a pipe
+            capacity -- the size of the buffer in bytes, the longest value that can be read
+            stream -- Pointer to the stream to be filled in
+return      0 if successful, or -1 if the file cannot be opened or the buffer allocated
+*/
+int openTextStream(std::string filename, size_t capacity, TextStream* stream);
+
+/*
+Move the bytes not decoded yet to the start of the buffer and read more until it is full or the file ends
+param       stream -- Pointer to the stream
+return      0 if successful, or -1 on error
+*/
+int fillTextStream(TextStream* stream);
+
+/*
+Close a stream from openTextStream
+param       stream -- Pointer to the stream
+*/
+void closeTextStream(TextStream* stream);
+
+/* Whitespace as accepted by ifstream >> */
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+Decode one value with from_chars. A leading '+' is accepted as ifstream >> accepts it.
+param       p -- the first character of the value
+            end -- one past the last character of the value
+            value -- Pointer receiving the value
+return      the character after the value, or NULL if no value could be decoded
+*/
+template<class T>
+const char* decodeValue(const char* p, const char* end, T* value) {
+    if(p < end && *p == '+') { p++; }
+    std::from_chars_result result = std::from_chars(p, end, *value);
+    if(result.ec != std::errc()) { return NULL; }
+    return result.ptr;
+}
+
+/*
+Decode the values of a piece of text in parallel
+param       text -- the text
+            length -- the number of bytes
+            array -- Pointer to the first element of the array to be initialized
+            N -- the maximum number of values to be decoded
+            policy -- the number of workers, they always run as threads
+            used -- Pointer receiving the number of bytes up to the end of the last value decoded
+return      the number of values decoded, which stops at N or before the first value that cannot be decoded
+*/
+template<class T>
+size_t parseTextBuffer(const char* text, size_t length, T* array, size_t N, const ExecPolicy& policy, size_t* used) {
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if(policy.pool != NULL && policy.pool->size() < workers) { workers = policy.pool->size(); } // runWorkers would refuse
+    std::vector<size_t> bounds;
+    splitText(text, length, workers, &bounds);
+
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+
+    /* Count the values of every chunk */
+    std::vector<size_t> firstIndex(workers + 1, 0);
+    runWorkers(threads, workers, [&](int j) {
+        firstIndex[j + 1] = countValues(text + bounds[j], bounds[j + 1] - bounds[j]);
+    });
+
+    // Prefix count, the index of the first value of each chunk
+    for(int j = 0 ; j < workers ; j++) {
+        firstIndex[j + 1] += firstIndex[j];
+    }
+
+    /*
+    Decode every chunk into place. stopIndex is the number of values before the first bad one of each chunk, and stopOffset
+    the end of its last value.
+    */
+    std::vector<size_t> stopIndex(workers, 0);
+    std::vector<size_t> stopOffset(workers, 0);
+    runWorkers(threads, workers, [&](int j) {
+        const char* p = text + bounds[j];
+        const char* end = text + bounds[j + 1];
+        size_t k = firstIndex[j];
+        while(k < N) {
+            while(p < end && isSpace(*p)) { p++; }
+            if(p == end) { break; }
+            const char* valueEnd = p;
+            while(valueEnd < end && !isSpace(*valueEnd)) { valueEnd++; }
+
+            const char* next = decodeValue(p, valueEnd, &array[k]);
+            if(next == NULL) { break; } // Not a value, reading stops here
+            k++;
+            p = next;
+            if(next != valueEnd) { break; } // Trailing garbage, ifstream >> would stop after this value
+        }
+        stopIndex[j] = k;
+        stopOffset[j] = (k == firstIndex[j]) ? bounds[j] : p - text;
+    });
+
+    // Everything after the first chunk that stopped early is ignored
+    size_t count = 0;
+    *used = 0;
+    for(int j = 0 ; j < workers ; j++) {
+        count = stopIndex[j];
+        if(count > firstIndex[j]) { *used = stopOffset[j]; }
+        if(stopIndex[j] < firstIndex[j + 1]) { break; }
+    }
+    return count < N ? count : N;
+}
+
+/*
+Create the input array from a text file in parallel
+param       filename -- path of the file to be read
+            array -- Pointer to the first element of the input array to be initialized
+            N -- the number of values to be read
+            policy -- the number of workers, they always run as threads
+return      the number of values written, or -1 if the file cannot be mapped
+*/
+template<class T>
+long long parseTextArray(std::string filename, T* array, size_t N, const ExecPolicy& policy) {
+    TextFile file;
+    if(mapTextFile(filename, &file) < 0) { return -1; }
+    if(file.base == NULL) { return 0; }
+
+    size_t used;
+    size_t count = parseTextBuffer((const char*)file.base, file.length, array, N, policy, &used);
+    unmapTextFile(&file);
+    return (long long)count;
+}
+
+/*
+Write an array as text to an open file in parallel
+param       fd -- the file descriptor
+            array -- Pointer to the first element of the array to be read
+            N -- the size of the array
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if unable to write the file
+*/
+template<class T>
+int writeTextArray(int fd, const T* array, size_t N, const ExecPolicy& policy) {
+    int workers = policy.workers < 1 ? 1 : policy.workers;
+    if(policy.pool != NULL && policy.pool->size() < workers) { workers = policy.pool->size(); } // runWorkers would refuse
+    ExecPolicy threads = policy;
+    threads.backend = THREAD_BACKEND;
+
+    size_t runLength = 1 << 16;        // Values formatted by each worker in a round
+    const size_t maxLength = 48;       // Enough for any integer or shortest round-trip float, and the newline
+    if(runLength*workers > N) { runLength = N / workers + 1; } // Small arrays, like the chunks of a stream
+    std::vector<std::vector<char> > buffers(workers, std::vector<char>(runLength*maxLength));
+    std::vector<size_t> lengths(workers);
+    std::vector<struct iovec> pieces(workers);
+
+    for(size_t roundStart = 0 ; roundStart < N ; roundStart += runLength*workers) {
+        runWorkers(threads, workers, [&](int j) {
+            size_t start = roundStart + j*runLength;
+            size_t end = start + runLength < N ? start + runLength : N;
+            char* p = buffers[j].data();
+            for(size_t k = start ; k < end ; k++) {
+                p = std::to_chars(p, p + maxLength, array[k]).ptr;
+                *p++ = '\n';
+            }
+            lengths[j] = (start < end) ? p - buffers[j].data() : 0;
+        });
+
+        for(int j = 0 ; j < workers ; j++) {
+            pieces[j].iov_base = buffers[j].data();
+            pieces[j].iov_len = lengths[j];
+        }
+        std::vector<struct iovec> round = pieces;
+        if(writeBuffers(fd, &round) < 0) { return -1; }
+    }
+    return 0;
+}
+
+/*
+Create the output text file from the given array in parallel
+param       filename -- path of the file to be written to
+            array -- Pointer to the first element of the output array to be read
+            N -- the size of the array
+            policy -- the number of workers, they always run as threads
+return      0 if successful, or -1 if unable to open or write the file
+*/
+template<class T>
+int formatTextArray(std::string filename, const T* array, size_t N, const ExecPolicy& policy) {
+    int fd = openTextOutput(filename);
+    if(fd < 0) { return -1; }
+
+    if(writeTextArray(fd, array, N, policy) < 0) {
+        int error = errno;
+        closeTextOutput(fd);
+        errno = error;
+        return -1;
+    }
+    return closeTextOutput(fd);
+}
+
+/*
+Read the next values of a text stream in parallel. Values cut by the end of the buffer are kept for the next call.
+param       stream -- Pointer to the stream
+            array -- Pointer to the first element of the array to be initialized
+            N -- the maximum number of values to be read
+            policy -- the number of workers, they always run as threads
+return      the number of values read, 0 at the end of the input or after a value that cannot be decoded, or -1 on error
+*/
+template<class T>
+long long readTextChunk(TextStream* stream, T* array, size_t N, const ExecPolicy& policy) {
+    size_t count = 0;
+    while(count < N && !stream->stopped) {
+        if(fillTextStream(stream) < 0) { return -1; }
+        if(stream->start == stream->end) { break; } // End of the input
+
+        // Only whole values are decoded, unless the input ends here
+        size_t cut = stream->end;
+        if(!stream->atEnd) {
+            while(cut > stream->start && !isSpace(stream->buffer[cut - 1])) { cut--; }
+        }
+        if(cut == stream->start) {
+            // A value longer than the buffer is not a value
+            stream->stopped = true;
+            break;
+        }
+
+        size_t used;
+        count += parseTextBuffer(stream->buffer + stream->start, cut - stream->start, array + count, N - count, policy, &used);
+        stream->start += used;
+        if(count < N) {
+            // Everything up to cut was decoded unless a value could not be
+            while(stream->start < cut && isSpace(stream->buffer[stream->start])) { stream->start++; }
+            if(stream->start < cut) { stream->stopped = true; }
+        }
+    }
+    return (long long)count;
+}
+
+} // namespace psum
+
+#endif
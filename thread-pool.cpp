@@ -0,0 +1,77 @@
+/*
+
+Implementation of the thread pool declared in thread-pool.h
+
+*/
+
+#include "thread-pool.h"
+
+using namespace std;
+
+namespace psum {
+
+/*
+Start the pool threads
+param       workers -- the total number of workers, including the calling thread
+*/
+ThreadPool::ThreadPool(int workers) : workers(workers), task(NULL), generation(0), remaining(0), stopping(false) {
+    for(int j = 1 ; j < workers ; j++) {
+        threads.push_back(thread(&ThreadPool::loop, this, j));
+    }
+}
+
+/* Stop and join the pool threads */
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    started.notify_all();
+    for(size_t j = 0 ; j < threads.size() ; j++) {
+        threads[j].join();
+    }
+}
+
+/*
+Run a task on every worker and wait for all of them to return
+param       task -- called once with each worker number, 0 to size()-1
+*/
+void ThreadPool::run(const function<void(int)>& task) {
+    {
+        lock_guard<mutex> guard(lock);
+        this->task = &task;
+        remaining = workers - 1;
+        generation++;
+    }
+    started.notify_all();
+
+    task(0); // The calling thread is worker 0
+
+    unique_lock<mutex> guard(lock);
+    while(remaining > 0) { finished.wait(guard); }
+}
+
+/*
+Body of a pool thread: wait for the next generation, run it, report back
+param       thisWorker -- the number associated with this thread
+*/
+void ThreadPool::loop(int thisWorker) {
+    int seen = 0; // Last generation this thread ran
+    while(true) {
+        const function<void(int)>* current;
+        {
+            unique_lock<mutex> guard(lock);
+            while(!stopping && generation == seen) { started.wait(guard); }
+            if(stopping) { return; }
+            seen = generation;
+            current = task;
+        }
+
+        (*current)(thisWorker);
+
+        lock_guard<mutex> guard(lock);
+        if(--remaining == 0) { finished.notify_one(); }
+    }
+}
+
+} // namespace psum
@@ -0,0 +1,45 @@
+/*
+
+A persistent pool of threads used by the thread backend
+
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+namespace psum {
+
+/*
+A persistent pool of threads. Worker 0 is the thread calling run(), the others wait on a condition variable between tasks,
+so a task costs a wake up instead of a thread creation. Only one task runs at a time, run() must not be called concurrently.
+*/
+class ThreadPool {
+public:
+    ThreadPool(int workers);
+    ~ThreadPool();
+    void run(const std::function<void(int)>& task);
+    int size() const { return workers; }
+
+private:
+    void loop(int thisWorker);
+
+    int workers;
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(int)>* task;   // Task of the current generation
+    int generation;                         // Number of tasks handed out so far
+    int remaining;                          // Pool threads still running the current task
+    bool stopping;
+};
+
+} // namespace psum
+
+#endif
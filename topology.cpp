@@ -0,0 +1,207 @@
+/*
+
+Implementation of the topology functions declared in topology.h
+
+*/
+
+#include "topology.h"
+
+#include <dirent.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace psum {
+
+/* CPUs of each node, in the order they are handed to workers */
+struct Topology {
+    vector<vector<int> > nodes;     // allowed CPUs of each node that has any
+    vector<int> compact;            // node by node
+    vector<int> scatter;            // one CPU of each node in turn
+    vector<int> nodeOf;             // node of each CPU number
+};
+
+static once_flag topologyOnce;
+static Topology topology;
+
+/*
+Parse a sysfs CPU list such as "0-3,8-11"
+param       text -- the list
+            cpus -- Pointer to the CPU numbers to be appended to
+*/
+static void parseCpuList(const char* text, vector<int>* cpus) {
+    const char* p = text;
+    while(*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if(end == p) { return; }
+        long last = first;
+        p = end;
+        if(*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for(long cpu = first ; cpu <= last ; cpu++) { cpus->push_back((int)cpu); }
+        if(*p == ',') { p++; }
+    }
+}
+
+/* Read the nodes once, keeping only the CPUs this process may run on */
+static void loadTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        for(int cpu = 0 ; cpu < CPU_SETSIZE ; cpu++) { CPU_SET(cpu, &allowed); }
+    }
+
+    vector<vector<int> > found;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if(dir != NULL) {
+        struct dirent* entry;
+        vector<int> numbers;
+        while((entry = readdir(dir)) != NULL) {
+            int node;
+            if(sscanf(entry->d_name, "node%d", &node) == 1) { numbers.push_back(node); }
+        }
+        closedir(dir);
+
+        // Nodes in numerical order, so worker placement does not depend on the directory order
+        sort(numbers.begin(), numbers.end());
+        for(size_t i = 0 ; i < numbers.size() ; i++) {
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", numbers[i]);
+            FILE* file = fopen(path, "r");
+            if(file == NULL) { continue; }
+            char line[4096];
+            vector<int> cpus;
+            if(fgets(line, sizeof(line), file) != NULL) { parseCpuList(line, &cpus); }
+            fclose(file);
+            found.push_back(cpus);
+        }
+    }
+
+    /* Keep the allowed CPUs, and every allowed CPU on one node if sysfs knows none of them */
+    for(size_t i = 0 ; i < found.size() ; i++) {
+        vector<int> cpus;
+        for(size_t k = 0 ; k < found[i].size() ; k++) {
+            int cpu = found[i][k];
+            if(cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) { cpus.push_back(cpu); }
+        }
+        if(!cpus.empty()) { topology.nodes.push_back(cpus); }
+    }
+    if(topology.nodes.empty()) {
+        vector<int> cpus;
+        for(int cpu = 0 ; cpu < CPU_SETSIZE ; cpu++) {
+            if(CPU_ISSET(cpu, &allowed)) { cpus.push_back(cpu); }
+        }
+        if(cpus.empty()) { cpus.push_back(0); }
+        topology.nodes.push_back(cpus);
+    }
+
+    /* The two placement orders */
+    size_t widest = 0;
+    for(size_t i = 0 ; i < topology.nodes.size() ; i++) {
+        const vector<int>& cpus = topology.nodes[i];
+        topology.compact.insert(topology.compact.end(), cpus.begin(), cpus.end());
+        if(cpus.size() > widest) { widest = cpus.size(); }
+        for(size_t k = 0 ; k < cpus.size() ; k++) {
+            if((size_t)cpus[k] >= topology.nodeOf.size()) { topology.nodeOf.resize(cpus[k] + 1, 0); }
+            topology.nodeOf[cpus[k]] = (int)i;
+        }
+    }
+    for(size_t k = 0 ; k < widest ; k++) {
+        for(size_t i = 0 ; i < topology.nodes.size() ; i++) {
+            if(k < topology.nodes[i].size()) { topology.scatter.push_back(topology.nodes[i][k]); }
+        }
+    }
+}
+
+int numaNodes() {
+    call_once(topologyOnce, loadTopology);
+    return (int)topology.nodes.size();
+}
+
+int allowedCpus() {
+    call_once(topologyOnce, loadTopology);
+    return (int)topology.compact.size();
+}
+
+size_t cacheSize(int level) {
+    size_t size = 0;
+    for(int index = 0 ; index < 16 ; index++) {
+        char path[128];
+        char line[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        FILE* file = fopen(path, "r");
+        if(file == NULL) { break; }
+        int found = 0;
+        if(fgets(line, sizeof(line), file) != NULL) { found = atoi(line); }
+        fclose(file);
+        if(found != level) { continue; }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        file = fopen(path, "r");
+        bool instructions = false;
+        if(file != NULL) {
+            instructions = (fgets(line, sizeof(line), file) != NULL && strncmp(line, "Instruction", 11) == 0);
+            fclose(file);
+        }
+        if(instructions) { continue; }
+
+        // Sizes such as "2048K"
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        file = fopen(path, "r");
+        if(file == NULL) { continue; }
+        if(fgets(line, sizeof(line), file) != NULL) {
+            char* end;
+            size_t bytes = strtoull(line, &end, 10);
+            if(*end == 'K') { bytes <<= 10; }
+            else if(*end == 'M') { bytes <<= 20; }
+            if(bytes > size) { size = bytes; }
+        }
+        fclose(file);
+    }
+    if(size > 0) { return size; }
+
+    // Without sysfs, as the C library knows it
+    long known = -1;
+    if(level == 1) { known = sysconf(_SC_LEVEL1_DCACHE_SIZE); }
+    else if(level == 2) { known = sysconf(_SC_LEVEL2_CACHE_SIZE); }
+    else if(level == 3) { known = sysconf(_SC_LEVEL3_CACHE_SIZE); }
+    return known > 0 ? (size_t)known : 0;
+}
+
+int workerCpu(Affinity affinity, int worker) {
+    if(affinity == AFFINITY_NONE) { return -1; }
+    call_once(topologyOnce, loadTopology);
+    const vector<int>& order = (affinity == AFFINITY_SCATTER) ? topology.scatter : topology.compact;
+    return order[worker % order.size()]; // More workers than CPUs wrap around
+}
+
+int cpuNode(int cpu) {
+    call_once(topologyOnce, loadTopology);
+    if(cpu < 0 || (size_t)cpu >= topology.nodeOf.size()) { return 0; }
+    return topology.nodeOf[cpu];
+}
+
+int pinThread(int cpu, cpu_set_t* previous) {
+    if(cpu < 0 || cpu >= CPU_SETSIZE) { return -1; }
+    if(sched_getaffinity(0, sizeof(cpu_set_t), previous) < 0) { return -1; }
+
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    return sched_setaffinity(0, sizeof(one), &one) < 0 ? -1 : 0;
+}
+
+void unpinThread(const cpu_set_t* previous) {
+    sched_setaffinity(0, sizeof(cpu_set_t), previous);
+}
+
+} // namespace psum
@@ -0,0 +1,76 @@
+/*
+
+Processor topology and worker pinning. The NUMA nodes and their CPUs are read from /sys/devices/system/node, limited to the
+CPUs this process may run on, so no NUMA library is needed and a machine without the directory is one node.
+
+Pinning worker j to a fixed CPU keeps it next to the memory of its block: the kernel places a page on the node of the CPU
+that first touches it, so a pinned worker that writes its block first gets local memory for every later round.
+
+*/
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <cstddef>
+#include <sched.h>
+
+namespace psum {
+
+/* How workers are placed on the CPUs */
+enum Affinity {
+    AFFINITY_NONE,      // the scheduler decides and may move workers
+    AFFINITY_COMPACT,   // consecutive workers fill the CPUs of one node before the next node
+    AFFINITY_SCATTER    // consecutive workers go to different nodes in turn
+};
+
+/*
+Get the number of NUMA nodes with CPUs this process may use
+return      the number of nodes, at least 1
+*/
+int numaNodes();
+
+/*
+Get the number of CPUs this process may use
+return      the number of CPUs, at least 1
+*/
+int allowedCpus();
+
+/*
+Get the size of a data or unified cache of the first CPU, from /sys/devices/system/cpu/cpu0/cache
+param       level -- the cache level, 1 for the cache nearest the core
+return      the size in bytes, or 0 if it is not known
+*/
+size_t cacheSize(int level);
+
+/*
+Get the CPU of a worker
+param       affinity -- the placement
+            worker -- the worker number
+return      the CPU, or -1 for AFFINITY_NONE
+*/
+int workerCpu(Affinity affinity, int worker);
+
+/*
+Get the NUMA node of a CPU
+param       cpu -- the CPU
+return      the node, or 0 if it is not known
+*/
+int cpuNode(int cpu);
+
+/*
+Pin the calling thread to one CPU
+param       cpu -- the CPU, nothing happens if it is negative
+            previous -- Pointer receiving the CPUs the thread could run on before
+return      0 if the thread was pinned, or -1 if not
+*/
+int pinThread(int cpu, cpu_set_t* previous);
+
+/*
+Undo pinThread
+param       previous -- the CPUs returned by pinThread
+*/
+void unpinThread(const cpu_set_t* previous);
+
+} // namespace psum
+
+#endif
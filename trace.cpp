@@ -0,0 +1,250 @@
+/*
+
+Implementation of the instrumentation declared in trace.h
+
+*/
+
+#include "trace.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <cstring>
+#include <vector>
+
+#include "shared-memory.h"
+
+using namespace std;
+
+namespace psum {
+
+static const char* const COUNTER_NAMES[TRACE_COUNTERS] = { "cycles", "llc_misses", "dtlb_misses" };
+
+/*
+Find the log of a worker
+param       trace -- Pointer to the trace
+            worker -- the number of the worker, or TRACE_CALLER
+return      the log, or NULL if the trace has no log for the worker
+*/
+static TraceLog* traceLog(const Trace* trace, int worker) {
+    if(trace == NULL || trace->logs == NULL || worker < TRACE_CALLER || worker >= trace->workers) { return NULL; }
+    return &trace->logs[worker + 1];
+}
+
+/*
+Open one counter of the calling thread, counting user space only so that it works without privileges
+param       type, config -- the perf_event type and configuration
+return      the descriptor, or -1 if the counter is not available
+*/
+static int openCounter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+int createTrace(Trace* trace, int workers, bool counters, bool shared) {
+    trace->workers = workers < 1 ? 1 : workers;
+    trace->counters = counters;
+    trace->shared = shared;
+    trace->origin = traceClock();
+    size_t size = sizeof(TraceLog)*(trace->workers + 1);
+    trace->logs = (TraceLog*)allocateMemory(shared, size);
+    if(trace->logs == NULL) { return -1; }
+    for(int j = 0 ; j <= trace->workers ; j++) {
+        trace->logs[j].count = 0;
+        trace->logs[j].dropped = 0;
+        for(int c = 0 ; c < TRACE_COUNTERS ; c++) { trace->logs[j].fds[c] = -1; }
+    }
+    openTraceCounters(trace, TRACE_CALLER);
+    return 0;
+}
+
+void releaseTrace(Trace* trace) {
+    if(trace->logs == NULL) { return; }
+    closeTraceCounters(trace, TRACE_CALLER);
+    releaseMemory(trace->shared, trace->logs);
+    trace->logs = NULL;
+}
+
+int64_t traceClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+void openTraceCounters(Trace* trace, int worker) {
+    TraceLog* log = traceLog(trace, worker);
+    if(log == NULL || !trace->counters) { return; }
+    log->fds[0] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    log->fds[1] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    log->fds[2] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+void closeTraceCounters(Trace* trace, int worker) {
+    TraceLog* log = traceLog(trace, worker);
+    if(log == NULL) { return; }
+    for(int c = 0 ; c < TRACE_COUNTERS ; c++) {
+        if(log->fds[c] >= 0) { close(log->fds[c]); }
+        log->fds[c] = -1;
+    }
+}
+
+void traceMark(const Trace* trace, int worker, TraceMark* mark) {
+    TraceLog* log = traceLog(trace, worker);
+    for(int c = 0 ; c < TRACE_COUNTERS ; c++) {
+        uint64_t value;
+        mark->counters[c] = -1;
+        if(log != NULL && log->fds[c] >= 0 && read(log->fds[c], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+            mark->counters[c] = (int64_t)value;
+        }
+    }
+    mark->time = traceClock(); // Read last so the counters are not part of the span
+}
+
+void traceSpan(Trace* trace, int worker, const char* name, int pass, const TraceMark* mark) {
+    int64_t now = traceClock();
+    TraceLog* log = traceLog(trace, worker);
+    if(log == NULL) { return; }
+    if(log->count >= TRACE_CAPACITY) {
+        log->dropped++;
+        return;
+    }
+
+    TraceEvent* event = &log->events[log->count];
+    event->name = name;
+    event->pass = pass;
+    event->start = mark->time;
+    event->duration = now - mark->time;
+    for(int c = 0 ; c < TRACE_COUNTERS ; c++) {
+        uint64_t value;
+        event->counters[c] = -1;
+        if(mark->counters[c] >= 0 && log->fds[c] >= 0 && read(log->fds[c], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+            event->counters[c] = (int64_t)value - mark->counters[c];
+        }
+    }
+    log->count++;
+}
+
+/* Totals of the spans of one name */
+struct SpanTotals {
+    const char* name;
+    int spans;
+    int64_t time;
+    int64_t longest;
+    int64_t counters[TRACE_COUNTERS]; // -1 if no span was counted
+};
+
+/*
+Add the spans of a log to totals by name
+param       log -- the log
+            totals -- Pointer to the totals, in order of first appearance
+*/
+static void addSpans(const TraceLog* log, vector<SpanTotals>* totals) {
+    for(int k = 0 ; k < log->count ; k++) {
+        const TraceEvent& event = log->events[k];
+        size_t i = 0;
+        while(i < totals->size() && strcmp((*totals)[i].name, event.name) != 0) { i++; }
+        if(i == totals->size()) {
+            SpanTotals empty = { event.name, 0, 0, 0, { -1, -1, -1 } };
+            totals->push_back(empty);
+        }
+        SpanTotals& total = (*totals)[i];
+        total.spans++;
+        total.time += event.duration;
+        if(event.duration > total.longest) { total.longest = event.duration; }
+        for(int c = 0 ; c < TRACE_COUNTERS ; c++) {
+            if(event.counters[c] < 0) { continue; }
+            total.counters[c] = (total.counters[c] < 0 ? 0 : total.counters[c]) + event.counters[c];
+        }
+    }
+}
+
+/*
+Write the totals of one log as lines of the report
+param       out -- the stream
+            who -- the caller or the number of the worker
+            totals -- the totals of the log
+*/
+static void writeTotals(FILE* out, const char* who, const vector<SpanTotals>& totals) {
+    for(size_t i = 0 ; i < totals.size() ; i++) {
+        const SpanTotals& total = totals[i];
+        fprintf(out, "%-8s %-12s %8d %12.3f %12.3f", who, total.name, total.spans, total.time / 1e6, total.longest / 1e6);
+        for(int c = 0 ; c < TRACE_COUNTERS ; c++) {
+            if(total.counters[c] < 0) { fprintf(out, " %14s", "-"); }
+            else { fprintf(out, " %14lld", (long long)total.counters[c]); }
+        }
+        fprintf(out, "\n");
+    }
+}
+
+int writeTraceReport(const Trace* trace, FILE* out) {
+    fprintf(out, "%-8s %-12s %8s %12s %12s", "worker", "span", "count", "total_ms", "longest_ms");
+    for(int c = 0 ; c < TRACE_COUNTERS ; c++) { fprintf(out, " %14s", COUNTER_NAMES[c]); }
+    fprintf(out, "\n");
+
+    int dropped = 0;
+    for(int j = TRACE_CALLER ; j < trace->workers ; j++) {
+        const TraceLog* log = traceLog(trace, j);
+        vector<SpanTotals> totals;
+        addSpans(log, &totals);
+        char who[16];
+        if(j == TRACE_CALLER) { snprintf(who, sizeof(who), "caller"); }
+        else { snprintf(who, sizeof(who), "%d", j); }
+        writeTotals(out, who, totals);
+        dropped += log->dropped;
+    }
+    if(dropped > 0) { fprintf(out, "%d spans dropped, more than %d in a log\n", dropped, TRACE_CAPACITY); }
+    return ferror(out) ? -1 : 0;
+}
+
+int writeChromeTrace(const Trace* trace, string filename) {
+    FILE* out = fopen(filename.c_str(), "w");
+    if(out == NULL) { return -1; }
+
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    bool first = true;
+    for(int j = TRACE_CALLER ; j < trace->workers ; j++) {
+        const TraceLog* log = traceLog(trace, j);
+        if(log->count == 0) { continue; }
+
+        // Name the thread of the worker
+        fprintf(out, "%s  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": ", first ? "" : ",\n",
+                j + 1);
+        if(j == TRACE_CALLER) { fprintf(out, "\"caller\"}}"); }
+        else { fprintf(out, "\"worker %d\"}}", j); }
+        first = false;
+
+        for(int k = 0 ; k < log->count ; k++) {
+            const TraceEvent& event = log->events[k];
+            fprintf(out, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {",
+                    event.name, j + 1, (event.start - trace->origin) / 1e3, event.duration / 1e3);
+            const char* separator = "";
+            if(event.pass >= 0) {
+                fprintf(out, "\"pass\": %d", event.pass);
+                separator = ", ";
+            }
+            for(int c = 0 ; c < TRACE_COUNTERS ; c++) {
+                if(event.counters[c] < 0) { continue; }
+                fprintf(out, "%s\"%s\": %lld", separator, COUNTER_NAMES[c], (long long)event.counters[c]);
+                separator = ", ";
+            }
+            fprintf(out, "}}");
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    bool failed = ferror(out);
+    if(fclose(out) != 0) { failed = true; }
+    return failed ? -1 : 0;
+}
+
+} // namespace psum
@@ -0,0 +1,139 @@
+/*
+
+Instrumentation of a run. A trace records timed spans: the phases of the caller, like reading the input or writing the
+output, and for every worker of a scan how long it took to start, and for each pass the time spent computing and the time
+spent waiting at the barrier after it. With counters enabled each span also holds the cycles, last level cache misses and
+data TLB misses of the thread over the span, from perf_event.
+
+Tracing is off unless ExecPolicy::trace points to a trace, and then a scan costs one test of the pointer per pass. A trace
+is read as a summary (writeTraceReport) or as a Chrome trace file for chrome://tracing or Perfetto (writeChromeTrace).
+
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#include "barrier.h"
+
+namespace psum {
+
+/* Hardware counters of a span: cycles, last level cache read misses and data TLB read misses */
+const int TRACE_COUNTERS = 3;
+
+/* Spans kept per worker, later ones are counted as dropped */
+const int TRACE_CAPACITY = 1024;
+
+/* Worker number of the caller's own spans */
+const int TRACE_CALLER = -1;
+
+/* A timed span */
+struct TraceEvent {
+    const char* name;   // string literal naming the span
+    int pass;           // pass of the scan, or -1
+    int64_t start;      // nanoseconds of CLOCK_MONOTONIC
+    int64_t duration;   // nanoseconds
+    int64_t counters[TRACE_COUNTERS]; // counts over the span, -1 if not counted
+};
+
+/* Spans of one worker, written only by that worker */
+struct alignas(CACHE_LINE) TraceLog {
+    int count;
+    int dropped;
+    int fds[TRACE_COUNTERS]; // perf_event descriptors of the thread running the worker, -1 if not open
+    TraceEvent events[TRACE_CAPACITY];
+};
+
+/* A trace, with a log for the caller followed by one per worker */
+struct Trace {
+    TraceLog* logs;
+    int workers;
+    bool counters;      // read hardware counters
+    bool shared;        // logs are in shared memory, for the process backend
+    int64_t origin;     // time the trace was created
+};
+
+/* The start of a span and the counter values at that time */
+struct TraceMark {
+    int64_t time;
+    int64_t counters[TRACE_COUNTERS];
+};
+
+/*
+Create a trace. The counters of the calling thread are opened for the caller's spans.
+param       trace -- Pointer to the trace to be initialized
+            workers -- the largest number of workers of a scan
+            counters -- true to read hardware counters, spans have none where perf_event is not available
+            shared -- true if forked workers write to it
+return      0 if successful, or -1 if the logs cannot be allocated
+*/
+int createTrace(Trace* trace, int workers, bool counters, bool shared);
+
+/*
+Release a trace from createTrace
+param       trace -- Pointer to the trace
+*/
+void releaseTrace(Trace* trace);
+
+/*
+Read the clock of the trace
+return      nanoseconds of CLOCK_MONOTONIC, the same in every process
+*/
+int64_t traceClock();
+
+/*
+Open the counters of the calling thread for a worker, nothing happens without counters
+param       trace -- Pointer to the trace
+            worker -- the number of the worker
+*/
+void openTraceCounters(Trace* trace, int worker);
+
+/*
+Close the counters opened by openTraceCounters
+param       trace -- Pointer to the trace
+            worker -- the number of the worker
+*/
+void closeTraceCounters(Trace* trace, int worker);
+
+/*
+Mark the start of a span
+param       trace -- Pointer to the trace
+            worker -- the number of the worker, or TRACE_CALLER
+            mark -- Pointer to the mark to be filled in
+*/
+void traceMark(const Trace* trace, int worker, TraceMark* mark);
+
+/*
+Record a span from a mark to now
+param       trace -- Pointer to the trace
+            worker -- the number of the worker, or TRACE_CALLER
+            name -- string literal naming the span
+            pass -- the pass of the scan, or -1
+            mark -- the start of the span, counters of -1 are not counted
+*/
+void traceSpan(Trace* trace, int worker, const char* name, int pass, const TraceMark* mark);
+
+/*
+Write a summary of a trace: the total time of each phase of the caller, and for every worker the time spent starting,
+computing and waiting, the longest wait and the counters
+param       trace -- Pointer to the trace
+            out -- the stream to write to
+return      0 if successful, or -1 if writing failed
+*/
+int writeTraceReport(const Trace* trace, FILE* out);
+
+/*
+Write a trace in the Chrome trace event format, one thread per worker and the caller as thread 0
+param       trace -- Pointer to the trace
+            filename -- path of the file to be written
+return      0 if successful, or -1 if the file cannot be written
+*/
+int writeChromeTrace(const Trace* trace, std::string filename);
+
+} // namespace psum
+
+#endif